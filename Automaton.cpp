@@ -0,0 +1,189 @@
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include "Definitions.h"
+#include "Parallel.h"
+using namespace std;
+
+// Least words of cells per thread before stepping is split between threads
+const int WORDSPERTHREAD = 8192;
+
+bool parseRule(const char text[], AutomatonRule& rule)
+{
+    // Counts after B are born, after S survive, e.g. B3/S23
+    unsigned short* counts = NULL;
+    rule.born = 0;
+    rule.survive = 0;
+
+    for (int i = 0; text[i] != '\0'; i++)
+    {
+        char ch = (char)toupper((unsigned char)text[i]);
+        if (ch == 'B')
+            counts = &rule.born;
+        else if (ch == 'S')
+            counts = &rule.survive;
+        else if (ch >= '0' && ch <= '8' && counts != NULL)
+            *counts |= 1 << (ch - '0');
+        else if (ch != '/' && ch != ' ')
+            return false;
+    }
+    return counts != NULL;
+}
+
+CellGrid newGrid(int rows, int cols)
+{
+    CellGrid grid;
+    grid.rows = rows;
+    grid.cols = cols;
+    grid.words = (cols + 63) / 64;
+    grid.bits = new unsigned long long[rows * grid.words]();
+    return grid;
+}
+
+void deleteGrid(CellGrid& grid)
+{
+    delete[] grid.bits;
+    grid.bits = NULL;
+}
+
+// Adds three one bit numbers per bit position, giving sum and carry
+static inline void fullAdd(unsigned long long a, unsigned long long b, unsigned long long c,
+    unsigned long long& sum, unsigned long long& carry)
+{
+    unsigned long long half = a ^ b;
+    sum = half ^ c;
+    carry = (a & b) | (half & c);
+}
+
+// The bits of row shifted so that each cell sees its west and east neighbour
+static inline void neighbours(const unsigned long long* row, int word, int words, int lastBit, bool wrap,
+    unsigned long long& west, unsigned long long& east)
+{
+    unsigned long long here = row[word];
+
+    west = here << 1;
+    if (word > 0)
+        west |= row[word - 1] >> 63;
+    else if (wrap)
+        west |= row[words - 1] >> lastBit & 1;
+
+    east = here >> 1;
+    if (word < words - 1)
+        east |= row[word + 1] << 63;
+    else if (wrap)
+        east |= (row[0] & 1) << lastBit;
+}
+
+// Steps rows first .. last - 1 of from into to
+static void stepRows(const CellGrid* from, CellGrid* to, AutomatonRule rule, bool wrap, int first, int last)
+{
+    int words = from->words;
+    int lastBit = (from->cols - 1) % 64;
+    unsigned long long lastMask = lastBit == 63 ? ~0ULL : (1ULL << (lastBit + 1)) - 1;
+
+    // Neighbour counts that give a live cell: 1 if born, 2 if surviving, 3 for both
+    int counts = 0, action[9], count[9];
+    for (int n = 0; n <= 8; n++)
+    {
+        int act = (rule.born >> n & 1) | (rule.survive >> n & 1) << 1;
+        if (act != 0)
+        {
+            action[counts] = act;
+            count[counts++] = n;
+        }
+    }
+
+    for (int row = first; row < last; row++)
+    {
+        // Rows above and below; off the edge they're empty unless wrapping
+        const unsigned long long* above = row > 0 ? &from->bits[(row - 1) * words]
+            : wrap ? &from->bits[(from->rows - 1) * words] : NULL;
+        const unsigned long long* below = row < from->rows - 1 ? &from->bits[(row + 1) * words]
+            : wrap ? &from->bits[0] : NULL;
+        const unsigned long long* middle = &from->bits[row * words];
+
+        for (int word = 0; word < words; word++)
+        {
+            unsigned long long n[8];
+            unsigned long long up = 0, down = 0;
+            n[0] = n[1] = n[2] = n[5] = n[6] = n[7] = 0;
+
+            if (above != NULL)
+            {
+                up = above[word];
+                neighbours(above, word, words, lastBit, wrap, n[0], n[1]);
+            }
+            neighbours(middle, word, words, lastBit, wrap, n[3], n[4]);
+            if (below != NULL)
+            {
+                down = below[word];
+                neighbours(below, word, words, lastBit, wrap, n[5], n[6]);
+            }
+            n[2] = up;
+            n[7] = down;
+
+            // Add the eight neighbour bits of 64 cells at once: count = ones + 2 twos + 4 fours + 8 eights
+            unsigned long long sa, ca, sb, cb, sc, cc, ones, cd, t1, f1, twos, f2, fours, eights;
+            fullAdd(n[0], n[1], n[2], sa, ca);
+            fullAdd(n[3], n[4], n[5], sb, cb);
+            sc = n[6] ^ n[7];
+            cc = n[6] & n[7];
+            fullAdd(sa, sb, sc, ones, cd);
+            fullAdd(ca, cb, cc, t1, f1);
+            twos = t1 ^ cd;
+            f2 = t1 & cd;
+            fours = f1 ^ f2;
+            eights = f1 & f2;
+
+            unsigned long long alive = middle[word];
+            unsigned long long next = 0;
+            for (int i = 0; i < counts; i++)
+            {
+                int n = count[i];
+                unsigned long long equal = (n & 1 ? ones : ~ones) & (n & 2 ? twos : ~twos)
+                    & (n & 4 ? fours : ~fours) & (n & 8 ? eights : ~eights);
+                next |= equal & (action[i] == 3 ? ~0ULL : action[i] == 1 ? ~alive : alive);
+            }
+
+            to->bits[row * words + word] = word == words - 1 ? next & lastMask : next;
+        }
+    }
+}
+
+void stepGrid(const CellGrid& from, CellGrid& to, AutomatonRule rule, bool wrap, int threads)
+{
+    // Each thread takes a band of rows; bands only read from and only write their own rows of to
+    int most = from.rows * from.words / WORDSPERTHREAD;
+    parallelFor(from.rows, min(threads, most), [&](int first, int last) { stepRows(&from, &to, rule, wrap, first, last); });
+}
+
+void gridFromCells(const char* cells, CellGrid& grid, char deadGlyph)
+{
+    memset(grid.bits, 0, grid.rows * grid.words * sizeof(unsigned long long));
+    for (int row = 0; row < grid.rows; row++)
+    {
+        const char* line = &cells[row * grid.cols];
+        unsigned long long* bits = &grid.bits[row * grid.words];
+        for (int col = 0; col < grid.cols; col++)
+        {
+            if (line[col] != deadGlyph && line[col] != ' ')
+            {
+                bits[col / 64] |= 1ULL << (col % 64);
+            }
+        }
+    }
+}
+
+void cellsFromGrid(const CellGrid& grid, char* cells, char liveGlyph, char deadGlyph)
+{
+    for (int row = 0; row < grid.rows; row++)
+    {
+        char* line = &cells[row * grid.cols];
+        const unsigned long long* bits = &grid.bits[row * grid.words];
+        for (int col = 0; col < grid.cols; col++)
+        {
+            line[col] = bits[col / 64] >> (col % 64) & 1 ? liveGlyph : deadGlyph;
+        }
+    }
+}
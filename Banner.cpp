@@ -0,0 +1,396 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "Definitions.h"
+using namespace std;
+
+// Most fonts kept loaded at once
+const int MAXFONTS = 16;
+
+// Layout bits of a FIGlet font header: the smushing rules, then the modes
+const int SMUSHEQUAL = 1;
+const int SMUSHUNDERSCORE = 2;
+const int SMUSHHIERARCHY = 4;
+const int SMUSHPAIR = 8;
+const int SMUSHBIGX = 16;
+const int SMUSHHARDBLANK = 32;
+const int LAYOUTKERN = 64;
+const int LAYOUTSMUSH = 128;
+
+/*
+* A loaded font. The file is kept as read; each glyph is parsed out of it the
+* first time it is used and appended to the atlas, one buffer holding every
+* parsed glyph as height rows of width characters.
+*/
+struct Font
+{
+    char name[FILENAMESIZE];
+    int height;
+    char hardblank;
+    int layout;                 // LAYOUTKERN, LAYOUTSMUSH and the smushing rules; 0 for full width
+    vector<char> text;          // the font file
+    int source[256];            // offset in text of each character's first line, -1 if the font hasn't one
+    int glyph[256];             // offset in atlas of each parsed glyph, -1 until it is used
+    unsigned char width[256];
+    vector<char> atlas;
+};
+
+static Font* fonts[MAXFONTS];
+static int fontCount = 0;
+static BannerStats stats = {};
+
+// Returns the offset in text of the line after the one starting at at
+static size_t nextLine(const vector<char>& text, size_t at)
+{
+    while (at < text.size() && text[at] != '\n')
+        at++;
+    return at < text.size() ? at + 1 : at;
+}
+
+// Reads the header and finds where each character's lines start
+static bool parseFont(Font* font)
+{
+    const vector<char>& text = font->text;
+    char header[256] = {};
+    size_t at = nextLine(text, 0);
+    memcpy(header, &text[0], min(at, sizeof(header) - 1));
+
+    int baseline, maxLength, oldLayout, comments, direction = 0, fullLayout = -1;
+    if (sscanf(header, "flf2a%c %d %d %d %d %d %d %d", &font->hardblank, &font->height, &baseline, &maxLength,
+        &oldLayout, &comments, &direction, &fullLayout) < 6 || font->height <= 0 || font->height > MAXROWS)
+    {
+        return false;
+    }
+
+    // The full layout says it all; the old one is -1 for full width, 0 to kern or the rules to smush with
+    if (fullLayout >= 0)
+        font->layout = fullLayout & (LAYOUTKERN | LAYOUTSMUSH | 63);
+    else
+        font->layout = oldLayout < 0 ? 0 : oldLayout == 0 ? LAYOUTKERN : LAYOUTSMUSH | (oldLayout & 63);
+
+    for (int i = 0; i < comments; i++)
+    {
+        at = nextLine(text, at);
+    }
+
+    // Characters 32 to 126 and seven German ones come in order, then any
+    // others, each with a line giving its code first
+    static const unsigned char GERMAN[] = { 196, 214, 220, 228, 246, 252, 223 };
+    for (int ch = 0; ch < 256; ch++)
+    {
+        font->source[ch] = -1;
+        font->glyph[ch] = -1;
+        font->width[ch] = 0;
+    }
+    for (int i = 0; i < 95 + 7 && at < text.size(); i++)
+    {
+        font->source[i < 95 ? 32 + i : GERMAN[i - 95]] = (int)at;
+        for (int row = 0; row < font->height; row++)
+        {
+            at = nextLine(text, at);
+        }
+    }
+    while (at < text.size())
+    {
+        // The text isn't NUL-terminated, so the code is copied out of its line before parsing
+        char number[32];
+        size_t end = nextLine(text, at);
+        size_t length = min(end - at, sizeof(number) - 1);
+        memcpy(number, &text[at], length);
+        number[length] = '\0';
+        long code = strtol(number, NULL, 0);
+        at = end;
+        if (code > 0 && code < 256)
+        {
+            font->source[code] = (int)at;
+        }
+        for (int row = 0; row < font->height; row++)
+        {
+            at = nextLine(text, at);
+        }
+    }
+    return font->source[' '] >= 0;
+}
+
+// Parses the lines of ch into the atlas: each line loses its end marks, and is
+// padded to the width of the widest
+static void parseGlyph(Font* font, int ch)
+{
+    const vector<char>& text = font->text;
+    size_t at = font->source[ch];
+    size_t starts[MAXROWS];
+    int lengths[MAXROWS], width = 0;
+
+    for (int row = 0; row < font->height; row++)
+    {
+        size_t end = nextLine(text, at);
+        int length = (int)(end - at);
+        while (length > 0 && (text[at + length - 1] == '\n' || text[at + length - 1] == '\r'))
+            length--;
+        char endMark = length > 0 ? text[at + length - 1] : '\0';
+        while (length > 0 && text[at + length - 1] == endMark)
+            length--;
+
+        starts[row] = at;
+        lengths[row] = min(length, 255);
+        width = max(width, lengths[row]);
+        at = end;
+    }
+
+    font->glyph[ch] = (int)font->atlas.size();
+    font->width[ch] = (unsigned char)width;
+    font->atlas.resize(font->atlas.size() + font->height * width, ' ');
+    for (int row = 0; row < font->height; row++)
+    {
+        memcpy(&font->atlas[font->glyph[ch] + row * width], &text[starts[row]], lengths[row]);
+    }
+    stats.glyphsParsed++;
+    stats.atlasBytes += font->height * width;
+}
+
+// Returns the rows of ch, parsing it on first use, or NULL if the font hasn't it
+static const char* glyphOf(Font* font, unsigned char ch)
+{
+    stats.lookups++;
+    if (font->glyph[ch] < 0)
+    {
+        if (font->source[ch] < 0)
+        {
+            return NULL;
+        }
+        stats.misses++;
+        parseGlyph(font, ch);
+    }
+    return &font->atlas[font->glyph[ch]];
+}
+
+Font* loadFont(const char filename[])
+{
+    for (int i = 0; i < fontCount; i++)
+    {
+        if (strcmp(fonts[i]->name, filename) == 0)
+        {
+            return fonts[i];
+        }
+    }
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Font* font = new Font;
+    snprintf(font->name, FILENAMESIZE, "%s", filename);
+    char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        font->text.insert(font->text.end(), buffer, buffer + got);
+    }
+    fclose(file);
+
+    if (font->text.empty() || !parseFont(font))
+    {
+        delete font;
+        return NULL;
+    }
+
+    // The oldest font makes room
+    if (fontCount == MAXFONTS)
+    {
+        stats.atlasBytes -= (long long)fonts[0]->atlas.size();
+        delete fonts[0];
+        memmove(&fonts[0], &fonts[1], (MAXFONTS - 1) * sizeof(Font*));
+        fontCount--;
+    }
+    fonts[fontCount++] = font;
+    stats.fonts = fontCount;
+    return font;
+}
+
+int fontHeight(const Font* font)
+{
+    return font->height;
+}
+
+/*
+* Returns what lch and rch become when smushed into one cell, or '\0' if they
+* can't be. The rules are FIGlet's: equal characters, an underscore giving way
+* to a line, the later of | /\ [] {} () <> winning, opposite brackets making
+* |, /\ \/ >< making | Y X, and two hardblanks making one.
+* Characters less than two columns wide (narrow) are only ever kerned.
+*/
+static char smush(const Font* font, char lch, char rch, bool narrow)
+{
+    if (lch == ' ')
+        return rch;
+    if (rch == ' ')
+        return lch;
+    if ((font->layout & LAYOUTSMUSH) == 0 || narrow)
+        return '\0';
+
+    int rules = font->layout & 63;
+    char hardblank = font->hardblank;
+    if (rules == 0)
+    {
+        // Universal smushing: the later character wins, except over a hardblank
+        return lch == hardblank ? rch : rch == hardblank ? lch : rch;
+    }
+
+    if (lch == hardblank || rch == hardblank)
+        return (rules & SMUSHHARDBLANK) && lch == rch ? lch : '\0';
+    if ((rules & SMUSHEQUAL) && lch == rch)
+        return lch;
+
+    static const char LINES[] = "|/\\[]{}()<>";
+    if (rules & SMUSHUNDERSCORE)
+    {
+        if (lch == '_' && strchr(LINES, rch) != NULL)
+            return rch;
+        if (rch == '_' && strchr(LINES, lch) != NULL)
+            return lch;
+    }
+    if (rules & SMUSHHIERARCHY)
+    {
+        static const char* CLASSES[] = { "|", "/\\", "[]", "{}", "()", "<>" };
+        int lclass = -1, rclass = -1;
+        for (int i = 0; i < 6; i++)
+        {
+            lclass = strchr(CLASSES[i], lch) != NULL ? i : lclass;
+            rclass = strchr(CLASSES[i], rch) != NULL ? i : rclass;
+        }
+        if (lclass >= 0 && rclass >= 0 && lclass != rclass)
+            return lclass > rclass ? lch : rch;
+    }
+    if (rules & SMUSHPAIR)
+    {
+        static const char* PAIRS[] = { "[]", "][", "{}", "}{", "()", ")(" };
+        for (int i = 0; i < 6; i++)
+        {
+            if (lch == PAIRS[i][0] && rch == PAIRS[i][1])
+                return '|';
+        }
+    }
+    if (rules & SMUSHBIGX)
+    {
+        if (lch == '/' && rch == '\\')
+            return '|';
+        if (lch == '\\' && rch == '/')
+            return 'Y';
+        if (lch == '>' && rch == '<')
+            return 'X';
+    }
+    return '\0';
+}
+
+// Returns how many columns of a glyph width wide can overlap the end of the
+// banner so far: as far as it goes without any row's characters touching when
+// kerning, or one more where the touching characters smush
+static int overlap(const Font* font, const char* cells, int stride, int length, const char* glyph, int width, bool narrow)
+{
+    if ((font->layout & (LAYOUTKERN | LAYOUTSMUSH)) == 0)
+    {
+        return 0;
+    }
+
+    int most = width;
+    for (int row = 0; row < font->height; row++)
+    {
+        const char* line = &cells[row * stride];
+        const char* rows = &glyph[row * width];
+
+        // Last character of the banner row, and first of the glyph row
+        int lineEnd = length;
+        while (lineEnd > 0 && (lineEnd == length || line[lineEnd] == ' '))
+            lineEnd--;
+        char lch = lineEnd < length ? line[lineEnd] : ' ';
+        int charStart = 0;
+        while (charStart < width && rows[charStart] == ' ')
+            charStart++;
+
+        int amount = charStart + length - 1 - lineEnd;
+        if (lch == ' ')
+            amount++;
+        else if (charStart < width && smush(font, lch, rows[charStart], narrow) != '\0')
+            amount++;
+        most = min(most, amount);
+    }
+    return max(0, min(most, length));
+}
+
+int renderBanner(Font* font, const char text[], char* cells, int maxWidth)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int length = 0, lastWidth = 0;
+
+    for (int i = 0; text[i] != '\0'; i++)
+    {
+        const char* glyph = glyphOf(font, (unsigned char)text[i]);
+        if (glyph == NULL)
+        {
+            continue;
+        }
+        int width = font->width[(unsigned char)text[i]];
+        bool narrow = lastWidth < 2 || width < 2;
+        int amount = overlap(font, cells, maxWidth, length, glyph, width, narrow);
+        if (length - amount + width > maxWidth)
+        {
+            break;
+        }
+
+        // Smush the overlapping columns, then copy the rest of the glyph
+        int at = length - amount;
+        for (int row = 0; row < font->height; row++)
+        {
+            char* line = &cells[row * maxWidth];
+            const char* rows = &glyph[row * width];
+            for (int col = 0; col < amount; col++)
+            {
+                char ch = smush(font, line[at + col], rows[col], narrow);
+                line[at + col] = ch != '\0' ? ch : rows[col];
+            }
+            memcpy(&line[length], &rows[amount], width - amount);
+        }
+        length = at + width;
+        lastWidth = width;
+    }
+
+    // Blanks show what's under the banner, hardblanks are solid spaces
+    for (int row = 0; row < font->height; row++)
+    {
+        char* line = &cells[row * maxWidth];
+        for (int col = 0; col < length; col++)
+        {
+            line[col] = line[col] == ' ' ? '\0' : line[col] == font->hardblank ? ' ' : line[col];
+        }
+    }
+
+    stats.renders++;
+    stats.renderUs += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    return length;
+}
+
+void blitBanner(char canvas[][MAXCOLS], const char* cells, int height, int width, int stride, int row, int col)
+{
+    // Only the part on the canvas is drawn
+    int fromCol = max(0, -col), toCol = min(width, MAXCOLS - col);
+    for (int r = max(0, -row); r < height && row + r < MAXROWS; r++)
+    {
+        const char* line = &cells[r * stride];
+        for (int c = fromCol; c < toCol; c++)
+        {
+            if (line[c] != '\0')
+            {
+                canvas[row + r][col + c] = line[c];
+            }
+        }
+    }
+    canvasChanged(canvas);
+}
+
+BannerStats getBannerStats()
+{
+    return stats;
+}
@@ -0,0 +1,1237 @@
+/*
+* Times the canvas functions and file I/O on the SavedFiles samples and
+* synthetic canvases, and opening sessions with long histories, giving the
+* median, 99th percentile and throughput of each (written as JSON with --json
+* FILE, to compare builds; --suite times only these). Then times the canvas kernels specialized at compile time
+* against the dynamic fallback, for the drawing canvas and common terminal
+* sizes, and the pattern search against trying every position, the automaton
+* against counting neighbours cell by cell, and image downsampling against
+* averaging cell by cell, on large canvases and images. Last the region
+* transforms, the blocked transpose against going cell by cell, diffing
+* long clip sequences against comparing cell by cell, and exporting them as
+* animated GIFs on one thread and on all of them.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+#include "Definitions.h"
+#include "CanvasKernels.h"
+using namespace std;
+
+// Calls per measurement
+const int ITERATIONS = 200000;
+
+// Keeps the compiler from dropping work whose result is never used
+static volatile char sink;
+
+// Kernels under test, one per column of the table
+enum Kernel { INIT, COPY, REPLACE, MOVE };
+const char* KERNELNAMES[] = { "init", "copy", "replace", "move" };
+
+// Returns nanoseconds per call of kernel from kernels
+static double timeKernel(const CanvasKernels& kernels, Kernel kernel, char* canvas, char* other)
+{
+    int rows = kernels.rows, cols = kernels.cols;
+    kernels.init(canvas, rows, cols);
+    kernels.init(other, rows, cols);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        switch (kernel)
+        {
+        case INIT:
+            kernels.init(canvas, rows, cols);
+            break;
+        case COPY:
+            kernels.copy(canvas, other, rows, cols);
+            break;
+        case REPLACE:
+            // Alternate so every call changes the whole canvas
+            kernels.replace(canvas, rows, cols, i & 1 ? '#' : ' ', i & 1 ? ' ' : '#');
+            break;
+        case MOVE:
+            kernels.move(canvas, rows, cols, 1, -1);
+            break;
+        }
+        sink = canvas[i % (rows * cols)];
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+}
+
+// Returns milliseconds per call of search, and how many matches it found
+static double timeSearch(int (*search)(const char*, int, int, const char*, int, int, char, Point[], int),
+    const char* text, int rows, int cols, const char* pattern, int patRows, int patCols, char wildcard, int& matches)
+{
+    const int SEARCHES = 5;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < SEARCHES; i++)
+    {
+        matches = search(text, rows, cols, pattern, patRows, patCols, wildcard, NULL, 0);
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / SEARCHES;
+}
+
+// Samples per suite measurement, at least MINSAMPLES when the calls are slow
+const int SAMPLES = 101;
+const int MINSAMPLES = 21;
+
+// Least time one sample takes, and most time spent sampling one measurement
+const double SAMPLENS = 50000;
+const double MEASURENS = 5e8;
+
+// Synthetic clips saved and loaded back
+const int SUITECLIPS = 200;
+
+// History lengths of the sessions opened, and times each is opened
+const int SESSIONSTATES[] = { 10, 200, 2000 };
+const int SESSIONSAMPLES = 51;
+
+// Where the suite writes its files; removed afterwards
+const char SUITECANVAS[] = "TextArtBench-canvas.txt";
+const char SUITECLIPSBASE[] = "TextArtBench-clips";
+
+// One measurement of the suite
+struct SuiteResult
+{
+    string name;
+    string input;
+    int samples;
+    double medianNs, p99Ns, meanNs;
+    double throughput;          // units of work per second at the median
+    const char* unit;
+};
+
+static vector<SuiteResult> suiteResults;
+
+/*
+* Records and prints a measurement from the time each of its samples took, in
+* ns per operation
+*/
+static void report(const char* name, const string& input, vector<double>& times, double work, const char* unit)
+{
+    int samples = (int)times.size();
+    double total = 0;
+    for (int s = 0; s < samples; s++)
+    {
+        total += times[s];
+    }
+    sort(times.begin(), times.end());
+
+    SuiteResult result;
+    result.name = name;
+    result.input = input;
+    result.samples = samples;
+    result.medianNs = times[samples / 2];
+    result.p99Ns = times[(samples * 99 + 99) / 100 - 1];
+    result.meanNs = total / samples;
+    result.throughput = work * 1e9 / result.medianNs;
+    result.unit = unit;
+    suiteResults.push_back(result);
+
+    // Throughput scaled to read easily
+    double scaled = result.throughput;
+    const char* prefix = " ";
+    if (scaled >= 1e9)
+        scaled /= 1e9, prefix = " G";
+    else if (scaled >= 1e6)
+        scaled /= 1e6, prefix = " M";
+    else if (scaled >= 1e3)
+        scaled /= 1e3, prefix = " k";
+
+    cout << left << setw(20) << name << setw(14) << input << right << setw(8) << samples << setw(13) << result.medianNs
+        << setw(12) << result.p99Ns << setw(12) << scaled << prefix << unit << "\n";
+}
+
+/*
+* Times body, which does one operation per call, and records the result
+* work is the amount of work one operation does, in unit, for the throughput
+* Each sample times enough calls to take SAMPLENS, so the timer's resolution
+* doesn't matter; the median and 99th percentile are per call.
+*/
+template <class Body>
+static void measure(const char* name, const string& input, double work, const char* unit, Body body)
+{
+    // Warm up, and find how many calls make a sample
+    int calls = 1;
+    double ns;
+    for (;;)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++)
+        {
+            body();
+        }
+        ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        if (ns >= SAMPLENS || calls >= (1 << 20))
+            break;
+        calls *= 2;
+    }
+    int samples = max(MINSAMPLES, min(SAMPLES, (int)(MEASURENS / max(ns, 1.0))));
+
+    vector<double> times(samples);
+    for (int s = 0; s < samples; s++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++)
+        {
+            body();
+        }
+        times[s] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / calls;
+    }
+    report(name, input, times, work, unit);
+}
+
+// Returns the names of the non-empty .txt files in SavedFiles, but for the session's
+static vector<string> sampleFiles()
+{
+    vector<string> names;
+#ifdef _WIN32
+    _finddata_t found;
+    intptr_t search = _findfirst("SavedFiles/*.txt", &found);
+    for (int more = search != -1 ? 0 : -1; more == 0; more = _findnext(search, &found))
+    {
+        names.push_back(found.name);
+    }
+    if (search != -1)
+        _findclose(search);
+#else
+    DIR* folder = opendir("SavedFiles");
+    for (dirent* entry = folder != NULL ? readdir(folder) : NULL; entry != NULL; entry = readdir(folder))
+    {
+        string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0)
+        {
+            names.push_back(name);
+        }
+    }
+    if (folder != NULL)
+        closedir(folder);
+#endif
+
+    vector<string> kept;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        ifstream file(("SavedFiles/" + names[i]).c_str());
+        if (file.peek() != EOF)
+        {
+            kept.push_back(names[i]);
+        }
+    }
+    sort(kept.begin(), kept.end());
+    return kept;
+}
+
+// Fills canvas with random characters from letters
+static void randomCanvas(char canvas[][MAXCOLS], const char* letters)
+{
+    int count = (int)strlen(letters);
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            canvas[row][col] = letters[rand() % count];
+        }
+    }
+    canvasChanged(canvas);
+}
+
+// Returns the size of a file, or 0 if it can't be read
+static long long fileBytes(const char* path)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    return file ? (long long)file.tellg() : 0;
+}
+
+// Times each canvas function and file path on every input
+static void benchmarkSuite()
+{
+    const double CELLS = MAXROWS * MAXCOLS;
+    srand(1);
+
+    // Inputs: a blank canvas, random ones sparse and dense, and the samples taken in turn
+    vector<string> files = sampleFiles();
+    vector<string> inputs;
+    vector<ListItemType*> canvases;
+    const char* LETTERS[] = { " ", "          .o#", "!#$%&()*+,-./0123456789:;<=>?@[]^_{|}~" };
+    const char* NAMES[] = { "blank", "sparse", "dense" };
+    for (int i = 0; i < 3; i++)
+    {
+        inputs.push_back(NAMES[i]);
+        canvases.push_back(new ListItemType[1]);
+        randomCanvas(canvases.back()[0], LETTERS[i]);
+    }
+    vector<ListItemType*> samples;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        samples.push_back(new ListItemType[1]);
+        string path = "SavedFiles/" + files[i];
+        loadCanvas(samples.back()[0], &path[0]);
+    }
+    if (!samples.empty())
+    {
+        inputs.push_back("SavedFiles");
+    }
+
+    ListItemType* work = new ListItemType[1];
+    int turn = 0;
+
+    // The canvas of input i; the samples take turns
+    auto source = [&](size_t i) -> char (*)[MAXCOLS] {
+        return i < canvases.size() ? canvases[i][0] : samples[turn++ % samples.size()][0];
+    };
+
+    cout << "\nsuite: " << files.size() << " samples from SavedFiles, " << SAMPLES << " samples per measurement\n";
+    cout << "function            input          samples    median ns      p99 ns    throughput\n";
+
+    measure("initCanvas", "blank", CELLS, "cells/s", [&]() { initCanvas(work[0]); });
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        measure("copyCanvas", inputs[i], CELLS, "cells/s", [&]() { copyCanvas(work[0], source(i)); });
+    }
+
+    // replace changes a character and back again, so every call does the same work
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        copyCanvas(work[0], source(i));
+        char from = work[0][MAXROWS / 2][MAXCOLS / 2], to = '\x7f';
+        measure("replace", inputs[i], CELLS, "cells/s", [&]() { replace(work[0], from, to); swap(from, to); });
+    }
+
+    // moveCanvas and fillRecursive change the canvas for good, so each call starts from a fresh copy (included)
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        measure("copy+moveCanvas", inputs[i], CELLS, "cells/s", [&]() { copyCanvas(work[0], source(i)); moveCanvas(work[0], 3, -7); });
+    }
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        measure("copy+fillRecursive", inputs[i], CELLS, "cells/s", [&]() {
+            copyCanvas(work[0], source(i));
+            fillRecursive(work[0], MAXROWS / 2, MAXCOLS / 2, work[0][MAXROWS / 2][MAXCOLS / 2], '\x7f', false);
+        });
+    }
+
+    // The drawing functions, on a blank canvas
+    initCanvas(work[0]);
+    measure("drawLine", "blank", 1, "lines/s", [&]() { drawLine(work[0], DrawPoint(0, 0), DrawPoint(MAXROWS - 1, MAXCOLS - 1), false); });
+    measure("drawBox", "blank", 1, "boxes/s", [&]() { drawBox(work[0], Point(MAXROWS / 2, MAXCOLS / 2), 10, false); });
+    measure("drawBoxesRecursive", "blank", 1, "drawings/s", [&]() { drawBoxesRecursive(work[0], Point(MAXROWS / 2, MAXCOLS / 2), 20, false); });
+    measure("treeRecursive", "blank", 1, "trees/s", [&]() {
+        treeRecursive(work[0], DrawPoint(MAXROWS - 1, MAXCOLS / 2), MAXROWS, 270, 30, false);
+    });
+
+    // Canvases to and from files
+    char canvasPath[FILENAMESIZE];
+    snprintf(canvasPath, FILENAMESIZE, "%s", SUITECANVAS);
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        saveCanvas(source(i), canvasPath);
+        double bytes = (double)fileBytes(canvasPath);
+        // A blank canvas saves as an empty file, so its rate is in cells
+        measure("saveCanvas", inputs[i], bytes > 0 ? bytes : CELLS, bytes > 0 ? "bytes/s" : "cells/s",
+            [&]() { saveCanvas(source(i), canvasPath); });
+    }
+    if (!files.empty())
+    {
+        long long bytes = 0;
+        vector<string> paths;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            paths.push_back("SavedFiles/" + files[i]);
+            bytes += fileBytes(paths.back().c_str());
+        }
+        measure("loadCanvas", "SavedFiles", (double)bytes / files.size(), "bytes/s", [&]() {
+            loadCanvas(work[0], &paths[turn++ % paths.size()][0]);
+        });
+    }
+
+    // Clips to and from files: the walk sample, and synthetic dense clips
+    List clips = { NULL, 0 };
+    char clipsPath[FILENAMESIZE];
+    snprintf(clipsPath, FILENAMESIZE, "SavedFiles/walk");
+    if (loadClips(clips, clipsPath))
+    {
+        int count = clips.count;
+        measure("loadClips", "walk", count, "clips/s", [&]() { loadClips(clips, clipsPath); });
+    }
+    deleteList(clips);
+    for (int i = 0; i < SUITECLIPS; i++)
+    {
+        Node* node = newCanvas();
+        randomCanvas(node->item, LETTERS[2]);
+        addNode(clips, node);
+    }
+    snprintf(clipsPath, FILENAMESIZE, "%s", SUITECLIPSBASE);
+    measure("saveClips", "dense", SUITECLIPS, "clips/s", [&]() { saveClips(clips, clipsPath); });
+    measure("loadClips", "dense", SUITECLIPS, "clips/s", [&]() { loadClips(clips, clipsPath); });
+    deleteList(clips);
+
+    // Opening sessions with histories of several lengths; each open is timed
+    // alone, as closing one reads its states back. The session and its log in
+    // use are moved aside and put back afterwards.
+    char aside[FILENAMESIZE], logAside[FILENAMESIZE];
+    snprintf(aside, FILENAMESIZE, "%s.bench", SESSIONFILE);
+    snprintf(logAside, FILENAMESIZE, "%s.bench", OPLOGFILE);
+    bool moved = rename(SESSIONFILE, aside) == 0, logMoved = rename(OPLOGFILE, logAside) == 0;
+    for (size_t h = 0; h < sizeof(SESSIONSTATES) / sizeof(SESSIONSTATES[0]); h++)
+    {
+        Node* current = newCanvas();
+        List undo = { NULL, 0 }, redo = { NULL, 0 };
+        remove(SESSIONFILE);
+        if (openSession(current, undo, redo, clips) || !getSessionStats().active)
+        {
+            cout << "openSession: " << SESSIONFILE << " can't be written here, skipped\n";
+            deleteNode(current);
+            break;
+        }
+        randomCanvas(current->item, LETTERS[1]);
+        for (int i = 0; i < SESSIONSTATES[h]; i++)
+        {
+            Operation op = newOperation(OPCELL);
+            op.start = Point(rand() % MAXROWS, rand() % MAXCOLS);
+            op.ch = LETTERS[2][rand() % strlen(LETTERS[2])];
+            addUndoState(undo, redo, current, op);
+            applyOperation(current->item, op, false);
+            checkpointSession(current, undo, redo, clips);
+        }
+        closeSession(current, undo, redo, clips);
+        deleteList(undo);
+        deleteNode(current);
+
+        vector<double> times(SESSIONSAMPLES);
+        for (int i = 0; i < SESSIONSAMPLES; i++)
+        {
+            current = NULL;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            openSession(current, undo, redo, clips);
+            times[i] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            closeSession(current, undo, redo, clips);
+            deleteList(undo);
+            deleteList(redo);
+            deleteList(clips);
+            deleteNode(current);
+        }
+        report("openSession", to_string(SESSIONSTATES[h]) + " states", times, SESSIONSTATES[h], "states/s");
+    }
+    closeOpLog();
+    remove(SESSIONFILE);
+    remove(OPLOGFILE);
+    if (moved)
+    {
+        rename(aside, SESSIONFILE);
+    }
+    if (logMoved)
+    {
+        rename(logAside, OPLOGFILE);
+    }
+
+    // Large canvases through the dynamic kernels
+    const int LARGE = 2000;
+    vector<char> large(LARGE * LARGE), other(LARGE * LARGE);
+    for (size_t i = 0; i < large.size(); i++)
+    {
+        large[i] = LETTERS[1][rand() % strlen(LETTERS[1])];
+    }
+    string size = to_string(LARGE) + "x" + to_string(LARGE);
+    double cells = (double)LARGE * LARGE;
+    measure("initCanvasDynamic", size, cells, "cells/s", [&]() { initCanvasDynamic(&other[0], LARGE, LARGE); });
+    measure("copyCanvasDynamic", size, cells, "cells/s", [&]() { copyCanvasDynamic(&other[0], &large[0], LARGE, LARGE); });
+    char from = 'o', to = '@';
+    measure("replaceDynamic", size, cells, "cells/s", [&]() { replaceDynamic(&large[0], LARGE, LARGE, from, to); swap(from, to); });
+    measure("moveCanvasDynamic", size, cells, "cells/s", [&]() {
+        copyCanvasDynamic(&other[0], &large[0], LARGE, LARGE);
+        moveCanvasDynamic(&other[0], LARGE, LARGE, 3, -7);
+    });
+
+    // Tidy up
+    remove(SUITECANVAS);
+    for (int i = 1; i <= SUITECLIPS; i++)
+    {
+        snprintf(clipsPath, FILENAMESIZE, "%s-%d.txt", SUITECLIPSBASE, i);
+        remove(clipsPath);
+    }
+    for (size_t i = 0; i < canvases.size(); i++)
+        delete[] canvases[i];
+    for (size_t i = 0; i < samples.size(); i++)
+        delete[] samples[i];
+    delete[] work;
+}
+
+// Writes s as a JSON string
+static void writeJsonString(ostream& out, const string& s)
+{
+    out << '"';
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            out << '\\' << s[i];
+        else if ((unsigned char)s[i] < ' ')
+            out << "\\u00" << "0123456789abcdef"[s[i] >> 4] << "0123456789abcdef"[s[i] & 15];
+        else
+            out << s[i];
+    }
+    out << '"';
+}
+
+// Writes the suite's results to path, one object per measurement
+static bool writeJson(const char* path)
+{
+    ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    out << setprecision(6) << "{\n  \"suite\": \"TextArtBench\",\n  \"canvas\": \"" << MAXROWS << "x" << MAXCOLS << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < suiteResults.size(); i++)
+    {
+        const SuiteResult& r = suiteResults[i];
+        out << "    { \"name\": ";
+        writeJsonString(out, r.name);
+        out << ", \"input\": ";
+        writeJsonString(out, r.input);
+        out << ", \"samples\": " << r.samples << ", \"median_ns\": " << r.medianNs << ", \"p99_ns\": " << r.p99Ns
+            << ", \"mean_ns\": " << r.meanNs << ", \"throughput\": " << r.throughput << ", \"unit\": \"" << r.unit << "\" }"
+            << (i + 1 < suiteResults.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+// Times findPattern against findPatternNaive on large canvases
+static void benchmarkSearch()
+{
+    const int ROWS = 2000, COLS = 2000;
+    const int PATROWS = 6, PATCOLS = 12;
+
+    // Art made of a few characters, which makes partial matches common; on the
+    // blank canvas the pattern is blank but for its last cell, the worst case
+    // for trying every position
+    const char* TEXTS[] = { "sparse", "dense", "blank" };
+    const char* ALPHABETS[] = { "        .", " .#", " " };
+
+    char* text = new char[ROWS * COLS];
+    char pattern[PATROWS * PATCOLS];
+
+    cout << "\nsearch " << ROWS << "x" << COLS << ", " << PATROWS << "x" << PATCOLS << " pattern\n";
+    cout << "text    wildcards  matches   search ms   naive ms  Mcells/s   speedup\n";
+
+    for (int t = 0; t < 3; t++)
+    {
+        int letters = (int)strlen(ALPHABETS[t]);
+        srand(1);
+        for (int i = 0; i < ROWS * COLS; i++)
+        {
+            text[i] = ALPHABETS[t][rand() % letters];
+        }
+
+        // The pattern is cut from the text, then planted again here and there
+        for (int r = 0; r < PATROWS; r++)
+        {
+            memcpy(&pattern[r * PATCOLS], &text[(ROWS / 2 + r) * COLS + COLS / 2], PATCOLS);
+        }
+        pattern[PATROWS * PATCOLS - 1] = t == 2 ? '@' : pattern[PATROWS * PATCOLS - 1];
+        for (int i = 0; i < 100; i++)
+        {
+            int row = rand() % (ROWS - PATROWS), col = rand() % (COLS - PATCOLS);
+            for (int r = 0; r < PATROWS; r++)
+            {
+                memcpy(&text[(row + r) * COLS + col], &pattern[r * PATCOLS], PATCOLS);
+            }
+        }
+
+        for (int wild = 0; wild < 2; wild++)
+        {
+            char searched[PATROWS * PATCOLS];
+            memcpy(searched, pattern, sizeof(searched));
+            if (wild)
+            {
+                // A wildcard column down the middle, and a corner
+                for (int r = 0; r < PATROWS; r++)
+                {
+                    searched[r * PATCOLS + PATCOLS / 2] = '?';
+                }
+                searched[0] = '?';
+            }
+
+            int matches, naiveMatches;
+            double ms = timeSearch(findPattern, text, ROWS, COLS, searched, PATROWS, PATCOLS, '?', matches);
+            double naiveMs = timeSearch(findPatternNaive, text, ROWS, COLS, searched, PATROWS, PATCOLS, '?', naiveMatches);
+
+            cout << left << setw(8) << TEXTS[t] << setw(11) << (wild ? "yes" : "no") << right << setw(7) << matches
+                << setw(12) << ms << setw(11) << naiveMs << setw(10) << ROWS * COLS / ms / 1000
+                << setw(9) << naiveMs / ms << "x" << (matches != naiveMatches ? "  MISMATCH" : "") << "\n";
+        }
+    }
+
+    delete[] text;
+}
+
+// One generation of rule worked out a cell at a time, for checking and timing stepGrid
+static void stepCells(const vector<char>& from, vector<char>& to, int rows, int cols, AutomatonRule rule, bool wrap)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+        {
+            int count = 0;
+            for (int dr = -1; dr <= 1; dr++)
+            {
+                for (int dc = -1; dc <= 1; dc++)
+                {
+                    int r = row + dr, c = col + dc;
+                    if (wrap)
+                    {
+                        r = (r + rows) % rows;
+                        c = (c + cols) % cols;
+                    }
+                    if ((dr != 0 || dc != 0) && r >= 0 && r < rows && c >= 0 && c < cols)
+                    {
+                        count += from[r * cols + c];
+                    }
+                }
+            }
+            to[row * cols + col] = (from[row * cols + col] ? rule.survive : rule.born) >> count & 1;
+        }
+    }
+}
+
+// Times stepGrid on one thread and on all of them against stepCells
+static void benchmarkAutomaton()
+{
+    const int ROWS = 2000, COLS = 2000;
+    const int GENERATIONS = 20;
+    const char* RULES[] = { "B3/S23", "B36/S23", "B2/S" };
+    int threads = (int)max(1u, thread::hardware_concurrency());
+
+    cout << "\nautomaton " << ROWS << "x" << COLS << ", " << GENERATIONS << " generations, " << threads << " threads\n";
+    cout << "rule     wrap   cells gen/s   1 thread gen/s   threads gen/s   speedup\n";
+
+    vector<char> cells(ROWS * COLS), nextCells(ROWS * COLS), text(ROWS * COLS);
+    for (int r = 0; r < 3; r++)
+    {
+        AutomatonRule rule;
+        parseRule(RULES[r], rule);
+
+        for (int wrap = 0; wrap < 2; wrap++)
+        {
+            srand(1);
+            for (int i = 0; i < ROWS * COLS; i++)
+            {
+                cells[i] = rand() % 3 == 0;
+                text[i] = cells[i] ? '#' : ' ';
+            }
+
+            CellGrid grids[2] = { newGrid(ROWS, COLS), newGrid(ROWS, COLS) };
+            double genPerSec[2];
+            bool same = true;
+
+            for (int run = 0; run < 2; run++)
+            {
+                gridFromCells(&text[0], grids[0], ' ');
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int g = 0; g < GENERATIONS; g++)
+                {
+                    stepGrid(grids[g % 2], grids[(g + 1) % 2], rule, wrap != 0, run == 0 ? 1 : threads);
+                }
+                genPerSec[run] = GENERATIONS / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int g = 0; g < GENERATIONS; g++)
+            {
+                stepCells(cells, nextCells, ROWS, COLS, rule, wrap != 0);
+                cells.swap(nextCells);
+            }
+            double cellsPerSec = GENERATIONS / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            cellsFromGrid(grids[GENERATIONS % 2], &text[0], '#', ' ');
+            for (int i = 0; i < ROWS * COLS; i++)
+            {
+                same = same && (text[i] == '#') == (cells[i] != 0);
+            }
+
+            cout << left << setw(9) << RULES[r] << setw(4) << (wrap ? "yes" : "no") << right << setw(14) << cellsPerSec
+                << setw(17) << genPerSec[0] << setw(16) << genPerSec[1] << setw(9) << genPerSec[1] / cellsPerSec << "x"
+                << (same ? "" : "  MISMATCH") << "\n";
+
+            deleteGrid(grids[0]);
+            deleteGrid(grids[1]);
+        }
+    }
+}
+
+// Averages the pixels under each cell, one cell at a time, for checking and timing downsampleImage
+static void downsampleCells(const GrayImage& image, unsigned char* levels, int rows, int cols)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        int top = (int)((long long)row * image.height / rows);
+        int bottom = max((int)((long long)(row + 1) * image.height / rows), top + 1);
+        for (int col = 0; col < cols; col++)
+        {
+            int left = (int)((long long)col * image.width / cols);
+            int right = max((int)((long long)(col + 1) * image.width / cols), left + 1);
+            unsigned long long total = 0, area = (unsigned long long)(bottom - top) * (right - left);
+            for (int y = top; y < bottom; y++)
+            {
+                for (int x = left; x < right; x++)
+                {
+                    total += image.pixels[(size_t)y * image.width + x];
+                }
+            }
+            levels[row * cols + col] = (unsigned char)((total + area / 2) / area);
+        }
+    }
+}
+
+// Times downsampleImage on one thread and on all of them against downsampleCells
+static void benchmarkImport()
+{
+    const int SIZES[][2] = { { 640, 480 }, { 4000, 3000 }, { 12000, 8000 } };
+    const int GRIDS[][2] = { { MAXROWS, MAXCOLS }, { 200, 600 } };
+    const int REPEATS = 5;
+    int threads = (int)max(1u, thread::hardware_concurrency());
+
+    cout << "\nimage import, " << threads << " threads\n";
+    cout << "image         cells     cells Mpx/s  1 thread Mpx/s  threads Mpx/s   speedup\n";
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+    {
+        GrayImage image = { SIZES[s][0], SIZES[s][1], new unsigned char[(size_t)SIZES[s][0] * SIZES[s][1]] };
+        srand(1);
+        for (int y = 0; y < image.height; y++)
+        {
+            for (int x = 0; x < image.width; x++)
+            {
+                image.pixels[(size_t)y * image.width + x] = (unsigned char)((x ^ y) + rand() % 16);
+            }
+        }
+        double mpixels = (double)image.width * image.height / 1e6;
+
+        for (size_t g = 0; g < sizeof(GRIDS) / sizeof(GRIDS[0]); g++)
+        {
+            int rows = GRIDS[g][0], cols = GRIDS[g][1];
+            vector<unsigned char> levels(rows * cols), expected(rows * cols);
+            double rate[3];
+
+            for (int run = 0; run < 3; run++)
+            {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int i = 0; i < REPEATS; i++)
+                {
+                    if (run == 0)
+                        downsampleCells(image, &expected[0], rows, cols);
+                    else
+                        downsampleImage(image, &levels[0], rows, cols, run == 1 ? 1 : threads);
+                }
+                rate[run] = mpixels * REPEATS / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+
+            cout << setw(5) << image.width << "x" << left << setw(7) << image.height << right << setw(4) << rows << "x"
+                << left << setw(4) << cols << right << setw(12) << rate[0] << setw(16) << rate[1] << setw(15) << rate[2]
+                << setw(9) << rate[2] / rate[0] << "x" << (levels != expected ? "  MISMATCH" : "") << "\n";
+        }
+        deleteImage(image);
+    }
+}
+
+// Transposes cell by cell, for checking and timing transposeDynamic
+static void transposeCells(char* to, const char* from, int rows, int cols)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+        {
+            to[(size_t)col * rows + row] = from[(size_t)row * cols + col];
+        }
+    }
+}
+
+// Times the transform kernels on large canvases, in megabytes of cells a second
+static void benchmarkTransforms()
+{
+    const int SIZES[][2] = { { MAXROWS, MAXCOLS }, { 1000, 1000 }, { 4096, 4096 }, { 3000, 8000 } };
+    const int REPEATS = 5;
+    const int RUNS = 7;
+    const char* NAMES[RUNS] = { "cells", "blocked", "rotate90", "rotate270", "mirror", "flip", "scale2" };
+
+    cout << "\ntransforms, MB/s\nsize        ";
+    for (int run = 0; run < RUNS; run++)
+    {
+        cout << setw(10) << NAMES[run];
+    }
+    cout << "   speedup\n";
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+    {
+        int rows = SIZES[s][0], cols = SIZES[s][1];
+        size_t cells = (size_t)rows * cols;
+        vector<char> from(cells), to(cells), expected(cells), scaled(cells * 4);
+        srand(1);
+        for (size_t i = 0; i < cells; i++)
+        {
+            from[i] = (char)(' ' + rand() % 64);
+        }
+        double rate[RUNS];
+        bool matches = true;
+
+        for (int run = 0; run < RUNS; run++)
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int i = 0; i < REPEATS; i++)
+            {
+                switch (run)
+                {
+                case 0:
+                    transposeCells(&expected[0], &from[0], rows, cols);
+                    break;
+                case 1:
+                    transposeDynamic(&to[0], &from[0], rows, cols);
+                    break;
+                case 2:
+                    rotateClockwiseDynamic(&to[0], &from[0], rows, cols);
+                    break;
+                case 3:
+                    rotateCounterDynamic(&to[0], &from[0], rows, cols);
+                    break;
+                case 4:
+                    flipAcrossDynamic(&from[0], rows, cols);
+                    break;
+                case 5:
+                    flipDownDynamic(&from[0], rows, cols);
+                    break;
+                case 6:
+                    scaleDynamic(&scaled[0], &from[0], rows, cols, 2);
+                    break;
+                }
+            }
+            rate[run] = cells * REPEATS / 1e6 / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            sink = to[cells / 2] ^ scaled[cells];
+
+            // Checked before the flips move the cells
+            if (run == 1)
+            {
+                matches = to == expected;
+            }
+        }
+
+        cout << setw(5) << rows << "x" << left << setw(6) << cols << right;
+        for (int run = 0; run < RUNS; run++)
+        {
+            cout << setw(10) << rate[run];
+        }
+        cout << setw(9) << rate[1] / rate[0] << "x" << (matches ? "" : "  MISMATCH") << "\n";
+    }
+}
+
+// Compares cell by cell, a run for each stretch of changed cells, for timing diffCanvas
+static int diffCells(char from[][MAXCOLS], char to[][MAXCOLS], CellRun runs[], char cells[])
+{
+    int count = 0, length = 0;
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            if (from[row][col] == to[row][col])
+            {
+                continue;
+            }
+            if (count == 0 || runs[count - 1].row != row || runs[count - 1].col + runs[count - 1].length != col)
+            {
+                CellRun run = { row, col, 0 };
+                runs[count++] = run;
+            }
+            runs[count - 1].length++;
+            cells[length++] = to[row][col];
+        }
+    }
+    return count;
+}
+
+// Times makeClipsPatch on one thread and on all of them against diffCells, on
+// clip sequences where every clip changes a little, or one in ten does
+static void benchmarkDiff()
+{
+    const int SIZES[] = { 1000, 20000 };
+    const int EVERY[] = { 1, 10 };
+    const int REPEATS = 3;
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    vector<CellRun> runs(MAXDIFFRUNS);
+    static ListItemType cells;
+
+    cout << "\nclip diff, " << threads << " threads\n";
+    cout << "clips   changed    cells MB/s  1 thread MB/s  threads MB/s   speedup     runs\n";
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+    {
+        for (size_t e = 0; e < sizeof(EVERY) / sizeof(EVERY[0]); e++)
+        {
+            List older = { NULL, 0 }, newer = { NULL, 0 }, patched = { NULL, 0 };
+            srand(1);
+            for (int i = 0; i < SIZES[s]; i++)
+            {
+                Node* node = newCanvas();
+                randomCanvas(node->item, " .:-=+*#");
+                Node* changed = newCanvas(node);
+                if (i % EVERY[e] == 0)
+                {
+                    makeWritable(changed);
+                    for (int cell = 0; cell < 12; cell++)
+                    {
+                        changed->item[rand() % MAXROWS][rand() % MAXCOLS] = 'X';
+                    }
+                }
+                addClip(patched, newCanvas(node));
+                addClip(older, node);
+                addClip(newer, changed);
+            }
+            double megabytes = (double)SIZES[s] * sizeof(ListItemType) / 1e6;
+            double rate[3];
+            long long cellRuns = 0;
+            DiffStats stats = {};
+
+            for (int run = 0; run < 3; run++)
+            {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int i = 0; i < REPEATS; i++)
+                {
+                    if (run == 0)
+                    {
+                        cellRuns = 0;
+                        for (Node* from = older.head, *to = newer.head; from != NULL; from = from->next, to = to->next)
+                        {
+                            cellRuns += diffCells(from->item, to->item, &runs[0], &cells[0][0]);
+                        }
+                    }
+                    else
+                    {
+                        stats = makeClipsPatch(older, newer, run == 1 ? 1 : threads);
+                    }
+                }
+                rate[run] = megabytes * REPEATS / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+
+            // The patch must turn the older clips into the newer ones
+            bool matches = patchCurrent(NULL, older, older, patched);
+            for (Node* from = patched.head, *to = newer.head; from != NULL && matches; from = from->next, to = to->next)
+            {
+                matches = memcmp(residentCanvas(from), residentCanvas(to), sizeof(ListItemType)) == 0;
+            }
+
+            cout << setw(5) << SIZES[s] << setw(10) << stats.clipsChanged << setw(14) << rate[0] << setw(15) << rate[1]
+                << setw(14) << rate[2] << setw(9) << rate[2] / rate[0] << "x" << setw(9) << stats.runs << " ("
+                << cellRuns << ")" << (matches ? "" : "  MISMATCH") << "\n";
+            deleteList(older);
+            deleteList(newer);
+            deleteList(patched);
+        }
+    }
+}
+
+// Decodes GIF LZW data, strictly: every code must be in the table already (or
+// be the next one to go in), read at the size a decoder reads it, and the data
+// must end with the end code
+// Returns FALSE if it doesn't, or doesn't hold exactly count pixels
+static bool decodeLzw(const vector<unsigned char>& data, int minCodeSize, unsigned char* pixels, size_t count)
+{
+    const int CLEAR = 1 << minCodeSize, END = CLEAR + 1, MAXCODES = 4096;
+    vector<int> prefix(MAXCODES);
+    vector<unsigned char> suffix(MAXCODES), chain(MAXCODES);
+    int codeSize = minCodeSize + 1, next = END + 1, previous = -1;
+    size_t written = 0, bit = 0;
+
+    for (;;)
+    {
+        if (bit + codeSize > data.size() * 8)
+        {
+            return false;
+        }
+        int code = 0;
+        for (int i = 0; i < codeSize; i++, bit++)
+        {
+            code |= ((data[bit / 8] >> (bit % 8)) & 1) << i;
+        }
+
+        if (code == CLEAR)
+        {
+            codeSize = minCodeSize + 1;
+            next = END + 1;
+            previous = -1;
+            continue;
+        }
+        if (code == END)
+        {
+            return written == count;
+        }
+        if (code > next || (previous < 0 && code >= CLEAR))
+        {
+            return false;
+        }
+
+        // The pixels code stands for, last first; the next code is the
+        // previous one's pixels and their first again
+        int length = 0, c = code == next ? previous : code;
+        while (c > END)
+        {
+            chain[length++] = suffix[c];
+            c = prefix[c];
+        }
+        chain[length++] = (unsigned char)c;
+        unsigned char head = (unsigned char)c;
+        if (written + length + (code == next ? 1 : 0) > count)
+        {
+            return false;
+        }
+        for (int i = length - 1; i >= 0; i--)
+        {
+            pixels[written++] = chain[i];
+        }
+        if (code == next)
+        {
+            pixels[written++] = head;
+        }
+
+        if (previous >= 0 && next < MAXCODES)
+        {
+            prefix[next] = previous;
+            suffix[next] = head;
+            if (++next == 1 << codeSize && codeSize < 12)
+            {
+                codeSize++;
+            }
+        }
+        previous = code;
+    }
+}
+
+// Reads back a GIF written by exportGif, checking every clip shows as
+// renderCanvas draws it for as long as play shows it
+static bool gifMatches(const char* path, List& clips, int pixelSize)
+{
+    ifstream file(path, ios::binary);
+    vector<unsigned char> gif((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    int width = MAXCOLS * GLYPHWIDTH * pixelSize, height = MAXROWS * GLYPHHEIGHT * pixelSize;
+    if (gif.size() < 13 || memcmp(&gif[0], "GIF89a", 6) != 0 || (gif[6] | gif[7] << 8) != width
+        || (gif[8] | gif[9] << 8) != height || (gif[10] & 0x80) == 0)
+    {
+        return false;
+    }
+
+    vector<Node*> nodes(clips.count);
+    int number = clips.count;
+    for (Node* node = clips.head; node != NULL; node = node->next)
+    {
+        nodes[--number] = node;
+    }
+
+    vector<unsigned char> screen((size_t)width * height, 0), expected(screen.size()), data, pixels;
+    size_t at = 13 + 3 * (2 << (gif[10] & 7));
+    int delay = 0, clip = 0;
+    while (at < gif.size() && gif[at] != 0x3B)
+    {
+        // An image or an extension, then its sub-blocks
+        bool image = gif[at] == 0x2C;
+        size_t start = at, blocks = at + (image ? 11 : 2);
+        if (blocks > gif.size())
+        {
+            return false;
+        }
+        if (!image && gif[at + 1] == 0xF9 && at + 5 < gif.size())
+        {
+            delay = gif[at + 4] | gif[at + 5] << 8;
+        }
+        data.clear();
+        for (at = blocks; at < gif.size() && gif[at] != 0; at += gif[at] + 1)
+        {
+            if (at + gif[at] >= gif.size())
+            {
+                return false;
+            }
+            data.insert(data.end(), &gif[at + 1], &gif[at + 1] + gif[at]);
+        }
+        at++;
+        if (!image)
+        {
+            continue;
+        }
+
+        int left = gif[start + 1] | gif[start + 2] << 8, top = gif[start + 3] | gif[start + 4] << 8;
+        int across = gif[start + 5] | gif[start + 6] << 8, down = gif[start + 7] | gif[start + 8] << 8;
+        if (left + across > width || top + down > height)
+        {
+            return false;
+        }
+        pixels.resize((size_t)across * down);
+        if (!pixels.empty() && !decodeLzw(data, gif[start + 10], &pixels[0], pixels.size()))
+        {
+            return false;
+        }
+        for (int row = 0; row < down; row++)
+        {
+            memcpy(&screen[(size_t)(top + row) * width + left], &pixels[(size_t)row * across], across);
+        }
+
+        for (int shown = 0; shown < delay * 10 / FRAMEMS; shown++, clip++)
+        {
+            if (clip >= clips.count)
+            {
+                return false;
+            }
+            renderCanvas(clipCanvas(nodes[clip]), pixelSize, &expected[0]);
+            if (expected != screen)
+            {
+                return false;
+            }
+        }
+    }
+    return clip == clips.count;
+}
+
+// Times exporting long animations as GIFs on one thread and on all of them,
+// and the first clip as a PNG
+static void benchmarkExport()
+{
+    const int SIZES[] = { 500, 2000 };
+    const int PIXELSIZES[] = { 1, 2 };
+    char gifPath[] = "TextArtBench-export.gif", pngPath[] = "TextArtBench-export.png";
+    int threads = (int)max(1u, thread::hardware_concurrency());
+
+    cout << "\nexport, " << threads << " threads\n";
+    cout << "clips  pixel   frames   folded        KB  1 thread ms  threads ms   speedup    PNG ms\n";
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+    {
+        // A scene with a block of changing glyphs moving across it, standing
+        // still every fourth clip
+        List clips = { NULL, 0 };
+        srand(1);
+        Node* scene = newCanvas();
+        randomCanvas(scene->item, "   .:-=+*#");
+        for (int i = 0; i < SIZES[s]; i++)
+        {
+            Node* node = newCanvas(scene);
+            int moved = i - i / 4;
+            Point at((moved / MAXCOLS) % (MAXROWS - 4), moved % (MAXCOLS - 8));
+            makeWritable(node);
+            for (int row = 0; row < 4; row++)
+            {
+                for (int col = 0; col < 8; col++)
+                {
+                    node->item[at.row + row][at.col + col] = "@#%&*+=o"[(moved + row * 3 + col * col) % 8];
+                }
+            }
+            addClip(clips, node);
+        }
+
+        for (size_t p = 0; p < sizeof(PIXELSIZES) / sizeof(PIXELSIZES[0]); p++)
+        {
+            ExportStats one, all, png;
+            exportGif(clips, gifPath, PIXELSIZES[p], 1, one);
+            exportGif(clips, gifPath, PIXELSIZES[p], threads, all);
+            exportPng(clips.head->item, pngPath, PIXELSIZES[p], png);
+
+            // Both must decode to the clips, each shown for as long as play shows it
+            bool matches = one.bytes == all.bytes && gifMatches(gifPath, clips, PIXELSIZES[p]);
+
+            cout << setw(5) << SIZES[s] << setw(7) << PIXELSIZES[p] << setw(9) << all.frames << setw(9) << all.framesFolded
+                << setw(10) << all.bytes / 1024 << setw(13) << one.ms << setw(12) << all.ms << setw(9) << one.ms / all.ms
+                << "x" << setw(10) << png.ms << (matches ? "" : "  MISMATCH") << "\n";
+        }
+        deleteNode(scene);
+        deleteList(clips);
+    }
+    remove(gifPath);
+    remove(pngPath);
+}
+
+// Times the specialized kernels against the dynamic ones at common sizes
+static void benchmarkKernels()
+{
+    const int SIZES[][2] = { { 22, 80 }, { 24, 80 }, { 50, 132 }, { 33, 100 } };
+
+    cout << "\nsize     kernel    specialized ns   dynamic ns   speedup\n";
+
+    for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++)
+    {
+        int rows = SIZES[i][0], cols = SIZES[i][1];
+        CanvasKernels fast = kernelsFor(rows, cols);
+        CanvasKernels dynamic = { rows, cols, false, initCanvasDynamic, copyCanvasDynamic, replaceDynamic, moveCanvasDynamic };
+        char* canvas = new char[rows * cols];
+        char* other = new char[rows * cols];
+
+        for (int kernel = INIT; kernel <= MOVE; kernel++)
+        {
+            double dynamicNs = timeKernel(dynamic, (Kernel)kernel, canvas, other);
+            cout << setw(3) << rows << "x" << left << setw(5) << cols << right << setw(7) << KERNELNAMES[kernel];
+
+            if (fast.specialized)
+            {
+                double fastNs = timeKernel(fast, (Kernel)kernel, canvas, other);
+                cout << setw(17) << fastNs << setw(13) << dynamicNs << setw(9) << dynamicNs / fastNs << "x\n";
+            }
+            else
+            {
+                cout << setw(17) << "-" << setw(13) << dynamicNs << setw(10) << "-" << "\n";
+            }
+        }
+
+        delete[] canvas;
+        delete[] other;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* jsonPath = NULL;
+    bool suiteOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--suite") == 0)
+            suiteOnly = true;
+        else
+        {
+            cerr << "usage: " << argv[0] << " [--suite] [--json FILE]\n";
+            return 1;
+        }
+    }
+
+    cout << fixed << setprecision(1);
+    benchmarkSuite();
+    if (jsonPath != NULL && !writeJson(jsonPath))
+    {
+        cerr << "could not write " << jsonPath << "\n";
+        return 1;
+    }
+    if (suiteOnly)
+    {
+        return 0;
+    }
+
+    benchmarkKernels();
+    benchmarkSearch();
+    benchmarkAutomaton();
+    benchmarkImport();
+    benchmarkTransforms();
+    benchmarkDiff();
+    benchmarkExport();
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <cstring>
+#include <algorithm>
+#include "CanvasKernels.h"
+using namespace std;
+
+// Side of the square blocks transposes go through; a block of the source and
+// one of the destination together fit easily in a level 1 cache
+const int TRANSPOSEBLOCK = 32;
+
+void initCanvasDynamic(char* canvas, int rows, int cols)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            canvas[i * cols + j] = ' ';
+        }
+    }
+}
+
+void copyCanvasDynamic(char* to, const char* from, int rows, int cols)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            to[i * cols + j] = from[i * cols + j];
+        }
+    }
+}
+
+void replaceDynamic(char* canvas, int rows, int cols, char oldCh, char newCh)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (canvas[i * cols + j] == oldCh)
+                canvas[i * cols + j] = newCh;
+        }
+    }
+}
+
+void moveCanvasDynamic(char* canvas, int rows, int cols, int rowValue, int colValue)
+{
+    char* moved = new char[rows * cols];
+    initCanvasDynamic(moved, rows, cols);
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            // Only what lands inside the canvas is kept
+            if (i + rowValue >= 0 && i + rowValue < rows && j + colValue >= 0 && j + colValue < cols)
+                moved[(i + rowValue) * cols + j + colValue] = canvas[i * cols + j];
+        }
+    }
+    copyCanvasDynamic(canvas, moved, rows, cols);
+    delete[] moved;
+}
+
+// Writes cell i, j of from to row j (cols - 1 - j if backRows) and column
+// i (rows - 1 - i if backCols) of to, a block at a time
+static void transposeBlocked(char* to, const char* from, int rows, int cols, bool backRows, bool backCols)
+{
+    for (int top = 0; top < rows; top += TRANSPOSEBLOCK)
+    {
+        int bottom = min(top + TRANSPOSEBLOCK, rows);
+        for (int left = 0; left < cols; left += TRANSPOSEBLOCK)
+        {
+            int right = min(left + TRANSPOSEBLOCK, cols);
+            for (int i = top; i < bottom; i++)
+            {
+                const char* source = &from[(size_t)i * cols];
+                int toCol = backCols ? rows - 1 - i : i;
+                for (int j = left; j < right; j++)
+                {
+                    int toRow = backRows ? cols - 1 - j : j;
+                    to[(size_t)toRow * rows + toCol] = source[j];
+                }
+            }
+        }
+    }
+}
+
+void transposeDynamic(char* to, const char* from, int rows, int cols)
+{
+    transposeBlocked(to, from, rows, cols, false, false);
+}
+
+void rotateClockwiseDynamic(char* to, const char* from, int rows, int cols)
+{
+    // The first row becomes the last column
+    transposeBlocked(to, from, rows, cols, false, true);
+}
+
+void rotateCounterDynamic(char* to, const char* from, int rows, int cols)
+{
+    // The first row becomes the first column, read upwards
+    transposeBlocked(to, from, rows, cols, true, false);
+}
+
+void flipAcrossDynamic(char* canvas, int rows, int cols)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        reverse(&canvas[(size_t)i * cols], &canvas[(size_t)(i + 1) * cols]);
+    }
+}
+
+void flipDownDynamic(char* canvas, int rows, int cols)
+{
+    for (int i = 0; i < rows / 2; i++)
+    {
+        swap_ranges(&canvas[(size_t)i * cols], &canvas[(size_t)(i + 1) * cols], &canvas[(size_t)(rows - 1 - i) * cols]);
+    }
+}
+
+void rotateHalfDynamic(char* canvas, int rows, int cols)
+{
+    reverse(canvas, &canvas[(size_t)rows * cols]);
+}
+
+void scaleDynamic(char* to, const char* from, int rows, int cols, int factor)
+{
+    size_t width = (size_t)cols * factor;
+    for (int i = 0; i < rows; i++)
+    {
+        // Widen the row once, then copy it down
+        char* first = &to[(size_t)i * factor * width];
+        for (int j = 0; j < cols; j++)
+        {
+            memset(&first[(size_t)j * factor], from[(size_t)i * cols + j], factor);
+        }
+        for (int k = 1; k < factor; k++)
+        {
+            memcpy(&first[k * width], first, width);
+        }
+    }
+}
+
+// Adapters from the run time signature to a compile time size
+template <int Rows, int Cols>
+static void initFixed(char* canvas, int, int)
+{
+    Canvas<Rows, Cols>::init((char(*)[Cols])canvas);
+}
+
+template <int Rows, int Cols>
+static void copyFixed(char* to, const char* from, int, int)
+{
+    Canvas<Rows, Cols>::copy((char(*)[Cols])to, (const char(*)[Cols])from);
+}
+
+template <int Rows, int Cols>
+static void replaceFixed(char* canvas, int, int, char oldCh, char newCh)
+{
+    Canvas<Rows, Cols>::replace((char(*)[Cols])canvas, oldCh, newCh);
+}
+
+template <int Rows, int Cols>
+static void moveFixed(char* canvas, int, int, int rowValue, int colValue)
+{
+    Canvas<Rows, Cols>::move((char(*)[Cols])canvas, rowValue, colValue);
+}
+
+template <int Rows, int Cols>
+static CanvasKernels fixedKernels()
+{
+    CanvasKernels kernels = { Rows, Cols, true, initFixed<Rows, Cols>, copyFixed<Rows, Cols>,
+        replaceFixed<Rows, Cols>, moveFixed<Rows, Cols> };
+    return kernels;
+}
+
+CanvasKernels kernelsFor(int rows, int cols)
+{
+    // The drawing canvas, then common terminal sizes
+    static const CanvasKernels SPECIALIZED[] = {
+        fixedKernels<22, 80>(),
+        fixedKernels<24, 80>(),
+        fixedKernels<25, 80>(),
+        fixedKernels<50, 80>(),
+        fixedKernels<30, 120>(),
+        fixedKernels<50, 132>(),
+    };
+
+    for (size_t i = 0; i < sizeof(SPECIALIZED) / sizeof(SPECIALIZED[0]); i++)
+    {
+        if (SPECIALIZED[i].rows == rows && SPECIALIZED[i].cols == cols)
+        {
+            return SPECIALIZED[i];
+        }
+    }
+
+    CanvasKernels dynamic = { rows, cols, false, initCanvasDynamic, copyCanvasDynamic, replaceDynamic, moveCanvasDynamic };
+    return dynamic;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstring>
+
+/*
+* Canvas kernels specialized at compile time for a Rows x Cols canvas.
+* Every size is a constant, so init and copy are a single memset and memcpy,
+* and the loops have fixed trip counts the compiler can unroll and vectorize.
+*/
+template <int Rows, int Cols>
+struct Canvas
+{
+    static const int CELLS = Rows * Cols;
+
+    // Fills the canvas with spaces
+    static void init(char canvas[][Cols])
+    {
+        memset(canvas, ' ', CELLS);
+    }
+
+    // Copies from into to
+    static void copy(char to[][Cols], const char from[][Cols])
+    {
+        memcpy(to, from, CELLS);
+    }
+
+    // Replaces every oldCh with newCh; a select rather than a branch, so it vectorizes
+    static void replace(char canvas[][Cols], char oldCh, char newCh)
+    {
+        char* cells = &canvas[0][0];
+        for (int i = 0; i < CELLS; i++)
+        {
+            cells[i] = cells[i] == oldCh ? newCh : cells[i];
+        }
+    }
+
+    // Shifts the contents by rowValue rows and colValue columns; what moves off
+    // the edge is lost and what moves in is blank. Works in place, a memmove per
+    // row, taking rows in the order that never overwrites one still to be moved.
+    static void move(char canvas[][Cols], int rowValue, int colValue)
+    {
+        int width = Cols - (colValue < 0 ? -colValue : colValue);
+        if (width <= 0 || rowValue <= -Rows || rowValue >= Rows)
+        {
+            init(canvas);
+            return;
+        }
+
+        int toCol = colValue > 0 ? colValue : 0;
+        int fromCol = colValue < 0 ? -colValue : 0;
+        int gapCol = colValue > 0 ? 0 : width;
+        int gap = Cols - width;
+
+        for (int i = 0; i < Rows - (rowValue < 0 ? -rowValue : rowValue); i++)
+        {
+            int row = rowValue > 0 ? Rows - 1 - i : i;
+            memmove(&canvas[row][toCol], &canvas[row - rowValue][fromCol], width);
+            memset(&canvas[row][gapCol], ' ', gap);
+        }
+
+        // Rows nothing moved into
+        if (rowValue > 0)
+        {
+            memset(canvas, ' ', rowValue * Cols);
+        }
+        else if (rowValue < 0)
+        {
+            memset(&canvas[Rows + rowValue][0], ' ', -rowValue * Cols);
+        }
+    }
+
+    // replace for a canvas holding only spaces outside rows top..bottom and
+    // columns left..right; nothing outside that rectangle is read or written
+    static void replaceRect(char canvas[][Cols], int top, int left, int bottom, int right, char oldCh, char newCh)
+    {
+        for (int row = top; row <= bottom; row++)
+        {
+            for (int col = left; col <= right; col++)
+            {
+                canvas[row][col] = canvas[row][col] == oldCh ? newCh : canvas[row][col];
+            }
+        }
+    }
+
+    // move for a canvas holding only spaces outside rows top..bottom and
+    // columns left..right; only that rectangle and where it lands are written
+    static void moveRect(char canvas[][Cols], int top, int left, int bottom, int right, int rowValue, int colValue)
+    {
+        // Where the rectangle lands, clipped to the canvas
+        int toTop = top + rowValue > 0 ? top + rowValue : 0;
+        int toBottom = bottom + rowValue < Rows - 1 ? bottom + rowValue : Rows - 1;
+        int toLeft = left + colValue > 0 ? left + colValue : 0;
+        int toRight = right + colValue < Cols - 1 ? right + colValue : Cols - 1;
+        int width = toRight - toLeft + 1;
+
+        if (toTop <= toBottom && width > 0)
+        {
+            // Bottom up when moving down, so no row is overwritten before it's moved
+            for (int i = 0; i <= toBottom - toTop; i++)
+            {
+                int row = rowValue > 0 ? toBottom - i : toTop + i;
+                memmove(&canvas[row][toLeft], &canvas[row - rowValue][toLeft - colValue], width);
+            }
+        }
+        else
+        {
+            toTop = Rows;
+            toBottom = -1;
+        }
+
+        // Blank what the rectangle left behind
+        for (int row = top; row <= bottom; row++)
+        {
+            if (row < toTop || row > toBottom)
+            {
+                memset(&canvas[row][left], ' ', right - left + 1);
+                continue;
+            }
+            if (left < toLeft)
+            {
+                memset(&canvas[row][left], ' ', (right < toLeft ? right + 1 : toLeft) - left);
+            }
+            if (right > toRight)
+            {
+                int from = left > toRight ? left : toRight + 1;
+                memset(&canvas[row][from], ' ', right - from + 1);
+            }
+        }
+    }
+};
+
+/*
+* The same kernels for a canvas whose size is only known at run time
+* canvas points to rows * cols characters, row after row
+*/
+void initCanvasDynamic(char* canvas, int rows, int cols);
+void copyCanvasDynamic(char* to, const char* from, int rows, int cols);
+void replaceDynamic(char* canvas, int rows, int cols, char oldCh, char newCh);
+void moveCanvasDynamic(char* canvas, int rows, int cols, int rowValue, int colValue);
+
+/*
+* Geometric transforms of a rows x cols canvas of any size, from one buffer
+* into another (in place for the flips). Transposing and quarter turns write
+* cols x rows cells; they go a square block at a time, so the columns being
+* written stay in the cache while the block's rows are read.
+*/
+void transposeDynamic(char* to, const char* from, int rows, int cols);
+void rotateClockwiseDynamic(char* to, const char* from, int rows, int cols);
+void rotateCounterDynamic(char* to, const char* from, int rows, int cols);
+void flipAcrossDynamic(char* canvas, int rows, int cols);
+void flipDownDynamic(char* canvas, int rows, int cols);
+void rotateHalfDynamic(char* canvas, int rows, int cols);
+
+/*
+* Scales a rows x cols canvas up factor times into rows * factor x cols * factor
+* cells of to, each cell becoming a factor x factor square of it
+*/
+void scaleDynamic(char* to, const char* from, int rows, int cols, int factor);
+
+// Kernels for one canvas size
+struct CanvasKernels
+{
+    int rows;
+    int cols;
+    bool specialized;       // false: the dynamic fallback
+    void (*init)(char* canvas, int rows, int cols);
+    void (*copy)(char* to, const char* from, int rows, int cols);
+    void (*replace)(char* canvas, int rows, int cols, char oldCh, char newCh);
+    void (*move)(char* canvas, int rows, int cols, int rowValue, int colValue);
+};
+
+/*
+* Returns the specialized kernels for a rows x cols canvas when that size is
+* instantiated (the drawing canvas and common terminal sizes), or else the
+* dynamic fallback
+*/
+CanvasKernels kernelsFor(int rows, int cols);
@@ -0,0 +1,248 @@
+#include <iostream>
+#include <cstring>
+#include "Definitions.h"
+using namespace std;
+
+// Initial number of hash table buckets; the table doubles when it gets crowded
+const int STOREBUCKETS = 256;
+
+// Hash table of sealed canvases, chained through CanvasBlob::nextInBucket
+static CanvasBlob** buckets = NULL;
+static int bucketCount = 0;
+
+// Store counters
+static int uniqueCanvases = 0;
+static int handles = 0;
+static long long totalBytesSaved = 0;
+
+// Points node at blob
+static void attachBlob(Node* node, CanvasBlob* blob)
+{
+    node->blob = blob;
+    node->item = blob->item;
+}
+
+// Doubles the number of buckets and rehashes every sealed canvas
+static void growTable()
+{
+    int newCount = bucketCount == 0 ? STOREBUCKETS : bucketCount * 2;
+    CanvasBlob** newBuckets = new CanvasBlob * [newCount];
+    for (int i = 0; i < newCount; i++)
+    {
+        newBuckets[i] = NULL;
+    }
+
+    // Move every chain entry into its new bucket
+    for (int i = 0; i < bucketCount; i++)
+    {
+        CanvasBlob* blob = buckets[i];
+        while (blob != NULL)
+        {
+            CanvasBlob* next = blob->nextInBucket;
+            int index = (int)(blob->hash % newCount);
+            blob->nextInBucket = newBuckets[index];
+            newBuckets[index] = blob;
+            blob = next;
+        }
+    }
+
+    delete[] buckets;
+    buckets = newBuckets;
+    bucketCount = newCount;
+}
+
+// Finds a sealed canvas with the same contents, or returns NULL
+static CanvasBlob* findBlob(unsigned long long hash, char canvas[][MAXCOLS])
+{
+    if (bucketCount == 0)
+    {
+        return NULL;
+    }
+
+    for (CanvasBlob* blob = buckets[hash % bucketCount]; blob != NULL; blob = blob->nextInBucket)
+    {
+        // Hashes can collide, so confirm the contents really match
+        if (blob->hash == hash && memcmp(blob->item, canvas, sizeof(ListItemType)) == 0)
+        {
+            return blob;
+        }
+    }
+    return NULL;
+}
+
+// Adds blob to the hash table and marks it sealed
+static void insertBlob(CanvasBlob* blob, unsigned long long hash)
+{
+    if (uniqueCanvases >= bucketCount * 2)
+    {
+        growTable();
+    }
+
+    int index = (int)(hash % bucketCount);
+    blob->hash = hash;
+    blob->sealed = true;
+    blob->nextInBucket = buckets[index];
+    buckets[index] = blob;
+    uniqueCanvases++;
+}
+
+// Takes blob out of the hash table; it becomes private again
+static void removeBlob(CanvasBlob* blob)
+{
+    CanvasBlob** link = &buckets[blob->hash % bucketCount];
+    while (*link != blob)
+    {
+        link = &(*link)->nextInBucket;
+    }
+    *link = blob->nextInBucket;
+
+    blob->nextInBucket = NULL;
+    blob->sealed = false;
+    uniqueCanvases--;
+}
+
+unsigned long long hashCanvas(char canvas[][MAXCOLS])
+{
+    const unsigned char* bytes = (const unsigned char*)canvas;
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < (int)sizeof(ListItemType); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void allocateCanvas(Node* node)
+{
+    CanvasBlob* blob = new CanvasBlob;
+    countAllocation(MEMCANVAS, sizeof(CanvasBlob));
+    forgetCanvas(blob->item);
+    blob->hash = 0;
+    blob->refCount = 1;
+    blob->sealed = false;
+    blob->sessionOffset = 0;
+    blob->nextInBucket = NULL;
+    attachBlob(node, blob);
+}
+
+void sealCanvas(Node* node)
+{
+    // Paged out nodes are sealed by definition
+    CanvasBlob* blob = node->blob;
+    if (blob == NULL || blob->sealed)
+    {
+        return;
+    }
+
+    unsigned long long hash = hashCanvas(blob->item);
+    CanvasBlob* existing = findBlob(hash, blob->item);
+
+    if (existing != NULL)
+    {
+        // Share the stored copy and drop our own
+        existing->refCount++;
+        totalBytesSaved += sizeof(ListItemType);
+        forgetCanvas(blob->item);
+        delete blob;
+        countAllocation(MEMCANVAS, -(long long)sizeof(CanvasBlob));
+        attachBlob(node, existing);
+    }
+    else
+    {
+        insertBlob(blob, hash);
+    }
+    handles++;
+}
+
+void makeWritable(Node* node)
+{
+    CanvasBlob* blob = node->blob;
+    if (!blob->sealed)
+    {
+        return;
+    }
+
+    // Once edited, the canvas no longer matches its copy in the session file
+    node->sessionOffset = 0;
+
+    handles--;
+    if (blob->refCount == 1)
+    {
+        // Nobody else uses it, so it can be edited in place
+        removeBlob(blob);
+        blob->sessionOffset = 0;
+    }
+    else
+    {
+        blob->refCount--;
+        allocateCanvas(node);
+        memcpy(node->blob->item, blob->item, sizeof(ListItemType));
+    }
+}
+
+void shareCanvas(Node* node, Node* source)
+{
+    CanvasBlob* blob = source->blob;
+
+    if (!blob->sealed)
+    {
+        // Source is still private (e.g. the current canvas), look for a stored copy
+        unsigned long long hash = hashCanvas(blob->item);
+        blob = findBlob(hash, source->item);
+
+        if (blob == NULL)
+        {
+            allocateCanvas(node);
+            memcpy(node->blob->item, source->item, sizeof(ListItemType));
+            insertBlob(node->blob, hash);
+            handles++;
+            return;
+        }
+    }
+
+    blob->refCount++;
+    handles++;
+    totalBytesSaved += sizeof(ListItemType);
+    attachBlob(node, blob);
+}
+
+void releaseCanvas(Node* node)
+{
+    CanvasBlob* blob = node->blob;
+    if (blob == NULL)
+    {
+        return;
+    }
+
+    if (blob->sealed)
+    {
+        handles--;
+    }
+
+    blob->refCount--;
+    if (blob->refCount == 0)
+    {
+        if (blob->sealed)
+        {
+            removeBlob(blob);
+        }
+        forgetCanvas(blob->item);
+        delete blob;
+        countAllocation(MEMCANVAS, -(long long)sizeof(CanvasBlob));
+    }
+
+    node->blob = NULL;
+    node->item = NULL;
+}
+
+StoreStats getStoreStats()
+{
+    StoreStats stats;
+    stats.uniqueCanvases = uniqueCanvases;
+    stats.handles = handles;
+    stats.bytesSaved = (long long)(handles - uniqueCanvases) * sizeof(ListItemType);
+    stats.totalBytesSaved = totalBytesSaved;
+    return stats;
+}
@@ -0,0 +1,492 @@
+#include <iostream>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Definitions.h"
+using namespace std;
+
+// Most distinct characters tracked; a canvas with more falls back to scanning
+const int MAXPLANES = 32;
+
+// 64 bit words per canvas row, and the bits of the last one that are cells
+const int ROWWORDS = (MAXCOLS + 63) / 64;
+const unsigned long long LASTWORDMASK = MAXCOLS % 64 == 0 ? ~0ULL : (1ULL << (MAXCOLS % 64)) - 1;
+
+typedef unsigned long long Plane[MAXROWS][ROWWORDS];
+
+/*
+* One bit per cell for each character on the tracked canvas: bit col % 64 of
+* word col / 64 of a row is set where that character is. Only one canvas is
+* tracked at a time (the one most recently asked about, normally the current
+* canvas); cell writers keep it up to date, bulk writers mark it stale.
+*/
+static char (*tracked)[MAXCOLS] = NULL;
+static bool stale = true;
+static bool overflowed = false;
+static int planeOf[256];
+static unsigned char charOf[MAXPLANES];
+static int cellsIn[MAXPLANES];
+static Plane planes[MAXPLANES];
+static int planesUsed = 0;
+static PlaneStats stats = {};
+
+// Histogram of the tracked canvas, and its non-space cells per row and
+// column; kept even when there are too many characters for planes
+static CanvasContent content;
+static int rowInk[MAXROWS];
+static int colInk[MAXCOLS];
+
+static int popCount(unsigned long long word)
+{
+#ifdef _MSC_VER
+    return (int)__popcnt64(word);
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+static int lowestBit(unsigned long long word)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Returns the plane for ch, starting one if needed; -1 if there's no room
+static int planeFor(unsigned char ch)
+{
+    if (planeOf[ch] >= 0)
+    {
+        return planeOf[ch];
+    }
+
+    for (int plane = 0; plane < MAXPLANES; plane++)
+    {
+        if (cellsIn[plane] == 0)
+        {
+            memset(planes[plane], 0, sizeof(Plane));
+            charOf[plane] = ch;
+            planeOf[ch] = plane;
+            if (plane >= planesUsed)
+            {
+                planesUsed = plane + 1;
+            }
+            return plane;
+        }
+    }
+    return -1;
+}
+
+// Drops ch's plane once it holds no cells, so the slot can be reused
+static void dropIfEmpty(int plane)
+{
+    if (cellsIn[plane] == 0)
+    {
+        planeOf[charOf[plane]] = -1;
+    }
+}
+
+// Adds delta cells of ch to the histogram
+static void tally(unsigned char ch, int delta)
+{
+    if (content.counts[ch] == 0)
+    {
+        content.distinct++;
+    }
+    content.counts[ch] += delta;
+    if (content.counts[ch] == 0)
+    {
+        content.distinct--;
+    }
+    if (ch != ' ')
+    {
+        content.inked += delta;
+    }
+}
+
+// Counts a non-space cell in or out of its row and column
+static void ink(int row, int col, int delta)
+{
+    rowInk[row] += delta;
+    colInk[col] += delta;
+}
+
+// Builds the planes for canvas from scratch
+static void rebuild(char canvas[][MAXCOLS])
+{
+    tracked = canvas;
+    stale = false;
+    overflowed = false;
+    planesUsed = 0;
+    for (int ch = 0; ch < 256; ch++)
+    {
+        planeOf[ch] = -1;
+    }
+    memset(cellsIn, 0, sizeof(cellsIn));
+    memset(&content, 0, sizeof(content));
+    memset(rowInk, 0, sizeof(rowInk));
+    memset(colInk, 0, sizeof(colInk));
+    stats.rebuilds++;
+
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            unsigned char ch = (unsigned char)canvas[row][col];
+            tally(ch, 1);
+            if (ch != ' ')
+            {
+                ink(row, col, 1);
+            }
+            if (overflowed)
+            {
+                continue;
+            }
+
+            int plane = planeFor(ch);
+            if (plane < 0)
+            {
+                overflowed = true;
+                stats.overflows++;
+                continue;
+            }
+            planes[plane][row][col / 64] |= 1ULL << (col % 64);
+            cellsIn[plane]++;
+        }
+    }
+}
+
+// Rebuilds if canvas isn't the tracked canvas or has changed in bulk
+static void track(char canvas[][MAXCOLS])
+{
+    if (canvas != tracked || stale)
+    {
+        rebuild(canvas);
+    }
+}
+
+// Returns TRUE if canvas has usable planes, building them if needed
+static bool usable(char canvas[][MAXCOLS])
+{
+    track(canvas);
+    if (overflowed)
+    {
+        stats.fallbacks++;
+    }
+    return !overflowed;
+}
+
+void noteCellWrite(char canvas[][MAXCOLS], int row, int col, char ch)
+{
+    if (canvas != tracked || stale || canvas[row][col] == ch)
+    {
+        return;
+    }
+
+    unsigned char oldCh = (unsigned char)canvas[row][col];
+    tally(oldCh, -1);
+    tally((unsigned char)ch, 1);
+    if ((oldCh == ' ') != (ch == ' '))
+    {
+        ink(row, col, ch == ' ' ? -1 : 1);
+    }
+    if (overflowed)
+    {
+        return;
+    }
+
+    int from = planeOf[oldCh];
+    int to = planeFor((unsigned char)ch);
+    if (to < 0)
+    {
+        // One character too many; scan until the next rebuild
+        overflowed = true;
+        stats.overflows++;
+        return;
+    }
+
+    unsigned long long bit = 1ULL << (col % 64);
+    planes[from][row][col / 64] &= ~bit;
+    cellsIn[from]--;
+    planes[to][row][col / 64] |= bit;
+    cellsIn[to]++;
+    dropIfEmpty(from);
+    stats.cellUpdates++;
+}
+
+void canvasChanged(char canvas[][MAXCOLS])
+{
+    if (canvas == tracked)
+    {
+        stale = true;
+    }
+}
+
+void forgetCanvas(char canvas[][MAXCOLS])
+{
+    if (canvas == tracked)
+    {
+        tracked = NULL;
+        stale = true;
+    }
+}
+
+// Writes ch into every cell of mask, moving those cells to ch's plane
+static bool writeMask(char canvas[][MAXCOLS], const Plane mask, int from, char ch)
+{
+    int to = planeFor((unsigned char)ch);
+    if (to < 0)
+    {
+        return false;
+    }
+
+    // Spaces written over ink, or ink over spaces, change the bounding rectangle
+    int inkDelta = charOf[from] == ' ' ? 1 : ch == ' ' ? -1 : 0;
+
+    int moved = 0;
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int word = 0; word < ROWWORDS; word++)
+        {
+            unsigned long long bits = mask[row][word];
+            planes[from][row][word] &= ~bits;
+            planes[to][row][word] |= bits;
+            moved += popCount(bits);
+
+            // Only the cells that change are touched
+            while (bits != 0)
+            {
+                int col = word * 64 + lowestBit(bits);
+                canvas[row][col] = ch;
+                if (inkDelta != 0)
+                {
+                    ink(row, col, inkDelta);
+                }
+                bits &= bits - 1;
+            }
+        }
+    }
+    tally(charOf[from], -moved);
+    tally((unsigned char)ch, moved);
+    cellsIn[from] -= moved;
+    cellsIn[to] += moved;
+    dropIfEmpty(from);
+    return true;
+}
+
+bool replacePlanes(char canvas[][MAXCOLS], char oldCh, char newCh)
+{
+    if (!usable(canvas))
+    {
+        return false;
+    }
+
+    int from = planeOf[(unsigned char)oldCh];
+    if (from < 0 || oldCh == newCh)
+    {
+        return true;
+    }
+
+    // Merge the old plane into the new one
+    Plane mask;
+    memcpy(mask, planes[from], sizeof(Plane));
+    if (!writeMask(canvas, mask, from, newCh))
+    {
+        stale = true;
+        return false;
+    }
+    return true;
+}
+
+// Shifts a row of bits one column right (towards higher columns) or left
+static void shiftRow(const unsigned long long in[ROWWORDS], unsigned long long out[ROWWORDS], bool right)
+{
+    for (int word = 0; word < ROWWORDS; word++)
+    {
+        if (right)
+        {
+            out[word] = in[word] << 1 | (word > 0 ? in[word - 1] >> 63 : 0);
+        }
+        else
+        {
+            out[word] = in[word] >> 1 | (word < ROWWORDS - 1 ? in[word + 1] << 63 : 0);
+        }
+    }
+    out[ROWWORDS - 1] &= LASTWORDMASK;
+}
+
+bool fillPlanes(char canvas[][MAXCOLS], int row, int col, char newCh)
+{
+    if (!usable(canvas))
+    {
+        return false;
+    }
+
+    int from = planeOf[(unsigned char)canvas[row][col]];
+    if (canvas[row][col] == newCh)
+    {
+        return true;
+    }
+
+    // Grow the filled area from the seed, 64 cells a step, staying inside the
+    // cells holding the old character, until nothing changes
+    const Plane& region = planes[from];
+    Plane filled;
+    memset(filled, 0, sizeof(Plane));
+    filled[row][col / 64] = 1ULL << (col % 64);
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            // Downward then upward, so vertical runs spread in one sweep
+            for (int i = 0; i < MAXROWS; i++)
+            {
+                int r = pass == 0 ? i : MAXROWS - 1 - i;
+                unsigned long long grown[ROWWORDS], left[ROWWORDS], right[ROWWORDS];
+                memcpy(grown, filled[r], sizeof(grown));
+
+                for (int word = 0; word < ROWWORDS; word++)
+                {
+                    if (r > 0)
+                        grown[word] |= filled[r - 1][word];
+                    if (r < MAXROWS - 1)
+                        grown[word] |= filled[r + 1][word];
+                    grown[word] &= region[r][word];
+                }
+
+                // Spread along the row until the runs are full
+                bool spreading = true;
+                while (spreading)
+                {
+                    spreading = false;
+                    shiftRow(grown, right, true);
+                    shiftRow(grown, left, false);
+                    for (int word = 0; word < ROWWORDS; word++)
+                    {
+                        unsigned long long next = (grown[word] | right[word] | left[word]) & region[r][word];
+                        if (next != grown[word])
+                        {
+                            grown[word] = next;
+                            spreading = true;
+                        }
+                    }
+                }
+
+                for (int word = 0; word < ROWWORDS; word++)
+                {
+                    if (grown[word] != filled[r][word])
+                    {
+                        filled[r][word] = grown[word];
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    int before = cellsIn[from];
+    if (!writeMask(canvas, filled, from, newCh))
+    {
+        stale = true;
+        return false;
+    }
+    profileCount(PROFFILLCELLS, before - cellsIn[from]);
+    return true;
+}
+
+int findCharacter(char canvas[][MAXCOLS], char ch, Point found[], int maxFound)
+{
+    int count = 0;
+
+    // Counting is a histogram lookup
+    if (found == NULL)
+    {
+        track(canvas);
+        return content.counts[(unsigned char)ch];
+    }
+
+    if (usable(canvas))
+    {
+        int plane = planeOf[(unsigned char)ch];
+        if (plane < 0)
+        {
+            return 0;
+        }
+
+        // Words without the character are skipped whole
+        for (int row = 0; row < MAXROWS; row++)
+        {
+            for (int word = 0; word < ROWWORDS; word++)
+            {
+                unsigned long long bits = planes[plane][row][word];
+                while (bits != 0 && count < maxFound)
+                {
+                    found[count++] = Point(row, word * 64 + lowestBit(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+        return count;
+    }
+
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            if (canvas[row][col] == ch && count < maxFound)
+            {
+                found[count++] = Point(row, col);
+            }
+        }
+    }
+    return count;
+}
+
+const CanvasContent& canvasContent(char canvas[][MAXCOLS])
+{
+    track(canvas);
+
+    // The rectangle comes from the per row and column counts, so it shrinks
+    // as well as grows without rescanning the canvas
+    content.top = 0;
+    content.bottom = -1;
+    content.left = 0;
+    content.right = -1;
+    if (content.inked > 0)
+    {
+        while (rowInk[content.top] == 0)
+            content.top++;
+        content.bottom = MAXROWS - 1;
+        while (rowInk[content.bottom] == 0)
+            content.bottom--;
+        while (colInk[content.left] == 0)
+            content.left++;
+        content.right = MAXCOLS - 1;
+        while (colInk[content.right] == 0)
+            content.right--;
+    }
+    return content;
+}
+
+PlaneStats getPlaneStats()
+{
+    PlaneStats current = stats;
+    current.tracking = tracked != NULL && !stale && !overflowed;
+    current.distinct = 0;
+    for (int plane = 0; plane < planesUsed; plane++)
+    {
+        if (cellsIn[plane] > 0)
+        {
+            current.distinct++;
+        }
+    }
+    return current;
+}
@@ -0,0 +1,264 @@
+#include <cstdio>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "Definitions.h"
+#include "Parallel.h"
+using namespace std;
+
+// Most canvas rows and columns one thumbnail cell stands for; with more clips
+// than fit at this scale the sheet runs to more than one screen
+const int MAXSHEETSCALE = 11;
+
+// Least thumbnails to make per thread before they are split between threads
+const int CLIPSPERTHREAD = 8;
+
+// Largest thumbnail, at a scale of 2
+const int MAXTHUMBCELLS = ((MAXROWS + 1) / 2) * ((MAXCOLS + 1) / 2);
+
+// A clip shrunk for the contact sheet
+struct Thumbnail
+{
+    unsigned long long key;     // what the clip held when it was made (see clipKey)
+    int scale;                  // canvas cells per thumbnail cell, across and down
+    char cells[MAXTHUMBCELLS];  // thumbRows(scale) rows of thumbCols(scale) cells
+};
+
+// A thumbnail to make, and the canvas to make it from
+struct ThumbnailJob
+{
+    Thumbnail* thumbnail;
+    CanvasRow* canvas;
+};
+
+// Thumbnails by the clip they show
+static unordered_map<Node*, Thumbnail> cache;
+static SheetStats stats = {};
+
+static int thumbRows(int scale)
+{
+    return (MAXROWS + scale - 1) / scale;
+}
+
+static int thumbCols(int scale)
+{
+    return (MAXCOLS + scale - 1) / scale;
+}
+
+// Thumbnails fitting on a sheet, with a blank row and column between them
+static int sheetAcross(int scale)
+{
+    return (MAXCOLS + 1) / (thumbCols(scale) + 1);
+}
+
+static int sheetDown(int scale)
+{
+    return (MAXROWS + 1) / (thumbRows(scale) + 1);
+}
+
+unsigned long long clipKey(Node* node)
+{
+    if (node->tween != NULL && isSpilled(node))
+    {
+        return clipKey(node->tween->base) ^ (unsigned long long)(size_t)node->tween
+            ^ ((unsigned long long)node->tweenFrame << 32);
+    }
+    CanvasRow* canvas = residentCanvas(node);
+    return node->blob->sealed ? node->blob->hash : hashCanvas(canvas);
+}
+
+// Shrinks canvas by scale, each thumbnail cell taking the most common glyph
+// other than space in the cells it stands for (the first to get there on a tie)
+static void shrinkCanvas(char canvas[][MAXCOLS], int scale, char* cells)
+{
+    int rows = thumbRows(scale), cols = thumbCols(scale);
+    int counts[256] = {};
+
+    for (int row = 0; row < rows; row++)
+    {
+        int top = row * scale, bottom = min(top + scale, MAXROWS);
+        for (int col = 0; col < cols; col++)
+        {
+            int left = col * scale, right = min(left + scale, MAXCOLS);
+            unsigned char best = ' ';
+            int bestCount = 0;
+            for (int r = top; r < bottom; r++)
+            {
+                for (int c = left; c < right; c++)
+                {
+                    unsigned char ch = (unsigned char)canvas[r][c];
+                    if (ch != ' ' && ++counts[ch] > bestCount)
+                    {
+                        best = ch;
+                        bestCount = counts[ch];
+                    }
+                }
+            }
+
+            // Only the glyphs counted need clearing again
+            for (int r = top; r < bottom; r++)
+            {
+                for (int c = left; c < right; c++)
+                {
+                    counts[(unsigned char)canvas[r][c]] = 0;
+                }
+            }
+            cells[row * cols + col] = (char)best;
+        }
+    }
+}
+
+// Makes jobs first .. last - 1
+static void makeThumbnails(ThumbnailJob* jobs, int first, int last)
+{
+    for (int i = first; i < last; i++)
+    {
+        shrinkCanvas(jobs[i].canvas, jobs[i].thumbnail->scale, jobs[i].thumbnail->cells);
+    }
+}
+
+int contactSheetScale(int clips)
+{
+    int scale = 2;
+    while (scale < MAXSHEETSCALE && sheetAcross(scale) * sheetDown(scale) < clips)
+    {
+        scale++;
+    }
+    return scale;
+}
+
+int drawContactSheet(List& clips, int sheet, char canvas[][MAXCOLS], int threads)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int scale = contactSheetScale(clips.count);
+    int perSheet = sheetAcross(scale) * sheetDown(scale);
+    int sheets = max(1, (clips.count + perSheet - 1) / perSheet);
+    sheet = max(0, min(sheet, sheets - 1));
+
+    // The clips on this sheet, oldest first as they are numbered
+    int first = sheet * perSheet, last = min(first + perSheet, clips.count);
+    vector<Node*> shown(last - first);
+    int number = clips.count - 1;
+    for (Node* node = clips.head; node != NULL; node = node->next, number--)
+    {
+        if (number >= first && number < last)
+        {
+            shown[number - first] = node;
+        }
+    }
+
+    // Thumbnails still showing what their clip holds are kept; the others are made again
+    vector<ThumbnailJob> jobs;
+    vector<Node*> stale;
+    for (size_t i = 0; i < shown.size(); i++)
+    {
+        Node* node = shown[i];
+        unsigned long long key = clipKey(node);
+        Thumbnail& thumbnail = cache[node];
+        if (thumbnail.key == key && thumbnail.scale == scale)
+        {
+            stats.reused++;
+            continue;
+        }
+        thumbnail.key = key;
+        thumbnail.scale = scale;
+
+        ThumbnailJob job = { &thumbnail, NULL };
+        jobs.push_back(job);
+        stale.push_back(node);
+    }
+    int count = (int)jobs.size();
+    vector<CanvasRow*> canvases(count);
+    ListItemType* frames = clipCanvases(stale.data(), count, canvases.data());
+    for (int i = 0; i < count; i++)
+    {
+        jobs[i].canvas = canvases[i];
+    }
+
+    threads = parallelFor(count, min(threads, count / CLIPSPERTHREAD), [&](int first, int last) { makeThumbnails(jobs.data(), first, last); });
+    delete[] frames;
+    stats.made += count;
+    stats.threads = max(stats.threads, threads);
+
+    // Tile them row after row
+    initCanvas(canvas);
+    int rows = thumbRows(scale), cols = thumbCols(scale), across = sheetAcross(scale);
+    for (size_t i = 0; i < shown.size(); i++)
+    {
+        const Thumbnail& thumbnail = cache[shown[i]];
+        int top = (int)i / across * (rows + 1), left = (int)i % across * (cols + 1);
+        for (int row = 0; row < rows; row++)
+        {
+            memcpy(&canvas[top + row][left], &thumbnail.cells[row * cols], cols);
+        }
+    }
+    canvasChanged(canvas);
+
+    // Clips gone from the list take their thumbnails with them
+    if ((int)cache.size() > clips.count)
+    {
+        unordered_set<Node*> listed;
+        for (Node* node = clips.head; node != NULL; node = node->next)
+        {
+            listed.insert(node);
+        }
+        for (unordered_map<Node*, Thumbnail>::iterator it = cache.begin(); it != cache.end();)
+        {
+            if (listed.count(it->first) == 0)
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    stats.sheets++;
+    stats.cached = (int)cache.size();
+    stats.lastMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return sheets;
+}
+
+SheetStats getSheetStats()
+{
+    return stats;
+}
+
+void contactSheetMenu(Node* current, List& undoList, List& redoList, List& clips)
+{
+    static ListItemType sheetCanvas;
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    int sheet = 0, sheets;
+    char input;
+
+    do {
+        int made = stats.made, reused = stats.reused;
+        sheets = drawContactSheet(clips, sheet, sheetCanvas, threads);
+        int scale = contactSheetScale(clips.count);
+        int perSheet = sheetAcross(scale) * sheetDown(scale);
+
+        displayCanvas(sheetCanvas);
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Clips " << sheet * perSheet + 1 << "-" << min((sheet + 1) * perSheet, clips.count) << " of " << clips.count
+            << " at 1/" << scale << " size (sheet " << sheet + 1 << "/" << sheets << "): " << stats.made - made
+            << " thumbnails made and " << stats.reused - reused << " cached in " << stats.lastMs << " ms";
+        clearLine(MAXROWS + 2, CLEARCOLS);
+        cout << "<N>ext sheet / <C>opy this sheet to the canvas / any other key to return . . .";
+        input = getKey();
+        if (input == 'n' || input == 'N')
+        {
+            sheet = (sheet + 1) % sheets;
+        }
+    } while (input == 'n' || input == 'N');
+
+    if (input == 'c' || input == 'C')
+    {
+        addUndoState(undoList, redoList, current);
+        copyCanvas(current->item, sheetCanvas);
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
@@ -6,6 +6,27 @@ const int BUFFERSIZE = 20;
 const int FILENAMESIZE = 255;
 const int CLEARCOLS = 200;
 
+// Milliseconds each clip shows for when the clips play (and in exported animations)
+const int FRAMEMS = 100;
+
+// Default memory budget for resident undo/redo states, in bytes
+const long long HISTORYBUDGET = 512 * 1024;
+
+// Default memory limits for the canvases, in bytes: past the soft limit the
+// status line warns, past the hard limit new undo states and clips are refused
+const long long MEMORYSOFTLIMIT = 64LL * 1024 * 1024;
+const long long MEMORYHARDLIMIT = 256LL * 1024 * 1024;
+
+// File holding the saved session (canvas, undo/redo history and clips)
+const char SESSIONFILE[] = "SavedFiles/session.tas";
+
+// Log of the edits made since the last session checkpoint
+const char OPLOGFILE[] = "SavedFiles/session.log";
+
+// Trace files written by the profiler
+const char PROFILEJSON[] = "SavedFiles/profile.json";
+const char PROFILECSV[] = "SavedFiles/profile.csv";
+
 // ASCII codes for special keys; for editing
 const char ESC = 27;
 const char LEFTARROW = 75;
@@ -17,11 +38,53 @@ const char SPECIAL = (char)224;
 // Canvas type definition (2D array of characters)
 typedef char ListItemType[MAXROWS][MAXCOLS];
 
+// Worst case size of a canvas compressed with packBytes
+const int PACKEDCANVASSIZE = sizeof(ListItemType) + sizeof(ListItemType) / 128 + 1;
+
+// A single row of a canvas; canvases are passed around as pointers to their rows
+typedef char CanvasRow[MAXCOLS];
+
+// Canvas contents held by the canvas store (see CanvasStore.cpp)
+// Identical canvases in the undo, redo and clips lists share one sealed blob
+struct CanvasBlob
+{
+    ListItemType item;
+    unsigned long long hash;    // hash of item, only valid while sealed
+    int refCount;               // number of nodes using this blob
+    bool sealed;                // sealed blobs are shared and must not be modified
+    long sessionOffset;         // record holding this canvas in the session file, 0 if none
+    CanvasBlob* nextInBucket;   // chain in the store's hash table
+};
+
+struct Tween;
+struct CanvasPatch;
+
 // Node structure for linked lists
+// item points at the rows of blob, so node->item can be used like a canvas
+// When a state is paged out, item and blob are NULL and the compressed canvas
+// lives either at spillOffset in the spill file or at sessionOffset in the session file
+// A clip that is a tween frame has no canvas until one is needed (see Tweens.cpp)
+// An undo or redo state may hold only the cells an operation changed (see RegionUndo.cpp)
 struct Node
 {
-    ListItemType item;
+    CanvasRow* item;
+    CanvasBlob* blob;
     Node* next;
+    long spillOffset;
+    int spillLength;            // 0 when the node is not in the spill file
+    long sessionOffset;         // 0 when the node is not in the session file
+    Tween* tween;               // tween this clip is a frame of, NULL if none
+    int tweenFrame;             // which frame, 0 being the tween's base canvas
+    CanvasPatch* patch;         // cells held in place of a canvas, NULL if none
+};
+
+// Counters describing the canvas store
+struct StoreStats
+{
+    int uniqueCanvases;         // sealed blobs currently in the store
+    int handles;                // nodes currently sharing those blobs
+    long long bytesSaved;       // bytes not allocated right now thanks to dedup
+    long long totalBytesSaved;  // bytes saved by every dedup hit this session
 };
 
 // List structure to manage linked lists
@@ -58,6 +121,376 @@ struct DrawPoint
 };
 
 
+// Counters describing the undo/redo history and its spill file
+struct HistoryStats
+{
+    long long budget;           // bytes of resident history allowed
+    int residentStates;         // undo/redo states held in memory
+    int spilledStates;          // undo/redo states paged out to the spill or session file
+    long long spilledBytes;     // compressed size of the states in the spill file
+    long long spillFileBytes;   // size of the spill file, including released space
+    int pageIns;                // states read back into memory this session
+    int regionStates;           // resident states holding only the cells an operation changed
+};
+
+// Counters describing the session file
+struct SessionStats
+{
+    bool active;                // false if the session file could not be opened
+    double openMs;              // time taken by openSession
+    int restoredStates;         // undo/redo/clip states restored at startup
+    int canvasRecords;          // canvases written to the session file this run
+    int listsRecords;           // lists records written this run
+    long long fileBytes;        // current size of the session file
+    long long bytesWritten;     // bytes appended this run
+};
+
+
+// Counters describing the operation log
+struct OpLogStats
+{
+    bool active;                // false if the log could not be opened
+    int opsLogged;              // operations logged this run
+    int cellOps;                // of which single cell writes (editing keystrokes)
+    long long payloadBytes;     // bytes of encoded operations
+    long long bytesLogged;      // bytes written to the log, framing included
+    int commits;                // group commits (each one write and one sync)
+    double appendUs;            // average time logOperation adds to an edit
+    double maxAppendUs;         // slowest logOperation call
+    double commitMs;            // average time to write and sync a group
+    int recoveredOps;           // operations replayed from the log at startup
+};
+
+// Kinds of canvas operation; see Operation
+enum OpType
+{
+    OPUNDO,     // add an undo state (no fields)
+    OPCELL,     // store ch at start
+    OPFILL,     // fill the area containing start with ch
+    OPLINE,     // draw a line from start to end
+    OPBOX,      // draw a box of height size around start
+    OPBOXES,    // draw nested boxes of largest height size around start
+    OPTREE,     // draw a tree of height size from start, with branch angle angle
+    OPREPLACE,  // replace ch with newCh everywhere
+    OPMOVE,     // shift the canvas by end.row rows and end.col columns
+    OPCLEAR,    // clear the canvas
+    OPCLIP,     // add the canvas to the clips (recorded in macros, never logged)
+    OPTRANSFORM // transform (angle, a Transform) what is in the rectangle from start to end, scaling by size
+};
+
+// Geometric transforms of part of the canvas (see Transforms.cpp)
+enum Transform
+{
+    TRANSMIRROR,        // flip left to right
+    TRANSFLIP,          // flip upside down
+    TRANSPOSE,          // swap rows and columns
+    TRANSROTATE90,      // quarter turn clockwise
+    TRANSROTATE180,     // half turn
+    TRANSROTATE270,     // quarter turn counterclockwise
+    TRANSSCALE,         // scale up size times, each cell becoming a square of cells
+    TRANSFORMS
+};
+
+// Largest factor TRANSSCALE scales by
+const int MAXSCALEFACTOR = 8;
+
+/*
+* A single canvas operation with its parameters, as chosen in the menus
+* Operations can be logged, recorded and applied again to any canvas
+*/
+struct Operation
+{
+    OpType type;
+    Point start;
+    Point end;
+    int size;
+    int angle;
+    char ch;
+    char newCh;
+};
+
+// Longest encoding of an Operation
+const int MAXOPSIZE = 9;
+
+// Counters describing terminal input and output
+struct TerminalStats
+{
+    int frames;                 // canvases drawn
+    int writes;                 // write calls made for output
+    long long bytesWritten;     // bytes of output, escape sequences included
+    int reads;                  // calls made to wait for or read keys
+    int modeSwitches;           // terminal switched between line and key input
+    int keysPresented;          // keys from the input thread shown on screen
+    int keyFrames;              // frames that showed them
+    double latencyMs;           // average time from reading a key to showing it
+    double maxLatencyMs;        // slowest key to show
+};
+
+// Counters describing the character planes
+struct PlaneStats
+{
+    bool tracking;              // false if no canvas has usable planes right now
+    int distinct;               // characters with a plane
+    int rebuilds;               // planes built from scratch
+    int cellUpdates;            // single cells updated in place
+    int overflows;              // rebuilds that found more characters than planes
+    int fallbacks;              // queries answered by scanning instead
+};
+
+// What is on a canvas, kept up to date as cells are written (see CharPlanes.cpp)
+struct CanvasContent
+{
+    int counts[256];            // cells holding each character (index with unsigned char)
+    int distinct;               // characters present
+    int inked;                  // cells that aren't spaces
+    int top, left;              // first row and column holding a non-space
+    int bottom, right;          // last row and column holding one; bottom < top when blank
+};
+
+// Most characters in a tween's palette
+const int PALETTESIZE = 32;
+
+// A run of clips described as a base canvas and what changes from frame to frame
+// Frame k is the base shifted by k steps, with its palette cycled k steps
+struct Tween
+{
+    Node* base;                 // the first frame, a sealed handle
+    int rowStep, colStep;       // shift per frame
+    bool wrap;                  // what moves off one edge comes back on the other
+    char palette[PALETTESIZE];  // characters cycled through, each becoming the next
+    int paletteLength;          // 0 for no palette
+    int paletteStep;            // palette places moved per frame
+    int refCount;               // clips that are frames of this tween
+};
+
+// A rectangle of cells, corners included; empty when bottom < top
+struct CellRect
+{
+    int top, left;
+    int bottom, right;
+};
+
+// An undo or redo state holding only the cells of a rectangle: the state is
+// the canvas of its neighbour nearer the current canvas (or the current canvas
+// itself) with these cells put back
+struct CanvasPatch
+{
+    CellRect bounds;
+    char* cells;                // the rectangle's cells, row after row
+};
+
+// Counters describing the tweens
+struct TweenStats
+{
+    int tweens;                 // tweens with frames still in use
+    int lazyFrames;             // tween frames with no canvas in memory
+    int framesDrawn;            // frames drawn for playing, saving or searching
+    int framesKept;             // frames given a canvas of their own (to be edited)
+};
+
+// Cells of a cellular automaton, alive or dead, one bit each and 64 to a word
+// Bit col % 64 of word col / 64 holds the cell at col; bits past cols are 0
+struct CellGrid
+{
+    int rows, cols;
+    int words;                  // words per row
+    unsigned long long* bits;   // rows * words words, row after row
+};
+
+// A life-like rule: bit n of born (survive) is set if a dead (live) cell with
+// n live neighbours is alive in the next generation; B3/S23 is Conway's Life
+struct AutomatonRule
+{
+    unsigned short born;
+    unsigned short survive;
+};
+
+// Most levels a Pyramid can have
+const int MAXPYRAMIDLEVELS = 24;
+
+// A grid of cells shrunk by half again and again, for viewing it zoomed out
+// (see Overview.cpp). Cell row, col of level n + 1 stands for the (up to) 2x2
+// cells of level n at 2 * row, 2 * col; it holds whichever of their glyphs other
+// than space stands for the most cells of level 0, and how many cells that is
+struct Pyramid
+{
+    int levels;
+    int rows[MAXPYRAMIDLEVELS], cols[MAXPYRAMIDLEVELS];
+    char* glyphs[MAXPYRAMIDLEVELS];     // rows * cols cells of each level, row after row
+    int* weights[MAXPYRAMIDLEVELS];     // cells of level 0 each glyph stands for
+};
+
+// A run of cells an edit script overwrites, from row, col rightwards
+struct CellRun
+{
+    int row, col;
+    int length;
+};
+
+// Most runs an edit script for one canvas can have: every other cell changed
+const int MAXDIFFRUNS = MAXROWS * ((MAXCOLS + 1) / 2);
+
+// Pixels a cell takes in an exported image at a pixel size of 1; the font is
+// 8x8, each row drawn twice so the cells keep the shape they have on screen
+const int GLYPHWIDTH = 8;
+const int GLYPHHEIGHT = 16;
+
+// Largest pixel size an image can be exported at
+const int MAXPIXELSIZE = 4;
+
+// A grayscale image, one byte of luminance (0 black .. 255 white) per pixel
+struct GrayImage
+{
+    int width, height;
+    unsigned char* pixels;      // width * height bytes, row after row
+};
+
+// A FIGlet font, loaded with loadFont (see Banner.cpp)
+struct Font;
+
+// Widest banner renderBanner will build
+const int MAXBANNERWIDTH = 1024;
+
+// Counters describing the banner fonts and their glyph cache
+struct BannerStats
+{
+    int fonts;                  // fonts loaded
+    int glyphsParsed;           // glyphs parsed into the atlases
+    long long atlasBytes;       // bytes of parsed glyphs
+    long long lookups;          // glyphs looked up while rendering
+    long long misses;           // lookups that had to parse the glyph
+    int renders;                // banners rendered
+    double renderUs;            // time spent rendering them
+};
+
+// What memory is allocated for, as accounted by countAllocation
+enum MemoryKind
+{
+    MEMCANVAS,      // canvas blobs, the current canvas included
+    MEMNODE,        // list nodes
+    MEMTWEEN,       // tweens
+    MEMPATCH,       // region undo and redo states
+    MEMKINDS
+};
+
+// Memory used by one list of states; each state is charged its node and its
+// share of its canvas, so shared canvases are counted once between them
+struct ListMemory
+{
+    int states;
+    long long liveBytes;        // bytes in memory now
+    long long peakBytes;        // most liveBytes seen this run
+    int privateCanvases;        // canvases only this state uses
+    int sharedCanvases;         // canvases stored once for several states
+    int lazyStates;             // tween frames and session states with no canvas in memory yet
+    int regionStates;           // states holding only the cells an operation changed
+    int spilledStates;          // states paged out to the spill file
+    long long spilledBytes;     // their compressed size on disk (not in liveBytes)
+};
+
+// Memory accounting for the undo, redo and clip lists (see Memory.cpp)
+struct MemoryStats
+{
+    ListMemory undo, redo, clips;
+    long long kindBytes[MEMKINDS];  // bytes allocated for each kind
+    long long liveBytes;            // all of them
+    long long peakBytes;            // most liveBytes seen this run
+    long long softLimit;
+    long long hardLimit;
+    int refusals;                   // clips refused, or undo states made room for, over the hard limit
+};
+
+// Hot paths timed by the profiler (see Profiler.cpp)
+enum ProfileTimer
+{
+    PROFDISPLAY,    // displayCanvas
+    PROFOPERATION,  // applyOperation: fills, lines, boxes, trees, ...
+    PROFUNDO,       // addUndoState
+    PROFLOADCLIPS,  // loadClips
+    PROFTIMERS
+};
+
+// Work counted by the profiler
+enum ProfileCounter
+{
+    PROFDRAWS,      // drawHelper calls
+    PROFFILLCELLS,  // cells visited by fillRecursive, or filled 64 at a time by fillPlanes
+    PROFUNDOBYTES,  // canvas bytes copied by addUndoState (0 when the store had a copy)
+    PROFFILEOPENS,  // files opened by loadClips
+    PROFCOUNTERS
+};
+
+// Counters describing the profiler, totals since it was last turned on
+struct ProfileStats
+{
+    bool enabled;                       // false while the profiler is off
+    int calls[PROFTIMERS];              // timed calls of each hot path
+    double totalMs[PROFTIMERS];         // time spent in them
+    double maxMs[PROFTIMERS];           // slowest call
+    long long counts[PROFCOUNTERS];     // work counted
+    int events;                         // timed calls kept for the trace
+    int droppedEvents;                  // older ones the trace had no room for
+};
+
+// Counters describing the onion skin
+struct OnionStats
+{
+    int frames;                 // clips shown either side of the canvas, 0 when off
+    int clip;                   // clip the canvas stands for, clip count + 1 for a new one
+    int layerCells;             // cells where a neighbouring clip shows
+    int layerBuilds;            // times the neighbouring clips were composited
+    int fullFrames;             // frames drawn whole
+    int incrementalFrames;      // frames drawing only the cells that changed
+    long long cellsWritten;     // cells those incremental frames drew
+};
+
+// Counters describing the contact sheet and its thumbnail cache
+struct SheetStats
+{
+    int sheets;                 // sheets drawn
+    int made;                   // thumbnails made
+    int reused;                 // thumbnails taken from the cache, their clip unchanged
+    int cached;                 // thumbnails in the cache now
+    int threads;                // most threads used to make them
+    double lastMs;              // time the last sheet took
+};
+
+// Result of comparing two canvases or two sets of clips
+struct DiffStats
+{
+    int clips;                  // clips compared (1 for two canvases)
+    int clipsSkipped;           // clips sharing one canvas, so not looked at cell by cell
+    int clipsChanged;           // clips the patch changes, adds or removes
+    long long rowsSkipped;      // rows found unchanged by comparing them whole
+    long long runs;             // runs of cells in the edit scripts
+    long long cells;            // cells in those runs
+    int threads;                // threads the clips were compared on
+    double ms;                  // time taken
+};
+
+// Result of exporting the canvas or the clips as an image
+struct ExportStats
+{
+    int width, height;          // image size in pixels
+    int frames;                 // frames written
+    int framesFolded;           // clips unchanged from the one before, shown longer instead
+    long long pixels;           // pixels drawn and compressed
+    long long bytes;            // size of the file
+    int glyphsDrawn;            // glyph bitmaps drawn for the glyph cache, 0 if cached already
+    int threads;                // threads the frames were drawn and compressed on
+    double encodeMs;            // time taken drawing and compressing
+    double ms;                  // time taken in all, writing the file included
+};
+
+// Result of replaying a macro
+struct MacroStats
+{
+    int steps;                  // operations in the macro
+    int canvases;               // canvases it was replayed on
+    double ms;                  // time the replay took
+};
+
+
 //--------------------New Functions---------------------------------------------------------------------
 
 /*
@@ -68,16 +501,31 @@ Node* newCanvas();
 /*
 * Creates and returns a new node, which contains a single canvas, where the canvas
 * contains a copy of the one which is inside oldNode
+* The copy is a sealed handle from the canvas store; if an identical canvas is
+* already stored no new canvas is allocated. Use makeWritable before editing it.
 */
 Node* newCanvas(Node* oldNode);
 
 /*
 * Adds a node to the front of a linked list
+* The node's canvas is sealed into the canvas store, so it is shared with any
+* identical canvas already held by a list and must not be modified afterwards
 * listToUpdate is a structure containing the linked list to which the node is to be added
 * nodeToAdd is the node which should be inserted at the front of the linked list
 */
 void addNode(List& listToUpdate, Node* nodeToAdd);
 
+/*
+* Adds a node to the front of the clips list, as addNode, unless the canvases
+* are over the hard memory limit; then the node is deleted and FALSE returned
+*/
+bool addClip(List& clips, Node* node);
+
+/*
+* Fills nodes with the clips, oldest first as they are numbered
+*/
+void clipNodes(List& clips, Node* nodes[]);
+
 /*
 * Removes a node from the front of a linked list
 * listToUpdate is a structure containing the linked list from which the node is to be removed
@@ -86,6 +534,11 @@ void addNode(List& listToUpdate, Node* nodeToAdd);
 */
 Node* removeNode(List& listToUpdate);
 
+/*
+* Deletes a single node, releasing its canvas
+*/
+void deleteNode(Node* node);
+
 /*
 * Deletes all of the nodes in a linked list
 * listToUpdate is a structure containing the linked list to be deleted
@@ -98,13 +551,29 @@ void deleteList(List& listToDelete);
 * undoList the list to which the new undo state is to be added
 * redoList is the list containing the redo states
 * current is a node reprsenting the current drawing canvas
+* Over the hard memory limit, the oldest undo states are deleted to make room
 */
 void addUndoState(List& undoList, List& redoList, Node* current);
 
+/*
+* Adds an undo state holding only the cells of current that op will change,
+* or the whole canvas if op may change most of it; call it before applying op
+*/
+void addUndoState(List& undoList, List& redoList, Node* current, Operation op);
+
+/*
+* Adds an undo state holding only the cells of current inside bounds
+* Whatever is done before the next undo state must stay inside bounds
+*/
+void addUndoState(List& undoList, List& redoList, Node* current, CellRect bounds);
+
 /*
 * Undo or Redo operation
 * Adds current node to the front of the redoList, then removes a node
 * from the front of the undoList and sets this as the current node
+* The new current node is made writable so it can be edited again
+* A region state instead swaps its cells with the current canvas and moves
+* across to the redoList
 */
 void restore(List& undoList, List& redoList, Node*& current);
 
@@ -157,172 +626,1085 @@ bool loadClips(List& clips, char filename[]);
 bool saveClips(List& clips, char filename[]);
 
 
-//--------------------Modified Functions---------------------------------------------------------------
+/*
+* Displays the statistics screen over the drawing area until a key is pressed
+* Pressing <B> on the statistics screen changes the history memory budget
+* undoList, redoList and clips are the lists whose statistics are shown
+*/
+void displayStats(List& undoList, List& redoList, List& clips);
+
+
+//--------------------Canvas Store----------------------------------------------------------------------
 
 /*
-* Opens the specified filename for reading; assumed to be a TXT file.
-* Filename is assumed to be in the form: "SavedFiles\example.txt"
-* If the file can be opened for reading, this function loads the
-* file's contents into current canvas, and then returns TRUE.
-* If the file cannot be opened for reading, returns FALSE.
-* If the file cannot be opened, canvas is left unchanged.
+* Computes a 64-bit FNV-1a hash of the canvas contents
 */
-bool loadCanvas(char canvas[][MAXCOLS], char filename[]);
+unsigned long long hashCanvas(char canvas[][MAXCOLS]);
 
 /*
-* Opens the specified filename for writing; assumed to be a TXT file.
-* If the file can be opened for writing, this function writes the
-* current canvas contents into the file, and then returns TRUE.
-* If the file cannot be opened for writing, returns FALSE.
+* Gives node a new private canvas which may be modified (contents uninitialized)
+* node must not currently hold a canvas
 */
-bool saveCanvas(char canvas[][MAXCOLS], char filename[]);
+void allocateCanvas(Node* node);
 
 /*
-* Secondary menu used for choosing the new drawing functions.
-* Menu repeats until the user enters 'M' to return to the main menu.
-* current is a Node representing the main drawing canvas
-* undoList is a List of nodes, holding all of the undo states
-* redoList is a List of nodes, holding all of the redo states
-* clips is a List of nodes, representing the current animation clip
-* animate - true: animate / false: no animation
-*   animate will be updated to reflect the menu option chosen by the user
+* Seals the canvas of node into the canvas store. If an identical canvas is
+* already stored, the node's own copy is freed and the node shares the stored one.
+* Sealed canvases must not be modified. Does nothing if the node is already sealed.
 */
-void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool& animate);
+void sealCanvas(Node* node);
 
+/*
+* Gives node a private canvas which may be modified. If the node's canvas is
+* shared with other nodes it is copied; otherwise it is simply removed from the store.
+*/
+void makeWritable(Node* node);
 
-//--------------------Old Functions---------------------------------------------------------------------
+/*
+* Makes node refer to the same sealed canvas as source (adding a reference)
+* node must not currently hold a canvas
+*/
+void shareCanvas(Node* node, Node* source);
 
 /*
-* Allows user to choose a location on the screen moving the cursor around with arrow keys.
-* Continues until the ESC key is pressed, or an ASCII printable character is entered.
-* Returns: the character entered by the user
-*   Point pt will be updated to reflect the point chosen by the user
+* Releases the node's reference to its canvas, freeing the canvas when no
+* other node uses it
 */
-char getPoint(Point& pt);
+void releaseCanvas(Node* node);
 
 /*
-* Recursive function to fill a section of the canvas. Replaces all of adjacent oldCh characters in
-* the canvas section with newCh.
-* row and col is the row and column of the starting location where filling should begin
-* oldCh is the character in the section to be replaced
-* newCh is the character to replace with
-* animate - true: animate / false: no animation
+* Returns the current canvas store counters
 */
-void fillRecursive(char canvas[][MAXCOLS], int row, int col, char oldCh, char newCh, bool animate);
+StoreStats getStoreStats();
+
+
+//--------------------History Spill---------------------------------------------------------------------
 
 /*
-* Stores character ch into canvas at location p
-* p is the Point(row, col) where the character is to be stored
-* ch is the character to store
-* if animate is true animation is also performed by drawing the character
-* to the screen at the same time it is being stored in the canvas
+* Compresses size bytes of data into out using PackBits run-length encoding
+* out must have room for at least size + size / 128 + 1 bytes
+* Returns the number of bytes written to out
 */
-void drawHelper(char canvas[][MAXCOLS], Point p, char ch, bool animate);
+int packBytes(const unsigned char data[], int size, unsigned char out[]);
 
 /*
-* Draws a line between two points into the canvas.
-* start is the point representing one end of the line
-* end is the point reprsenting the other end of the line
-* animate - true: animate the drawing / false: no animation
+* Expands PackBits data produced by packBytes into out, which has room for size bytes
+* Returns false if the packed data is corrupt or does not expand to exactly size bytes
 */
-void drawLine(char canvas[][MAXCOLS], DrawPoint start, DrawPoint end, bool animate);
+bool unpackBytes(const unsigned char packed[], int length, unsigned char out[], int size);
 
 /*
-* Draws a box into the canvas, around a central point.
-* center is the point representing the center of the box
-* height is the height of the box (width is automatically proportionally chosen based on canvas size)
-* animate - true: animate the drawing / false: no animation
+* Keeps the undo and redo states nearest to the current canvas in memory and
+* pages out the older ones once the resident states exceed the history budget.
+* States already in the session file are simply dropped from memory; others are
+* compressed into a temporary spill file.
 */
-void drawBox(char canvas[][MAXCOLS], Point center, int height, bool animate);
+void enforceHistoryBudget(List& undoList, List& redoList);
 
 /*
-* Recursive function to draw a series of nested boxes into the canvas, around a central point.
-* center is the point representing the center of the smallest box
-* height is the height of the largest box (width is automatically proportionally chosen based on canvas size)
-* animate - true: animate the drawing / false: no animation
+* Returns true if the node's canvas is paged out to disk
 */
-void drawBoxesRecursive(char canvas[][MAXCOLS], Point center, int height, bool animate);
+bool inline isSpilled(Node* node) { return node->item == NULL; }
 
 /*
-* Recursive function to draw a fractal tree into the canvas.
-* start is the starting point for the tree (the base of the trunk)
-* height is the approximate height of the entire tree
-* startAngle represents the direction in which to draw the trunk where
-*     0 = east, 90 = south, 180 = west, 270 = north
-* branchAngle represents the angle of the branch to the tree trunk
-*     45 means each branch will be at a 45 degree angle from the tree trunk
-* animate - true: animate the drawing / false: no animation
+* Reads a paged out node's canvas back into memory (sealed into the canvas store)
+* Does nothing if the node is already in memory
 */
-void treeRecursive(char canvas[][MAXCOLS], DrawPoint start, int height, int startAngle, int branchAngle, bool animate);
+void pageIn(Node* node);
 
 /*
-* Finds the end point of a line, given the line's starting point, length, and angle
-* angle: 0 = east, 90 = south, 180 = west, 270 = north
-* Returns: the end point for the line
+* Returns the canvas of a list node, paging it back into memory first if needed
 */
-DrawPoint findEndPoint(DrawPoint start, int len, int angle);
+CanvasRow* residentCanvas(Node* node);
 
 /*
-* Converts a from degrees to radians
-* Returns: angle a in radians
+* Forgets the spilled copy of a node's canvas (used when the node is deleted)
 */
-double inline degree2radian(int a) { return (a * 0.017453292519); }
+void discardSpill(Node* node);
 
 /*
-* Used by the drawLine function to help fill in row gaps in a line
-* col is the column; startRow is the starting row; endRow is the ending row
-* ch is the character to draw; animate - true: animate the drawing / false: no animation
+* Sets the number of bytes of undo/redo states which may stay in memory
 */
-void drawLineFillRow(char canvas[][MAXCOLS], int col, int startRow, int endRow, char ch, bool animate);
+void setHistoryBudget(long long bytes);
 
 /*
-* Initializes canvas to contain all spaces.
+* Returns the current history counters for undoList and redoList
 */
-void initCanvas(char canvas[][MAXCOLS]);
+HistoryStats getHistoryStats(List& undoList, List& redoList);
+
+
+//--------------------Session--------------------------------------------------------------------------
 
 /*
-* Displays canvas contents on the screen, with a border
-* around the right and bottom edges.
+* Opens SESSIONFILE (creating it if missing) and restores the canvas, undo/redo
+* history and clips saved in it. The file is memory-mapped and history/clip states
+* are only decompressed when first used, so opening costs little however long
+* the history is.
+* Returns TRUE and sets current and the lists if a session was restored.
+* Returns FALSE (leaving them unchanged) if there was nothing to restore.
 */
-void displayCanvas(char canvas[][MAXCOLS]);
+bool openSession(Node*& current, List& undoList, List& redoList, List& clips);
 
 /*
-* Allows user to edit the canvas by moving the cursor around and
-* entering characters. Editing continues until the ESC key is pressed.
+* Appends any new canvases and, if anything changed, the current lists to the
+* session file. Called after every menu command.
 */
-void editCanvas(char canvas[][MAXCOLS]);
+void checkpointSession(Node* current, List& undoList, List& redoList, List& clips);
 
 /*
-* Copies contents of the "from" canvas into the "to" canvas.
+* Writes a final checkpoint, compacts the session file if most of it is no
+* longer referenced, and closes it
 */
-void copyCanvas(char to[][MAXCOLS], char from[][MAXCOLS]);
+void closeSession(Node* current, List& undoList, List& redoList, List& clips);
 
 /*
-* Replaces all instances of a character in the canvas.
-* oldCh is the character to be replaced.
-* newCh character is the character to replace with.
+* Reads the canvas record at offset in the session file into canvas
+* Returns FALSE if the record can't be read or is corrupt
 */
-void replace(char canvas[][MAXCOLS], char oldCh, char newCh);
+bool readSessionCanvas(long offset, char canvas[][MAXCOLS]);
 
 /*
-* Shifts contents of the canvas by a specified number of rows and columns.
-* rowValue is the number of rows by which to shift
-*    positive numbers shift downward; negative numbers shift upward
-* colValue is the number of rows by which to shift
-*    positive numbers shift right; negative numbers shift left
+* Returns the session file counters
 */
-void moveCanvas(char canvas[][MAXCOLS], int rowValue, int colValue);
+SessionStats getSessionStats();
+
+
+//--------------------Operations-----------------------------------------------------------------------
 
 /*
-* Clears a line on the output screen, then resets the cursor back to the
-* beginning of this line.
-* lineNum is the line number on the output screen to clear
-* numOfChars is the number of characters to clear on this line
+* Creates an operation of the given type with all of its fields cleared
 */
-void clearLine(int lineNum, int numOfChars);
+Operation newOperation(OpType type);
 
 /*
-* Moves the cursor in the output window to a specified row and column.
-* The next output produced by the program will begin at this position.
+* Applies op to canvas (OPUNDO and OPCLIP do nothing here, the caller handles the lists)
+* animate - true: animate the drawing / false: no animation
 */
-void gotoxy(short row, short col);
\ No newline at end of file
+void applyOperation(char canvas[][MAXCOLS], Operation op, bool animate);
+
+/*
+* Logs op, then applies it to canvas
+* animate - true: animate the drawing / false: no animation
+*/
+void performOperation(char canvas[][MAXCOLS], Operation op, bool animate);
+
+/*
+* Encodes op into out (at least MAXOPSIZE bytes) in its compact binary form
+* Returns the number of bytes written
+*/
+int encodeOperation(Operation op, unsigned char out[]);
+
+/*
+* Decodes one operation from the start of data, which holds length bytes
+* Returns the number of bytes used, or 0 if data doesn't start with a valid operation
+*/
+int decodeOperation(const unsigned char data[], int length, Operation& op);
+
+
+//--------------------Operation Log--------------------------------------------------------------------
+
+/*
+* Opens OPLOGFILE. Operations left in it by a session which didn't exit cleanly
+* are replayed on top of the last session checkpoint (current and the lists)
+* and checkpointed. Then starts the thread which commits logged operations.
+*/
+void openOpLog(Node*& current, List& undoList, List& redoList, List& clips);
+
+/*
+* Appends op to the log. The operation is only buffered here; a background
+* thread writes and syncs buffered operations in groups.
+*/
+void logOperation(Operation op);
+
+/*
+* Writes and syncs every buffered operation before returning
+*/
+void commitOpLog();
+
+/*
+* Starts the log afresh after a session checkpoint which includes every logged
+* operation. baseHash is the hash of the checkpointed current canvas.
+*/
+void resetOpLog(unsigned long long baseHash);
+
+/*
+* Stops the commit thread and closes the log; after a clean exit it is removed
+*/
+void closeOpLog();
+
+/*
+* Flushes file and forces its contents to disk
+* Returns FALSE if either step failed
+*/
+bool syncFile(FILE* file);
+
+/*
+* Returns the operation log counters
+*/
+OpLogStats getOpLogStats();
+
+
+//--------------------Character Planes-----------------------------------------------------------------
+
+/*
+* Keeps the planes of canvas up to date for ch being written at row, col
+* Call before the write (the old character is read from the canvas)
+*/
+void noteCellWrite(char canvas[][MAXCOLS], int row, int col, char ch);
+
+/*
+* Marks the planes of canvas out of date after a change to many cells
+*/
+void canvasChanged(char canvas[][MAXCOLS]);
+
+/*
+* Drops the planes of canvas, whose memory is being freed or reused
+*/
+void forgetCanvas(char canvas[][MAXCOLS]);
+
+/*
+* Replaces oldCh with newCh by merging their planes, touching only changed cells
+* Returns FALSE (and changes nothing) if canvas has too many characters for planes
+*/
+bool replacePlanes(char canvas[][MAXCOLS], char oldCh, char newCh);
+
+/*
+* Flood fills the area containing row, col with newCh, 64 cells per step
+* Returns FALSE (and changes nothing) if canvas has too many characters for planes
+*/
+bool fillPlanes(char canvas[][MAXCOLS], int row, int col, char newCh);
+
+/*
+* Finds the cells holding ch, up to maxFound of them, and returns how many were stored
+* With found NULL, just counts them (from the histogram)
+*/
+int findCharacter(char canvas[][MAXCOLS], char ch, Point found[], int maxFound);
+
+/*
+* Returns the histogram and bounding rectangle of canvas
+* The reference stays valid until the next call for another canvas
+*/
+const CanvasContent& canvasContent(char canvas[][MAXCOLS]);
+
+/*
+* Returns the character plane counters
+*/
+PlaneStats getPlaneStats();
+
+
+//--------------------Pattern Search-------------------------------------------------------------------
+
+/*
+* Finds a rectangular pattern in a canvas of any size
+* text points to rows * cols characters, and pattern to patRows * patCols
+* characters, row after row. Cells of the pattern holding wildcard match any
+* character; pass '\0' for no wildcard.
+* Stores the top left corner of up to maxFound matches in found (NULL to just
+* count them), in row then column order, and returns how many there are
+*/
+int findPattern(const char* text, int rows, int cols, const char* pattern, int patRows, int patCols,
+    char wildcard, Point found[], int maxFound);
+
+/*
+* The same search, trying the pattern at every position cell by cell
+* For checking and timing findPattern
+*/
+int findPatternNaive(const char* text, int rows, int cols, const char* pattern, int patRows, int patCols,
+    char wildcard, Point found[], int maxFound);
+
+/*
+* Asks for a pattern (typed, or read from a saved file) and a wildcard, then
+* highlights where it appears on the current canvas or lists the clips holding it
+*/
+void findMenu(Node* current, List& clips);
+
+
+//--------------------Automaton------------------------------------------------------------------------
+
+/*
+* Reads a rule written as B<counts>/S<counts>, e.g. B3/S23
+* Returns FALSE if text isn't a rule
+*/
+bool parseRule(const char text[], AutomatonRule& rule);
+
+/*
+* Returns a rows x cols grid with every cell dead; free it with deleteGrid
+*/
+CellGrid newGrid(int rows, int cols);
+void deleteGrid(CellGrid& grid);
+
+/*
+* Writes the generation after from into to, a grid of the same size
+* Neighbour counts for 64 cells are added at once with bitwise adders. Cells
+* past the edges are dead, or with wrap the grid is a torus. Large grids are
+* split into bands of rows stepped by up to threads threads.
+*/
+void stepGrid(const CellGrid& from, CellGrid& to, AutomatonRule rule, bool wrap, int threads);
+
+/*
+* Converts between a grid and grid.rows * grid.cols characters, row after row
+* A cell is alive if it holds anything but deadGlyph or a space
+*/
+void gridFromCells(const char* cells, CellGrid& grid, char deadGlyph);
+void cellsFromGrid(const CellGrid& grid, char* cells, char liveGlyph, char deadGlyph);
+
+/*
+* Asks for a rule, the glyphs and the number of generations, then runs the
+* automaton from the current canvas, adding each generation to the clips
+*/
+void automatonMenu(Node* current, List& clips);
+
+
+//--------------------Image Import---------------------------------------------------------------------
+
+/*
+* Loads a PGM or PPM image (binary or ASCII, any depth), turning colour to luminance
+* Returns FALSE if the file can't be read or isn't one; free the image with deleteImage
+*/
+bool loadImage(const char filename[], GrayImage& image);
+void deleteImage(GrayImage& image);
+
+/*
+* Finds the largest rows x cols of cells, at most maxRows x maxCols, showing a
+* width x height image undistorted; cells are taller than wide, as in drawBox
+*/
+void fitImage(int width, int height, int maxRows, int maxCols, int& rows, int& cols);
+
+/*
+* Averages the pixels under each of rows x cols cells into levels, row after
+* row. Large images are split into bands of rows averaged by up to threads threads.
+*/
+void downsampleImage(const GrayImage& image, unsigned char* levels, int rows, int cols, int threads);
+
+/*
+* Turns levels into characters of ramp, which runs from darkest to lightest
+* dither - true: spread the rounding error over the neighbouring cells
+*/
+void shadeCells(const unsigned char* levels, char* cells, int rows, int cols, const char ramp[], bool dither);
+
+/*
+* Asks for an image, or a numbered sequence of them, a ramp and whether to
+* dither; an image replaces the current canvas and a sequence is added to the clips
+*/
+void importMenu(Node* current, List& undoList, List& redoList, List& clips);
+
+
+//--------------------Banners--------------------------------------------------------------------------
+
+/*
+* Loads a FIGlet font (.flf), or returns it if already loaded
+* Returns NULL if the file can't be read or isn't a font
+*/
+Font* loadFont(const char filename[]);
+
+/*
+* Returns the number of rows of font's characters
+*/
+int fontHeight(const Font* font);
+
+/*
+* Renders text in font into cells, fontHeight(font) rows of maxWidth
+* characters, kerning or smushing the characters together as the font says
+* Cells left empty hold '\0'. Characters that don't fit are dropped.
+* Returns the width of the banner
+*/
+int renderBanner(Font* font, const char text[], char* cells, int maxWidth);
+
+/*
+* Draws height rows of width cells, stride apart, with the top left corner at
+* row, col of canvas; empty cells are left alone and what's off the canvas is clipped
+*/
+void blitBanner(char canvas[][MAXCOLS], const char* cells, int height, int width, int stride, int row, int col);
+
+/*
+* Returns the banner counters
+*/
+BannerStats getBannerStats();
+
+/*
+* Asks for a font and some text, and draws it on the current canvas or
+* scrolls it across the canvas into new clips
+*/
+void bannerMenu(Node* current, List& undoList, List& redoList, List& clips);
+
+
+//--------------------Region Undo----------------------------------------------------------------------
+
+/*
+* Returns the number of cells in bounds, 0 if it is empty
+*/
+int rectCells(CellRect bounds);
+
+/*
+* Works out the rectangle of cells op would change on canvas, without changing it
+* Returns FALSE if op may change most of the canvas (clearing, moving, replacing spaces)
+*/
+bool operationBounds(char canvas[][MAXCOLS], Operation op, CellRect& bounds);
+
+/*
+* While bounds isn't NULL, drawHelper grows it to take in each cell instead of drawing
+*/
+void measureDrawing(CellRect* bounds);
+
+/*
+* Returns a list node holding the cells of canvas inside bounds (clipped to the canvas)
+*/
+Node* newPatch(char canvas[][MAXCOLS], CellRect bounds);
+
+/*
+* Exchanges the cells of node's patch with the same cells of canvas, so the
+* patch then holds what it replaced
+*/
+void swapPatch(Node* node, char canvas[][MAXCOLS]);
+
+/*
+* Frees node's patch, if it has one
+*/
+void releasePatch(Node* node);
+
+
+//--------------------Memory---------------------------------------------------------------------------
+
+/*
+* Adds bytes (negative when freed) to what is allocated for kind
+*/
+void countAllocation(MemoryKind kind, long long bytes);
+
+/*
+* Returns TRUE if what is allocated is under the hard limit
+*/
+bool underHardLimit();
+
+/*
+* Returns TRUE if another state may be kept; otherwise the canvases are over
+* the hard limit, and the refusal is counted
+*/
+bool roomForState();
+
+/*
+* Sets the soft and hard memory limits, in bytes
+*/
+void setMemoryLimits(long long softLimit, long long hardLimit);
+
+/*
+* Measures the lists, and returns them with the allocation counters
+*/
+MemoryStats getMemoryStats(List& undoList, List& redoList, List& clips);
+
+
+//--------------------Profiler-------------------------------------------------------------------------
+
+/*
+* Times a hot path from construction to destruction; does nothing while the
+* profiler is off. detail tells calls apart in the trace (the OpType of an operation)
+*/
+struct ProfileScope
+{
+    ProfileScope(ProfileTimer timer, int detail = 0);
+    ~ProfileScope();
+
+    ProfileTimer timer;
+    int detail;
+    long long startNs;              // -1 if the profiler was off when the scope began
+    long long startCounts[PROFCOUNTERS];
+};
+
+/*
+* Adds amount to a profiler counter, if the profiler is on
+*/
+void profileCount(ProfileCounter counter, long long amount);
+
+/*
+* Turns the profiler on (starting from zero) or off
+*/
+void enableProfiler(bool enable);
+
+/*
+* Returns TRUE while the profiler is on
+*/
+bool profilerEnabled();
+
+/*
+* Shows the last command's timings and counts on one line under the menu,
+* or blanks that line while the profiler is off
+*/
+void displayProfileLine();
+
+/*
+* Writes the timed calls kept so far and the counter totals to PROFILEJSON
+* (Chrome trace format, for chrome://tracing or Perfetto) and PROFILECSV
+* Returns FALSE if either file can't be written
+*/
+bool writeProfileTrace();
+
+/*
+* Returns the profiler counters
+*/
+ProfileStats getProfileStats();
+
+
+//--------------------Tweens---------------------------------------------------------------------------
+
+/*
+* Adds frames clips to the end of the animation: the current canvas, then
+* each frame shifted by rowStep, colStep more than the last, and with each
+* character of palette replaced by the one paletteStep places on (cyclically)
+* The clips hold no canvas; each frame is drawn only when it is shown or saved
+*/
+void addTween(List& clips, Node* current, int frames, int rowStep, int colStep, bool wrap,
+    const char palette[], int paletteStep);
+
+/*
+* Draws a tween frame node into canvas
+*/
+void drawTweenFrame(Node* node, char canvas[][MAXCOLS]);
+
+/*
+* Gives a tween frame node a canvas of its own, so it can be edited like any clip
+*/
+void keepTweenFrame(Node* node);
+
+/*
+* Returns the canvas of a clip to read: a tween frame is drawn into a scratch
+* canvas that stays valid until the next call, anything else is paged in
+*/
+CanvasRow* clipCanvas(Node* node);
+
+/*
+* Gives canvases[i] the canvas of nodes[i] to read, for work split between threads:
+* tween frames are drawn here, as that can only be done from this thread, and the
+* rest are paged in. Returns the frames drawn, to delete[] when done (NULL if none)
+*/
+ListItemType* clipCanvases(Node* const nodes[], int count, CanvasRow* canvases[]);
+
+/*
+* Drops node's use of its tween, freeing the tween with its last frame
+*/
+void releaseTween(Node* node);
+
+/*
+* Returns the tween counters
+*/
+TweenStats getTweenStats();
+
+/*
+* Asks for the number of frames and the change between them, and adds the tween
+*/
+void tweenMenu(Node* current, List& clips);
+
+
+//--------------------Onion Skin-----------------------------------------------------------------------
+
+/*
+* Shows the frames clips either side of clip (numbered from 1, the oldest)
+* under the canvas; clip 0 stands for a new clip after the last
+* frames 0 turns the onion skin off
+*/
+void setOnionSkin(int frames, int clip);
+
+/*
+* Returns the number of clips shown either side of the canvas, 0 when off
+*/
+int onionSkinFrames();
+
+/*
+* Composites the neighbouring clips again if clips changed since they were last composited
+*/
+void updateOnionSkin(List& clips);
+
+/*
+* Displays canvas as displayCanvas does, with the neighbouring clips showing
+* dimmed through its blank cells: earlier clips in red, later ones in cyan
+* If incremental, only the cells changed since the last call are drawn, so
+* nothing else may have drawn over the canvas in between
+*/
+void displayOnionSkin(char canvas[][MAXCOLS], bool incremental);
+
+/*
+* Returns the onion skin counters
+*/
+OnionStats getOnionStats();
+
+/*
+* Asks for the number of clips to show either side and which clip the canvas is
+*/
+void onionMenu(List& clips);
+
+
+//--------------------Contact Sheet--------------------------------------------------------------------
+
+/*
+* Identifies what a clip holds, without reading its canvas when it can: the
+* store's hash of a sealed canvas (hashCanvas of it), or for a tween frame not
+* drawn yet its tween and frame. Clips with the same key hold the same canvas.
+*/
+unsigned long long clipKey(Node* node);
+
+/*
+* Returns the canvas cells each thumbnail cell stands for (across and down)
+* on the contact sheet of clips clips: the least that fits them all on one
+* sheet, or the most there is if they need several
+*/
+int contactSheetScale(int clips);
+
+/*
+* Draws sheet (from 0) of the contact sheet into canvas: a thumbnail of each
+* clip, oldest first, row after row. Each thumbnail cell holds the commonest
+* glyph other than space in the cells it stands for. Thumbnails are cached for
+* each clip and only made again once the clip changes; those to make are
+* split between up to threads threads.
+* Returns the number of sheets needed to show every clip
+*/
+int drawContactSheet(List& clips, int sheet, char canvas[][MAXCOLS], int threads);
+
+/*
+* Returns the contact sheet counters
+*/
+SheetStats getSheetStats();
+
+/*
+* Shows the contact sheet a sheet at a time; its current sheet can be copied
+* to the current canvas (adding an undo state first)
+*/
+void contactSheetMenu(Node* current, List& undoList, List& redoList, List& clips);
+
+
+//--------------------Overview-------------------------------------------------------------------------
+
+/*
+* Creates a blank pyramid over rows x cols cells, with levels added until the
+* top one fits on the screen; free it with deletePyramid
+*/
+Pyramid newPyramid(int rows, int cols);
+void deletePyramid(Pyramid& pyramid);
+
+/*
+* Stores ch at row, col of level 0, then updates the cells standing for it on
+* each level above, stopping at the first that doesn't change
+* Returns FALSE if the cell already held ch
+*/
+bool setPyramidCell(Pyramid& pyramid, int row, int col, char ch);
+
+/*
+* Copies the MAXROWS x MAXCOLS cells of level from top, left into canvas;
+* cells past the edges of the level are blank
+*/
+void viewPyramid(const Pyramid& pyramid, int level, int top, int left, char canvas[][MAXCOLS]);
+
+/*
+* Pans and zooms over every clip, oldest first, and then the current canvas,
+* laid out full size in rows of tiles; only the tiles which changed since the
+* last time are written into the pyramid again
+*/
+void overviewMenu(Node* current, List& clips);
+
+
+//--------------------Transforms-----------------------------------------------------------------------
+
+/*
+* Works out the cells an OPTRANSFORM operation reads and writes: from is the
+* part of the operation's rectangle holding something, and to where its
+* transformed cells land, clipped to the canvas. Scaling grows from the top
+* left corner of from; the other transforms keep its centre where it is.
+* Returns FALSE if the rectangle holds nothing, so there is nothing to transform
+*/
+bool transformRects(char canvas[][MAXCOLS], Operation op, CellRect& from, CellRect& to);
+
+/*
+* Applies an OPTRANSFORM operation: blanks from, then writes the transformed
+* cells over to. Glyphs pointing a direction are turned to match, using the
+* glyphs drawLine draws with: a quarter turn swaps | and -, a mirror swaps
+* ` and ' (and / and \ too), and so on
+*/
+void applyTransform(char canvas[][MAXCOLS], Operation op);
+
+/*
+* Asks for the transform and the rectangle (or the whole canvas) to apply it to
+* Returns FALSE if cancelled; otherwise op is the operation to perform
+*/
+bool transformMenu(Operation& op);
+
+
+//--------------------Diff and Patch-------------------------------------------------------------------
+
+/*
+* Compares two canvases row by row, skipping rows that match whole, and writes
+* the edit script turning from into to: the runs of cells to overwrite, in
+* row order, into runs (room for MAXDIFFRUNS), and their new cells one after
+* another into cells (room for a canvas). Unchanged cells between two changed
+* ones are rewritten when that takes fewer bytes in a patch file than another run.
+* Returns the number of runs, 0 if the canvases match
+*/
+int diffCanvas(char from[][MAXCOLS], char to[][MAXCOLS], CellRun runs[], char cells[]);
+
+/*
+* Applies an edit script made by diffCanvas to canvas
+*/
+void patchCanvas(char canvas[][MAXCOLS], const CellRun runs[], int count, const char cells[]);
+
+/*
+* Makes the patch turning canvas from into canvas to, replacing the one held
+* Returns the diff counters
+*/
+DiffStats makeCanvasPatch(char from[][MAXCOLS], char to[][MAXCOLS]);
+
+/*
+* Makes the patch turning the clips of from into the clips of to, replacing
+* the one held. Clips are compared by number, split between up to threads
+* threads; clips only in to are compared with a blank canvas.
+* Returns the diff counters
+*/
+DiffStats makeClipsPatch(List& from, List& to, int threads);
+
+/*
+* Writes the patch held to filename as text, or reads one in its place
+* Returns FALSE if the file can't be written or read, or isn't a patch; a
+* patch that can't be read leaves the one held unchanged
+*/
+bool savePatch(char filename[]);
+bool loadPatch(char filename[]);
+
+/*
+* Applies the patch held to saved files, filename being in the form
+* "SavedFiles/example": example.txt for a canvas patch, or example-1.txt,
+* example-2.txt, ... for a clips patch (only the files it changes are written)
+* Returns FALSE, changing nothing, unless the files hold what the patch was made from
+*/
+bool patchSavedFiles(char filename[]);
+
+/*
+* Applies the patch held to the current canvas (a canvas patch, as one undo
+* step) or to the clips (a clips patch)
+* Returns FALSE, changing nothing, unless they hold what the patch was made from
+*/
+bool patchCurrent(Node* current, List& undoList, List& redoList, List& clips);
+
+/*
+* Compares two saved canvases or animations, shows the clips that changed with
+* the changed cells highlighted, and saves the patch if asked to
+*/
+void diffMenu();
+
+/*
+* Loads a saved patch and applies it to saved files or to the canvas or clips
+*/
+void patchMenu(Node* current, List& undoList, List& redoList, List& clips);
+
+
+//--------------------Export---------------------------------------------------------------------------
+
+/*
+* Draws canvas with the built in font into pixels, a palette index (0 for the
+* background, 1 for ink) per pixel, row after row: MAXCOLS * GLYPHWIDTH *
+* pixelSize pixels across and MAXROWS * GLYPHHEIGHT * pixelSize down
+*/
+void renderCanvas(char canvas[][MAXCOLS], int pixelSize, unsigned char pixels[]);
+
+/*
+* Draws canvas with the built in font into filename as a PNG image, each cell
+* GLYPHWIDTH x GLYPHHEIGHT pixels times pixelSize (1 to MAXPIXELSIZE)
+* Returns FALSE if the file can't be written
+*/
+bool exportPng(char canvas[][MAXCOLS], char filename[], int pixelSize, ExportStats& stats);
+
+/*
+* Draws the clips, oldest first, into filename as an animated GIF which loops
+* like play does, each clip showing for FRAMEMS. All frames share one palette;
+* each holds only the cells changed since the one before, and a clip the same
+* as the one before shows that one for longer. Frames are drawn and
+* compressed on up to threads threads.
+* Returns FALSE if there are no clips or the file can't be written
+*/
+bool exportGif(List& clips, char filename[], int pixelSize, int threads, ExportStats& stats);
+
+/*
+* Exports the canvas as a PNG image or the clips as an animated GIF, showing
+* how long it took
+*/
+void exportMenu(Node* current, List& clips);
+
+
+//--------------------Macros---------------------------------------------------------------------------
+
+/*
+* Starts recording a new macro, replacing the previous one
+*/
+void startMacro();
+
+/*
+* Stops recording; the macro is kept for replaying
+*/
+void stopMacro();
+
+/*
+* Returns TRUE while a macro is being recorded
+*/
+bool isRecordingMacro();
+
+/*
+* Returns the number of operations in the macro
+*/
+int macroLength();
+
+/*
+* Adds op to the macro if one is being recorded (OPUNDO is never recorded)
+*/
+void recordOperation(Operation op);
+
+/*
+* Replays the macro at full speed with nothing drawn between steps
+* allClips - false: on the current canvas, as a single undo step
+*            true: on every clip (OPCLIP steps are skipped)
+* Returns the replay counters
+*/
+MacroStats replayMacro(Node* current, List& undoList, List& redoList, List& clips, bool allClips);
+
+/*
+* Asks whether to record, stop, or replay the macro, and does it
+*/
+void macroMenu(Node* current, List& undoList, List& redoList, List& clips);
+
+
+//--------------------Terminal-------------------------------------------------------------------------
+
+/*
+* Prepares the terminal: everything written to cout is kept and written out in
+* one call when cout is flushed, which happens before any key or line is read
+*/
+void openTerminal();
+
+/*
+* Writes out anything pending and puts the terminal back the way it was found
+*/
+void closeTerminal();
+
+/*
+* Waits for a single key, without echo. Arrow keys return SPECIAL, and the
+* next call returns LEFTARROW, UPARROW, RIGHTARROW or DOWNARROW.
+*/
+char getKey();
+
+/*
+* Like getKey, but returns the key as an unsigned byte (0-255), or -1 straight away
+* if no key has been pressed
+*/
+int pollKey();
+
+/*
+* Starts a thread which reads keys into a queue until ESC is read
+*/
+void startKeyThread();
+
+/*
+* Stops the key thread and drops any keys left in the queue
+*/
+void stopKeyThread();
+
+/*
+* Takes the next key from the key thread, waiting up to ms milliseconds for one
+* Returns FALSE if no key came in time
+*/
+bool nextKeyEvent(char& key, int ms);
+
+/*
+* Takes keys from the key thread until key comes, for up to ms milliseconds
+* Returns TRUE if key came in time
+*/
+bool waitForKey(char key, int ms);
+
+/*
+* Writes out the frame, and records how long the keys taken since the last
+* frame took to reach the screen
+*/
+void presentFrame();
+
+/*
+* Asks for and waits for any key
+*/
+void pauseScreen();
+
+/*
+* Shows what was drawn so far, then waits ms milliseconds
+*/
+void sleepMs(int ms);
+
+/*
+* Counts one frame drawn, for getTerminalStats
+*/
+void countFrame();
+
+/*
+* Returns the terminal counters
+*/
+TerminalStats getTerminalStats();
+
+/*
+* Clears a line on the output screen, then resets the cursor back to the
+* beginning of this line.
+* lineNum is the line number on the output screen to clear
+* numOfChars is the number of characters to clear on this line
+*/
+void clearLine(int lineNum, int numOfChars);
+
+/*
+* Moves the cursor in the output window to a specified row and column.
+* The next output produced by the program will begin at this position.
+*/
+void gotoxy(short row, short col);
+
+
+//--------------------Modified Functions---------------------------------------------------------------
+
+/*
+* Opens the specified filename for reading; assumed to be a TXT file.
+* Filename is assumed to be in the form: "SavedFiles\example.txt"
+* If the file can be opened for reading, this function loads the
+* file's contents into current canvas, and then returns TRUE.
+* If the file cannot be opened for reading, returns FALSE.
+* If the file cannot be opened, canvas is left unchanged.
+*/
+bool loadCanvas(char canvas[][MAXCOLS], char filename[]);
+
+/*
+* Opens the specified filename for writing; assumed to be a TXT file.
+* If the file can be opened for writing, this function writes the
+* current canvas contents into the file, and then returns TRUE.
+* If the file cannot be opened for writing, returns FALSE.
+*/
+bool saveCanvas(char canvas[][MAXCOLS], char filename[]);
+
+/*
+* Secondary menu used for choosing the new drawing functions.
+* Menu repeats until the user enters 'M' to return to the main menu.
+* current is a Node representing the main drawing canvas
+* undoList is a List of nodes, holding all of the undo states
+* redoList is a List of nodes, holding all of the redo states
+* clips is a List of nodes, representing the current animation clip
+* animate - true: animate / false: no animation
+*   animate will be updated to reflect the menu option chosen by the user
+*/
+void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool& animate);
+
+
+//--------------------Old Functions---------------------------------------------------------------------
+
+/*
+* Allows user to choose a location on the screen moving the cursor around with arrow keys.
+* Continues until the ESC key is pressed, or an ASCII printable character is entered.
+* Returns: the character entered by the user
+*   Point pt will be updated to reflect the point chosen by the user
+*/
+char getPoint(Point& pt);
+
+/*
+* Recursive function to fill a section of the canvas. Replaces all of adjacent oldCh characters in
+* the canvas section with newCh.
+* row and col is the row and column of the starting location where filling should begin
+* oldCh is the character in the section to be replaced
+* newCh is the character to replace with
+* animate - true: animate / false: no animation
+*/
+void fillRecursive(char canvas[][MAXCOLS], int row, int col, char oldCh, char newCh, bool animate);
+
+/*
+* Stores character ch into canvas at location p
+* p is the Point(row, col) where the character is to be stored
+* ch is the character to store
+* if animate is true animation is also performed by drawing the character
+* to the screen at the same time it is being stored in the canvas
+*/
+void drawHelper(char canvas[][MAXCOLS], Point p, char ch, bool animate);
+
+/*
+* Draws a line between two points into the canvas.
+* start is the point representing one end of the line
+* end is the point reprsenting the other end of the line
+* animate - true: animate the drawing / false: no animation
+*/
+void drawLine(char canvas[][MAXCOLS], DrawPoint start, DrawPoint end, bool animate);
+
+/*
+* Draws a box into the canvas, around a central point.
+* center is the point representing the center of the box
+* height is the height of the box (width is automatically proportionally chosen based on canvas size)
+* animate - true: animate the drawing / false: no animation
+*/
+void drawBox(char canvas[][MAXCOLS], Point center, int height, bool animate);
+
+/*
+* Recursive function to draw a series of nested boxes into the canvas, around a central point.
+* center is the point representing the center of the smallest box
+* height is the height of the largest box (width is automatically proportionally chosen based on canvas size)
+* animate - true: animate the drawing / false: no animation
+*/
+void drawBoxesRecursive(char canvas[][MAXCOLS], Point center, int height, bool animate);
+
+/*
+* Recursive function to draw a fractal tree into the canvas.
+* start is the starting point for the tree (the base of the trunk)
+* height is the approximate height of the entire tree
+* startAngle represents the direction in which to draw the trunk where
+*     0 = east, 90 = south, 180 = west, 270 = north
+* branchAngle represents the angle of the branch to the tree trunk
+*     45 means each branch will be at a 45 degree angle from the tree trunk
+* animate - true: animate the drawing / false: no animation
+*/
+void treeRecursive(char canvas[][MAXCOLS], DrawPoint start, int height, int startAngle, int branchAngle, bool animate);
+
+/*
+* Finds the end point of a line, given the line's starting point, length, and angle
+* angle: 0 = east, 90 = south, 180 = west, 270 = north
+* Returns: the end point for the line
+*/
+DrawPoint findEndPoint(DrawPoint start, int len, int angle);
+
+/*
+* Converts a from degrees to radians
+* Returns: angle a in radians
+*/
+double inline degree2radian(int a) { return (a * 0.017453292519); }
+
+/*
+* Used by the drawLine function to help fill in row gaps in a line
+* col is the column; startRow is the starting row; endRow is the ending row
+* ch is the character to draw; animate - true: animate the drawing / false: no animation
+*/
+void drawLineFillRow(char canvas[][MAXCOLS], int col, int startRow, int endRow, char ch, bool animate);
+
+/*
+* Initializes canvas to contain all spaces.
+*/
+void initCanvas(char canvas[][MAXCOLS]);
+
+/*
+* Displays canvas contents on the screen, with a border
+* around the right and bottom edges.
+*/
+void displayCanvas(char canvas[][MAXCOLS]);
+
+/*
+* Allows user to edit the canvas by moving the cursor around and
+* entering characters. Editing continues until the ESC key is pressed.
+*/
+void editCanvas(char canvas[][MAXCOLS]);
+
+/*
+* Copies contents of the "from" canvas into the "to" canvas.
+*/
+void copyCanvas(char to[][MAXCOLS], char from[][MAXCOLS]);
+
+/*
+* Replaces all instances of a character in the canvas.
+* oldCh is the character to be replaced.
+* newCh character is the character to replace with.
+*/
+void replace(char canvas[][MAXCOLS], char oldCh, char newCh);
+
+/*
+* Shifts contents of the canvas by a specified number of rows and columns.
+* rowValue is the number of rows by which to shift
+*    positive numbers shift downward; negative numbers shift upward
+* colValue is the number of rows by which to shift
+*    positive numbers shift right; negative numbers shift left
+*/
+void moveCanvas(char canvas[][MAXCOLS], int rowValue, int colValue);
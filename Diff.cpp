@@ -0,0 +1,668 @@
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "Definitions.h"
+#include "Parallel.h"
+using namespace std;
+
+// Bytes a run takes in a patch file besides its cells (about: "12 34 5 " and
+// the line break); fewer unchanged cells than this between two changed ones
+// cost less to rewrite than to start another run
+const int RUNCOST = 8;
+
+// Least clips to compare per thread before they are split between threads
+const int CLIPSPERTHREAD = 8;
+
+// Start of the first line of a patch file, followed by CANVAS or CLIPS and
+// the number of clips it is made from and makes
+const char PATCHHEADER[] = "TEXTART PATCH";
+
+// The edit script for one clip
+struct ClipScript
+{
+    int clip;                       // clip number, from 1 (1 for a canvas patch)
+    unsigned long long before;      // hash of the canvas it applies to
+    vector<CellRun> runs;
+    string cells;                   // new cells of the runs, one after another
+};
+
+// Two canvases to compare, and the script to write
+struct DiffJob
+{
+    CanvasRow* from;
+    CanvasRow* to;
+    ClipScript* script;
+    bool hashed;                    // script->before already holds the hash of from
+};
+
+// The patch last made or loaded: the scripts of the clips it changes, in order
+static vector<ClipScript> scripts;
+static bool clipsPatch = false;
+static int fromCount = 0, toCount = 0;
+
+static CanvasRow* blankCanvas()
+{
+    static ListItemType blank;
+    memset(blank, ' ', sizeof(blank));
+    return blank;
+}
+
+// Returns the first column from col on where rows a and b differ, MAXCOLS if
+// none; eight cells are compared at a time while they match
+static int nextDifference(const char* a, const char* b, int col)
+{
+    while (col + 8 <= MAXCOLS)
+    {
+        unsigned long long x, y;
+        memcpy(&x, &a[col], 8);
+        memcpy(&y, &b[col], 8);
+        if (x != y)
+        {
+            break;
+        }
+        col += 8;
+    }
+    while (col < MAXCOLS && a[col] == b[col])
+    {
+        col++;
+    }
+    return col;
+}
+
+int diffCanvas(char from[][MAXCOLS], char to[][MAXCOLS], CellRun runs[], char cells[])
+{
+    int count = 0, length = 0;
+
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        if (memcmp(from[row], to[row], MAXCOLS) == 0)
+        {
+            continue;
+        }
+
+        int col = nextDifference(from[row], to[row], 0);
+        while (col < MAXCOLS)
+        {
+            // Take in the next changed cell while the gap to it is cheaper than a new run
+            int start = col, end = col;
+            for (;;)
+            {
+                col = nextDifference(from[row], to[row], end + 1);
+                if (col == MAXCOLS || col - end - 1 > RUNCOST)
+                {
+                    break;
+                }
+                end = col;
+            }
+
+            CellRun run = { row, start, end - start + 1 };
+            runs[count++] = run;
+            memcpy(&cells[length], &to[row][start], run.length);
+            length += run.length;
+        }
+    }
+    return count;
+}
+
+void patchCanvas(char canvas[][MAXCOLS], const CellRun runs[], int count, const char cells[])
+{
+    for (int i = 0, at = 0; i < count; at += runs[i++].length)
+    {
+        memcpy(&canvas[runs[i].row][runs[i].col], &cells[at], runs[i].length);
+    }
+    canvasChanged(canvas);
+}
+
+// Compares jobs first .. last - 1
+static void diffJobs(DiffJob* jobs, int first, int last)
+{
+    vector<CellRun> runs(MAXDIFFRUNS);
+    ListItemType cells;
+
+    for (int i = first; i < last; i++)
+    {
+        ClipScript& script = *jobs[i].script;
+        int count = diffCanvas(jobs[i].from, jobs[i].to, &runs[0], &cells[0][0]), length = 0;
+        for (int run = 0; run < count; run++)
+        {
+            length += runs[run].length;
+        }
+        script.runs.assign(runs.begin(), runs.begin() + count);
+        script.cells.assign(&cells[0][0], length);
+        if (count > 0 && !jobs[i].hashed)
+        {
+            script.before = hashCanvas(jobs[i].from);
+        }
+    }
+}
+
+// Drops the scripts changing nothing and adds theirs to the counters
+static void keepChanged(DiffStats& stats)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        if (scripts[i].runs.empty())
+        {
+            continue;
+        }
+
+        // Runs come in row order, so the rows they are on are easily counted
+        int lastRow = -1;
+        for (size_t run = 0; run < scripts[i].runs.size(); run++)
+        {
+            if (scripts[i].runs[run].row != lastRow)
+            {
+                lastRow = scripts[i].runs[run].row;
+                stats.rowsSkipped--;
+            }
+        }
+        stats.runs += scripts[i].runs.size();
+        stats.cells += scripts[i].cells.size();
+        stats.clipsChanged++;
+        swap(scripts[kept++], scripts[i]);
+    }
+    scripts.resize(kept);
+}
+
+DiffStats makeCanvasPatch(char from[][MAXCOLS], char to[][MAXCOLS])
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    DiffStats stats = {};
+
+    clipsPatch = false;
+    fromCount = toCount = 1;
+    scripts.assign(1, ClipScript());
+    scripts[0].clip = 1;
+    DiffJob job = { from, to, &scripts[0], false };
+    diffJobs(&job, 0, 1);
+
+    stats.clips = 1;
+    stats.rowsSkipped = MAXROWS;
+    stats.threads = 1;
+    keepChanged(stats);
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+DiffStats makeClipsPatch(List& from, List& to, int threads)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    DiffStats stats = {};
+    vector<Node*> fromNodes(from.count), toNodes(to.count);
+    vector<CanvasRow*> older(from.count), newer(to.count);
+    clipNodes(from, fromNodes.data());
+    clipNodes(to, toNodes.data());
+    ListItemType* fromFrames = clipCanvases(fromNodes.data(), from.count, older.data());
+    ListItemType* toFrames = clipCanvases(toNodes.data(), to.count, newer.data());
+
+    clipsPatch = true;
+    fromCount = from.count;
+    toCount = to.count;
+    scripts.assign(toCount, ClipScript());
+
+    // Clips sharing a canvas in the store are the same without looking, and
+    // canvases in the store have their hash already
+    vector<DiffJob> jobs;
+    for (int i = 0; i < toCount; i++)
+    {
+        scripts[i].clip = i + 1;
+        CanvasRow* canvas = i < fromCount ? older[i] : blankCanvas();
+        if (canvas == newer[i])
+        {
+            stats.clipsSkipped++;
+            continue;
+        }
+        DiffJob job = { canvas, newer[i], &scripts[i], false };
+        if (i < fromCount && older[i] == fromNodes[i]->item && fromNodes[i]->blob->sealed)
+        {
+            scripts[i].before = fromNodes[i]->blob->hash;
+            job.hashed = true;
+        }
+        jobs.push_back(job);
+    }
+
+    int count = (int)jobs.size();
+    threads = parallelFor(count, min(threads, count / CLIPSPERTHREAD), [&](int first, int last) { diffJobs(jobs.data(), first, last); });
+    delete[] fromFrames;
+    delete[] toFrames;
+
+    stats.clips = max(fromCount, toCount);
+    stats.rowsSkipped = (long long)toCount * MAXROWS;
+    stats.threads = threads;
+    keepChanged(stats);
+
+    // Clips only in from are removed
+    stats.clipsChanged += max(0, fromCount - toCount);
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+bool savePatch(char filename[])
+{
+    ofstream outFile(filename);
+    if (!outFile)
+    {
+        return false;
+    }
+
+    // A line for each clip changed, then a line for each run: its row and
+    // column (from 1), length and cells
+    outFile << PATCHHEADER << (clipsPatch ? " CLIPS " : " CANVAS ") << fromCount << " " << toCount << "\n";
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        const ClipScript& script = scripts[i];
+        outFile << "clip " << script.clip << " " << script.runs.size() << " " << hex << script.before << dec << "\n";
+        for (size_t run = 0, at = 0; run < script.runs.size(); at += script.runs[run++].length)
+        {
+            const CellRun& cells = script.runs[run];
+            outFile << cells.row + 1 << " " << cells.col + 1 << " " << cells.length << " ";
+            outFile.write(&script.cells[at], cells.length);
+            outFile << "\n";
+        }
+    }
+
+    outFile.close();
+    return !outFile.fail();
+}
+
+bool loadPatch(char filename[])
+{
+    ifstream inFile(filename);
+    if (!inFile)
+    {
+        return false;
+    }
+
+    string header, kind;
+    int from = 0, to = 0;
+    getline(inFile, header, ' ');
+    getline(inFile, kind, ' ');
+    header += " " + kind;
+    inFile >> kind >> from >> to;
+    if (!inFile || header != PATCHHEADER || (kind != "CLIPS" && kind != "CANVAS") || from < 0 || to < 0
+        || (kind == "CANVAS" && (from != 1 || to != 1)))
+    {
+        return false;
+    }
+
+    vector<ClipScript> loaded;
+    string word;
+    while (inFile >> word)
+    {
+        ClipScript script;
+        int count = 0;
+        inFile >> script.clip >> count >> hex >> script.before >> dec;
+        if (!inFile || word != "clip" || script.clip < 1 || script.clip > to || count < 1 || count > MAXDIFFRUNS
+            || (!loaded.empty() && script.clip <= loaded.back().clip))
+        {
+            return false;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            CellRun run;
+            inFile >> run.row >> run.col >> run.length;
+            run.row--;
+            run.col--;
+            if (!inFile || inFile.get() != ' ' || run.row < 0 || run.row >= MAXROWS || run.col < 0 || run.length < 1
+                || run.col + run.length > MAXCOLS)
+            {
+                return false;
+            }
+            size_t at = script.cells.size();
+            script.cells.resize(at + run.length);
+            if (!inFile.read(&script.cells[at], run.length))
+            {
+                return false;
+            }
+            script.runs.push_back(run);
+        }
+        loaded.push_back(script);
+    }
+
+    scripts.swap(loaded);
+    clipsPatch = kind == "CLIPS";
+    fromCount = from;
+    toCount = to;
+    return true;
+}
+
+// Returns TRUE if canvas holds what the script was made from
+static bool scriptFits(const ClipScript& script, char canvas[][MAXCOLS])
+{
+    return hashCanvas(canvas) == script.before;
+}
+
+static void applyScript(const ClipScript& script, char canvas[][MAXCOLS])
+{
+    patchCanvas(canvas, script.runs.data(), (int)script.runs.size(), script.cells.data());
+}
+
+bool patchSavedFiles(char filename[])
+{
+    char fullPath[FILENAMESIZE];
+    ListItemType canvas;
+
+    // There must be as many clips as the patch was made from: the last one
+    // there and the one after it not
+    if (clipsPatch)
+    {
+        snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, fromCount);
+        bool last = fromCount == 0 || loadCanvas(canvas, fullPath);
+        snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, fromCount + 1);
+        if (!last || loadCanvas(canvas, fullPath))
+        {
+            return false;
+        }
+    }
+
+    // Only the files changed are read, and all are checked before any is written
+    vector<char> canvases(scripts.size() * sizeof(ListItemType));
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        CanvasRow* patched = (CanvasRow*)&canvases[i * sizeof(ListItemType)];
+        if (!clipsPatch)
+            snprintf(fullPath, FILENAMESIZE, "%s.txt", filename);
+        else
+            snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, scripts[i].clip);
+
+        if (clipsPatch && scripts[i].clip > fromCount)
+        {
+            copyCanvas(patched, blankCanvas());
+        }
+        else if (!loadCanvas(patched, fullPath))
+        {
+            return false;
+        }
+        if (!scriptFits(scripts[i], patched))
+        {
+            return false;
+        }
+    }
+
+    bool allSaved = true;
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        CanvasRow* patched = (CanvasRow*)&canvases[i * sizeof(ListItemType)];
+        if (!clipsPatch)
+            snprintf(fullPath, FILENAMESIZE, "%s.txt", filename);
+        else
+            snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, scripts[i].clip);
+
+        applyScript(scripts[i], patched);
+        allSaved = saveCanvas(patched, fullPath) && allSaved;
+        forgetCanvas(patched);
+    }
+
+    // Clips added with nothing on them have no script, but still need a file
+    for (int clip = fromCount + 1, i = 0; clipsPatch && clip <= toCount; clip++)
+    {
+        while (i < (int)scripts.size() && scripts[i].clip < clip)
+        {
+            i++;
+        }
+        if (i == (int)scripts.size() || scripts[i].clip != clip)
+        {
+            snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, clip);
+            allSaved = saveCanvas(blankCanvas(), fullPath) && allSaved;
+        }
+    }
+
+    // and clips removed their files taken away, the last first so the
+    // numbering never has a gap
+    for (int clip = fromCount; clipsPatch && clip > toCount; clip--)
+    {
+        snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, clip);
+        allSaved = remove(fullPath) == 0 && allSaved;
+    }
+    return allSaved;
+}
+
+bool patchCurrent(Node* current, List& undoList, List& redoList, List& clips)
+{
+    if (!clipsPatch)
+    {
+        if (scripts.empty())
+        {
+            return true;
+        }
+        const ClipScript& script = scripts[0];
+        if (!scriptFits(script, current->item))
+        {
+            return false;
+        }
+
+        // Only the rectangle the runs cover goes in the undo state
+        CellRect bounds = { MAXROWS, MAXCOLS, -1, -1 };
+        for (size_t run = 0; run < script.runs.size(); run++)
+        {
+            const CellRun& cells = script.runs[run];
+            bounds.top = min(bounds.top, cells.row);
+            bounds.left = min(bounds.left, cells.col);
+            bounds.bottom = max(bounds.bottom, cells.row);
+            bounds.right = max(bounds.right, cells.col + cells.length - 1);
+        }
+        addUndoState(undoList, redoList, current, bounds);
+        applyScript(script, current->item);
+        return true;
+    }
+
+    if (clips.count != fromCount)
+    {
+        return false;
+    }
+    vector<Node*> nodes(clips.count);
+    vector<CanvasRow*> canvases(clips.count);
+    clipNodes(clips, nodes.data());
+    ListItemType* frames = clipCanvases(nodes.data(), clips.count, canvases.data());
+    bool fits = true;
+    for (size_t i = 0; i < scripts.size() && fits; i++)
+    {
+        CanvasRow* canvas = scripts[i].clip <= fromCount ? canvases[scripts[i].clip - 1] : blankCanvas();
+        fits = scriptFits(scripts[i], canvas);
+    }
+    delete[] frames;
+    if (!fits)
+    {
+        return false;
+    }
+
+    // Clips removed come off the front of the list, where the newest are,
+    // and clips added go on it blank
+    while (clips.count > toCount)
+    {
+        deleteNode(removeNode(clips));
+    }
+    while (clips.count < toCount)
+    {
+        // Stop at the hard memory limit, with the clips added so far
+        if (!addClip(clips, newCanvas()))
+        {
+            return false;
+        }
+    }
+
+    nodes.resize(clips.count);
+    clipNodes(clips, nodes.data());
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        // Clips are shared and sealed; take a private copy to change
+        Node* node = nodes[scripts[i].clip - 1];
+        if (node->tween != NULL && isSpilled(node))
+        {
+            keepTweenFrame(node);
+        }
+        pageIn(node);
+        makeWritable(node);
+        applyScript(scripts[i], node->item);
+        sealCanvas(node);
+    }
+    return true;
+}
+
+// Draws canvas with the cells of script shown in reverse
+static void displayScript(char canvas[][MAXCOLS], const ClipScript& script)
+{
+    displayCanvas(canvas);
+    for (size_t run = 0, at = 0; run < script.runs.size(); at += script.runs[run++].length)
+    {
+        gotoxy(script.runs[run].row, script.runs[run].col);
+        cout << "\x1b[7m";
+        cout.write(&script.cells[at], script.runs[run].length);
+        cout << "\x1b[0m";
+    }
+}
+
+void diffMenu()
+{
+    static ListItemType older, newer;
+    char olderName[FILENAMESIZE - 15], newerName[FILENAMESIZE - 15];
+    char olderPath[FILENAMESIZE], newerPath[FILENAMESIZE];
+    List olderClips = { NULL, 0 }, newerClips = { NULL, 0 };
+    DiffStats stats;
+    char input;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the older canvas or animation filename (don't enter 'txt'): ";
+    cin.getline(olderName, sizeof(olderName));
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the newer one: ";
+    cin.getline(newerName, sizeof(newerName));
+
+    // A canvas if there is a file by that name, otherwise an animation
+    snprintf(olderPath, FILENAMESIZE, "SavedFiles/%s.txt", olderName);
+    snprintf(newerPath, FILENAMESIZE, "SavedFiles/%s.txt", newerName);
+    bool canvases = loadCanvas(older, olderPath);
+    if (canvases && loadCanvas(newer, newerPath))
+    {
+        stats = makeCanvasPatch(older, newer);
+    }
+    else
+    {
+        snprintf(olderPath, FILENAMESIZE, "SavedFiles/%s", olderName);
+        snprintf(newerPath, FILENAMESIZE, "SavedFiles/%s", newerName);
+        if (canvases || !loadClips(olderClips, olderPath) || !loadClips(newerClips, newerPath))
+        {
+            deleteList(olderClips);
+            deleteList(newerClips);
+            clearLine(MAXROWS + 1, CLEARCOLS);
+            cout << "ERROR: File could not be read: ";
+            pauseScreen();
+            return;
+        }
+        stats = makeClipsPatch(olderClips, newerClips, (int)max(1u, thread::hardware_concurrency()));
+    }
+
+    // Step through the clips changed, as they are now
+    vector<Node*> nodes(newerClips.count);
+    clipNodes(newerClips, nodes.data());
+    size_t shown = 0;
+    do {
+        if (shown < scripts.size())
+        {
+            const ClipScript& script = scripts[shown];
+            displayScript(canvases ? newer : clipCanvas(nodes[script.clip - 1]), script);
+        }
+
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << stats.clipsChanged << " of " << stats.clips << " clips changed (" << max(0, fromCount - toCount)
+            << " removed), " << stats.runs << " runs, " << stats.cells << " cells, " << stats.rowsSkipped
+            << " rows skipped, " << stats.clipsSkipped << " clips shared in " << stats.ms << " ms on " << stats.threads
+            << " threads";
+        if (shown < scripts.size())
+        {
+            cout << " / clip " << scripts[shown].clip << ": " << scripts[shown].runs.size() << " runs";
+        }
+        clearLine(MAXROWS + 2, CLEARCOLS);
+        cout << "<N>ext changed clip / any other key to go on . . .";
+        input = getKey();
+        shown++;
+    } while ((input == 'n' || input == 'N') && shown < scripts.size());
+
+    deleteList(olderClips);
+    deleteList(newerClips);
+
+    char patchName[FILENAMESIZE - sizeof("SavedFiles/.patch")], patchPath[FILENAMESIZE];
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the filename to save the patch as (don't enter 'patch'), or nothing to skip: ";
+    cin.getline(patchName, sizeof(patchName));
+    if (patchName[0] != '\0')
+    {
+        snprintf(patchPath, FILENAMESIZE, "SavedFiles/%s.patch", patchName);
+        if (!savePatch(patchPath))
+        {
+            cout << "ERROR: File could not be written.\n";
+        }
+        else
+        {
+            cout << "Patch saved!\n";
+        }
+        pauseScreen();
+    }
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
+
+void patchMenu(Node* current, List& undoList, List& redoList, List& clips)
+{
+    char name[FILENAMESIZE - sizeof("SavedFiles/.patch")], path[FILENAMESIZE];
+    char target;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the patch filename (don't enter 'patch'): ";
+    cin.getline(name, sizeof(name));
+    snprintf(path, FILENAMESIZE, "SavedFiles/%s.patch", name);
+    if (!loadPatch(path))
+    {
+        cout << "ERROR: File could not be read: ";
+        pauseScreen();
+        return;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (clipsPatch)
+        cout << "Patch turning " << fromCount << " clips into " << toCount << ". Apply it to <S>aved files or the <C>lips ? ";
+    else
+        cout << "Patch for a canvas. Apply it to a <S>aved file or the <C>anvas ? ";
+    cin >> target;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    bool patched = false;
+    if (target == 's' || target == 'S')
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the filename to patch (don't enter 'txt'): ";
+        cin.getline(name, sizeof(name));
+        snprintf(path, FILENAMESIZE, "SavedFiles/%s", name);
+        patched = patchSavedFiles(path);
+    }
+    else if (target == 'c' || target == 'C')
+    {
+        patched = patchCurrent(current, undoList, redoList, clips);
+    }
+    else
+    {
+        return;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (patched)
+    {
+        cout << "Patched! ";
+    }
+    else
+    {
+        cout << "ERROR: Not what the patch was made from: ";
+    }
+    pauseScreen();
+}
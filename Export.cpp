@@ -0,0 +1,768 @@
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "Definitions.h"
+#include "Parallel.h"
+using namespace std;
+
+// The glyphs of ' ' to '~', 8x8 pixels, a byte a row from the top with the
+// leftmost pixel in the lowest bit (the public domain font8x8 basic set)
+static const unsigned char FONT[95][8] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ' '
+    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 },   // !
+    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // "
+    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 },   // #
+    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 },   // $
+    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 },   // %
+    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 },   // &
+    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '
+    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 },   // (
+    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 },   // )
+    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 },   // *
+    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 },   // +
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // ,
+    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 },   // -
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // .
+    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 },   // /
+    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 },   // 0
+    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 },   // 1
+    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 },   // 2
+    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 },   // 3
+    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 },   // 4
+    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 },   // 5
+    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 },   // 6
+    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 },   // 7
+    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 },   // 8
+    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 },   // 9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // :
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // ;
+    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 },   // <
+    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 },   // =
+    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 },   // >
+    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 },   // ?
+    { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 },   // @
+    { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 },   // A
+    { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 },   // B
+    { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 },   // C
+    { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 },   // D
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 },   // E
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 },   // F
+    { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 },   // G
+    { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 },   // H
+    { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // I
+    { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 },   // J
+    { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 },   // K
+    { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 },   // L
+    { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 },   // M
+    { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 },   // N
+    { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 },   // O
+    { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 },   // P
+    { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 },   // Q
+    { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 },   // R
+    { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 },   // S
+    { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // T
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 },   // U
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   // V
+    { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 },   // W
+    { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 },   // X
+    { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 },   // Y
+    { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 },   // Z
+    { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 },   // [
+    { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 },   // backslash
+    { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 },   // ]
+    { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 },   // ^
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF },   // _
+    { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },   // `
+    { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 },   // a
+    { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 },   // b
+    { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 },   // c
+    { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 },   // d
+    { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 },   // e
+    { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 },   // f
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F },   // g
+    { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 },   // h
+    { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // i
+    { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E },   // j
+    { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 },   // k
+    { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // l
+    { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 },   // m
+    { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 },   // n
+    { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 },   // o
+    { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F },   // p
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 },   // q
+    { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 },   // r
+    { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 },   // s
+    { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 },   // t
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 },   // u
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   // v
+    { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 },   // w
+    { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 },   // x
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F },   // y
+    { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 },   // z
+    { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 },   // {
+    { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 },   // |
+    { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 },   // }
+    { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }    // ~
+};
+
+// Drawn for characters the font doesn't have
+static const unsigned char MISSINGGLYPH[8] = { 0x00, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00 };
+
+// Background, then ink, as red, green and blue; shared by every image and frame
+static const unsigned char PALETTE[2][3] = { { 0x00, 0x00, 0x00 }, { 0xC0, 0xC0, 0xC0 } };
+
+// Most clips to draw and compress per thread before they are split between threads
+const int FRAMESPERTHREAD = 4;
+
+// Bits per code the GIF compression starts from, the least it allows
+const int GIFMINCODESIZE = 2;
+
+// Every glyph drawn at one pixel size, a palette index (0 or 1) per pixel
+static vector<unsigned char> glyphs;
+static int glyphSize = 0;
+
+// Draws all 256 glyphs at pixelSize unless they are drawn already
+// Returns the number drawn
+static int cacheGlyphs(int pixelSize)
+{
+    if (glyphSize == pixelSize)
+    {
+        return 0;
+    }
+
+    int width = GLYPHWIDTH * pixelSize, height = GLYPHHEIGHT * pixelSize;
+    glyphs.assign((size_t)256 * width * height, 0);
+    for (int ch = 0; ch < 256; ch++)
+    {
+        const unsigned char* rows = ch >= ' ' && ch <= '~' ? FONT[ch - ' '] : MISSINGGLYPH;
+        unsigned char* glyph = &glyphs[(size_t)ch * width * height];
+        for (int y = 0; y < height; y++)
+        {
+            unsigned char bits = rows[y * 8 / height];
+            for (int x = 0; x < width; x++)
+            {
+                glyph[y * width + x] = (bits >> (x / pixelSize)) & 1;
+            }
+        }
+    }
+    glyphSize = pixelSize;
+    return 256;
+}
+
+// Draws the cells of cells into pixels, from the glyph cache, a palette index
+// per pixel; a row of pixels is as wide as the rectangle
+static void drawCells(char canvas[][MAXCOLS], CellRect cells, unsigned char* pixels)
+{
+    int glyphWidth = GLYPHWIDTH * glyphSize, glyphHeight = GLYPHHEIGHT * glyphSize;
+    int width = (cells.right - cells.left + 1) * glyphWidth;
+
+    for (int row = cells.top; row <= cells.bottom; row++)
+    {
+        for (int y = 0; y < glyphHeight; y++)
+        {
+            unsigned char* line = &pixels[((size_t)(row - cells.top) * glyphHeight + y) * width];
+            for (int col = cells.left; col <= cells.right; col++)
+            {
+                const unsigned char* glyph = &glyphs[((size_t)(unsigned char)canvas[row][col] * glyphHeight + y) * glyphWidth];
+                memcpy(&line[(col - cells.left) * glyphWidth], glyph, glyphWidth);
+            }
+        }
+    }
+}
+
+void renderCanvas(char canvas[][MAXCOLS], int pixelSize, unsigned char pixels[])
+{
+    CellRect whole = { 0, 0, MAXROWS - 1, MAXCOLS - 1 };
+    cacheGlyphs(max(1, min(pixelSize, MAXPIXELSIZE)));
+    drawCells(canvas, whole, pixels);
+}
+
+//--------------------PNG------------------------------------------------------
+
+// Writes bits to out, the lowest first, as deflate packs them
+struct BitWriter
+{
+    vector<unsigned char>& out;
+    unsigned long long bits;
+    int count;
+
+    BitWriter(vector<unsigned char>& to) : out(to), bits(0), count(0) {}
+
+    void put(unsigned int value, int length)
+    {
+        bits |= (unsigned long long)value << count;
+        count += length;
+        while (count >= 8)
+        {
+            out.push_back((unsigned char)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes go highest bit first
+    void putCode(unsigned int code, int length)
+    {
+        unsigned int reversed = 0;
+        for (int i = 0; i < length; i++)
+        {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, length);
+    }
+
+    void flush()
+    {
+        if (count > 0)
+        {
+            out.push_back((unsigned char)bits);
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+// Match lengths and distances deflate has codes for, each the start of a range
+// told apart by the extra bits following the code
+static const int LENGTHBASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int LENGTHEXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int DISTANCEBASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int DISTANCEEXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// How far back, how long, and how hard deflate looks for a match
+const int DEFLATEWINDOW = 32768;
+const int MINMATCH = 3;
+const int MAXMATCH = 258;
+const int MAXCHAIN = 64;
+const int HASHBITS = 15;
+
+// Writes a literal or length symbol with deflate's fixed Huffman codes
+static void putSymbol(BitWriter& writer, int symbol)
+{
+    if (symbol <= 143)
+        writer.putCode(0x30 + symbol, 8);
+    else if (symbol <= 255)
+        writer.putCode(0x190 + symbol - 144, 9);
+    else if (symbol <= 279)
+        writer.putCode(symbol - 256, 7);
+    else
+        writer.putCode(0xC0 + symbol - 280, 8);
+}
+
+static void putMatch(BitWriter& writer, int length, int distance)
+{
+    int code = 28;
+    while (LENGTHBASE[code] > length)
+    {
+        code--;
+    }
+    putSymbol(writer, 257 + code);
+    writer.put(length - LENGTHBASE[code], LENGTHEXTRA[code]);
+
+    code = 29;
+    while (DISTANCEBASE[code] > distance)
+    {
+        code--;
+    }
+    writer.putCode(code, 5);
+    writer.put(distance - DISTANCEBASE[code], DISTANCEEXTRA[code]);
+}
+
+// Compresses data into a zlib stream: one deflate block with the fixed codes,
+// taking the longest match found among the last MAXCHAIN places its first
+// three bytes were seen. Images of text are mostly long runs of background
+// and rows repeated a glyph row apart, which this finds well enough.
+static void deflateBytes(const vector<unsigned char>& data, vector<unsigned char>& out)
+{
+    int size = (int)data.size();
+    vector<int> head(1 << HASHBITS, -1), previous(size);
+    BitWriter writer(out);
+
+    // No preset dictionary, the smallest window that says 32K
+    out.push_back(0x78);
+    out.push_back(0x01);
+    writer.put(1, 1);   // the last block
+    writer.put(1, 2);   // with the fixed codes
+
+    for (int at = 0; at < size; )
+    {
+        int best = 0, distance = 0;
+        unsigned int hash = 0;
+        if (at + MINMATCH <= size)
+        {
+            hash = ((data[at] << 10) ^ (data[at + 1] << 5) ^ data[at + 2]) & ((1 << HASHBITS) - 1);
+            int longest = min(MAXMATCH, size - at);
+            for (int from = head[hash], chain = 0; from >= 0 && at - from <= DEFLATEWINDOW && chain < MAXCHAIN;
+                from = previous[from], chain++)
+            {
+                if (data[from + best] != data[at + best])
+                {
+                    continue;
+                }
+                int length = 0;
+                while (length < longest && data[from + length] == data[at + length])
+                {
+                    length++;
+                }
+                if (length > best)
+                {
+                    best = length;
+                    distance = at - from;
+                    if (length == longest)
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+
+        int taken = 1;
+        if (best >= MINMATCH)
+        {
+            putMatch(writer, best, distance);
+            taken = best;
+        }
+        else
+        {
+            putSymbol(writer, data[at]);
+        }
+
+        // Every byte passed over can start a later match
+        for (int end = at + taken; at < end; at++)
+        {
+            if (at + MINMATCH <= size)
+            {
+                hash = ((data[at] << 10) ^ (data[at + 1] << 5) ^ data[at + 2]) & ((1 << HASHBITS) - 1);
+                previous[at] = head[hash];
+                head[hash] = at;
+            }
+        }
+    }
+    putSymbol(writer, 256);
+    writer.flush();
+
+    // Adler-32 of the data, highest byte first
+    unsigned int a = 1, b = 0;
+    for (int i = 0; i < size; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    unsigned int adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back((unsigned char)(adler >> shift));
+    }
+}
+
+static unsigned int crc32(const unsigned char* data, size_t length, unsigned int crc)
+{
+    static unsigned int table[256];
+    if (table[1] == 0)
+    {
+        for (unsigned int n = 0; n < 256; n++)
+        {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void putBigEndian(vector<unsigned char>& out, unsigned int value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back((unsigned char)(value >> shift));
+    }
+}
+
+// Adds a PNG chunk: its length, type, data and the CRC of the type and data
+static void putChunk(vector<unsigned char>& out, const char type[], const vector<unsigned char>& data)
+{
+    putBigEndian(out, (unsigned int)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, crc32(&out[start], out.size() - start, 0));
+}
+
+bool exportPng(char canvas[][MAXCOLS], char filename[], int pixelSize, ExportStats& stats)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    stats = ExportStats();
+    stats.glyphsDrawn = cacheGlyphs(max(1, min(pixelSize, MAXPIXELSIZE)));
+    stats.width = MAXCOLS * GLYPHWIDTH * glyphSize;
+    stats.height = MAXROWS * GLYPHHEIGHT * glyphSize;
+    stats.frames = 1;
+    stats.threads = 1;
+    stats.pixels = (long long)stats.width * stats.height;
+
+    CellRect whole = { 0, 0, MAXROWS - 1, MAXCOLS - 1 };
+    vector<unsigned char> pixels((size_t)stats.pixels);
+    drawCells(canvas, whole, &pixels[0]);
+
+    // A bit per pixel, each row after a 0 saying it isn't filtered
+    int rowBytes = stats.width / 8;
+    vector<unsigned char> rows((size_t)(rowBytes + 1) * stats.height, 0);
+    for (int y = 0; y < stats.height; y++)
+    {
+        unsigned char* row = &rows[(size_t)y * (rowBytes + 1) + 1];
+        const unsigned char* line = &pixels[(size_t)y * stats.width];
+        for (int x = 0; x < stats.width; x++)
+        {
+            row[x / 8] |= line[x] << (7 - x % 8);
+        }
+    }
+
+    vector<unsigned char> header, palette(&PALETTE[0][0], &PALETTE[0][0] + sizeof(PALETTE)), compressed, file;
+    putBigEndian(header, stats.width);
+    putBigEndian(header, stats.height);
+    header.push_back(1);    // bits per pixel
+    header.push_back(3);    // palette indices
+    header.push_back(0);    // deflate
+    header.push_back(0);    // the one filter method
+    header.push_back(0);    // not interlaced
+    deflateBytes(rows, compressed);
+    stats.encodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.insert(file.end(), SIGNATURE, SIGNATURE + 8);
+    putChunk(file, "IHDR", header);
+    putChunk(file, "PLTE", palette);
+    putChunk(file, "IDAT", compressed);
+    putChunk(file, "IEND", vector<unsigned char>());
+
+    ofstream outFile(filename, ios::binary);
+    if (!outFile)
+    {
+        return false;
+    }
+    outFile.write((const char*)&file[0], file.size());
+    outFile.close();
+    stats.bytes = file.size();
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return !outFile.fail();
+}
+
+//--------------------GIF------------------------------------------------------
+
+// A clip to draw as a GIF frame: the cells changed since the clip before,
+// drawn and compressed
+struct GifFrame
+{
+    CanvasRow* before;              // NULL for the first clip, which is drawn whole
+    CanvasRow* canvas;
+    CellRect cells;                 // empty if nothing changed
+    vector<unsigned char> data;     // LZW codes in sub-blocks, as they go in the file
+};
+
+// Writes GIF LZW codes, the lowest bit first, in sub-blocks of up to 255 bytes
+struct CodeWriter
+{
+    vector<unsigned char>& out;
+    unsigned int bits;
+    int count;
+    size_t block;                   // where the length of the sub-block being filled goes
+
+    CodeWriter(vector<unsigned char>& to) : out(to), bits(0), count(0), block(0)
+    {
+        out.push_back(0);
+    }
+
+    void putByte(unsigned char byte)
+    {
+        if (out[block] == 255)
+        {
+            block = out.size();
+            out.push_back(0);
+        }
+        out.push_back(byte);
+        out[block]++;
+    }
+
+    void put(int code, int length)
+    {
+        bits |= code << count;
+        count += length;
+        while (count >= 8)
+        {
+            putByte((unsigned char)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Ends the last sub-block, then the list of them
+    void finish()
+    {
+        if (count > 0)
+        {
+            putByte((unsigned char)bits);
+        }
+        out.push_back(0);
+    }
+};
+
+// Compresses count palette indices (each below 1 << GIFMINCODESIZE) with GIF's LZW
+static void compressPixels(const unsigned char* pixels, size_t count, vector<unsigned char>& out)
+{
+    const int CLEAR = 1 << GIFMINCODESIZE, END = CLEAR + 1, MAXCODE = 4095;
+    static thread_local short next[MAXCODE + 1][1 << GIFMINCODESIZE];
+    CodeWriter writer(out);
+    int codeSize = GIFMINCODESIZE + 1, lastCode = END;
+
+    memset(next, 0, sizeof(next));
+    writer.put(CLEAR, codeSize);
+    int code = pixels[0];
+    for (size_t i = 1; i < count; i++)
+    {
+        int pixel = pixels[i];
+        if (next[code][pixel] != 0)
+        {
+            code = next[code][pixel];
+            continue;
+        }
+
+        // The string so far then this pixel is new: its code goes in the table
+        writer.put(code, codeSize);
+        next[code][pixel] = (short)++lastCode;
+        if (lastCode >= (1 << codeSize))
+        {
+            codeSize++;
+        }
+        if (lastCode == MAXCODE)
+        {
+            // Table full; start it again
+            writer.put(CLEAR, codeSize);
+            memset(next, 0, sizeof(next));
+            codeSize = GIFMINCODESIZE + 1;
+            lastCode = END;
+        }
+        code = pixel;
+    }
+    writer.put(code, codeSize);
+
+    // Reading that code the decoder adds the entry this side never made, and
+    // widens its codes if that fills the table at this size
+    if (lastCode + 1 >= (1 << codeSize) && codeSize < 12)
+    {
+        codeSize++;
+    }
+    writer.put(END, codeSize);
+    writer.finish();
+}
+
+// Finds, draws and compresses frames first .. last - 1
+static void encodeFrames(GifFrame* frames, int first, int last)
+{
+    vector<CellRun> runs(MAXDIFFRUNS);
+    ListItemType cells;
+    vector<unsigned char> pixels;
+
+    for (int i = first; i < last; i++)
+    {
+        GifFrame& frame = frames[i];
+        CellRect whole = { 0, 0, MAXROWS - 1, MAXCOLS - 1 };
+        frame.cells = whole;
+        if (frame.before != NULL)
+        {
+            // Only the rectangle holding the changed runs
+            CellRect changed = { MAXROWS, MAXCOLS, -1, -1 };
+            int count = frame.before == frame.canvas ? 0 : diffCanvas(frame.before, frame.canvas, &runs[0], &cells[0][0]);
+            for (int run = 0; run < count; run++)
+            {
+                changed.top = min(changed.top, runs[run].row);
+                changed.left = min(changed.left, runs[run].col);
+                changed.bottom = max(changed.bottom, runs[run].row);
+                changed.right = max(changed.right, runs[run].col + runs[run].length - 1);
+            }
+            frame.cells = changed;
+            if (count == 0)
+            {
+                continue;
+            }
+        }
+
+        pixels.resize((size_t)rectCells(frame.cells) * GLYPHWIDTH * GLYPHHEIGHT * glyphSize * glyphSize);
+        drawCells(frame.canvas, frame.cells, &pixels[0]);
+        compressPixels(&pixels[0], pixels.size(), frame.data);
+    }
+}
+
+static void putLittleEndian(vector<unsigned char>& out, int value)
+{
+    out.push_back((unsigned char)value);
+    out.push_back((unsigned char)(value >> 8));
+}
+
+bool exportGif(List& clips, char filename[], int pixelSize, int threads, ExportStats& stats)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    stats = ExportStats();
+    if (clips.count == 0)
+    {
+        return false;
+    }
+    stats.glyphsDrawn = cacheGlyphs(max(1, min(pixelSize, MAXPIXELSIZE)));
+    stats.width = MAXCOLS * GLYPHWIDTH * glyphSize;
+    stats.height = MAXROWS * GLYPHHEIGHT * glyphSize;
+
+    // Clips oldest first, each encoded against the one before
+    int count = clips.count;
+    vector<Node*> nodes(count);
+    vector<CanvasRow*> canvases(count);
+    clipNodes(clips, nodes.data());
+    ListItemType* tweenFrames = clipCanvases(nodes.data(), count, canvases.data());
+    vector<GifFrame> frames(count);
+    for (int i = 0; i < count; i++)
+    {
+        frames[i].canvas = canvases[i];
+        frames[i].before = i > 0 ? canvases[i - 1] : NULL;
+    }
+
+    stats.threads = parallelFor(count, min(threads, count / FRAMESPERTHREAD), [&](int first, int last) { encodeFrames(frames.data(), first, last); });
+    delete[] tweenFrames;
+    stats.encodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // The screen, with its palette (a background of index 0, a colour table of
+    // 2 entries) shared by every frame, then a loop forever like play
+    vector<unsigned char> file;
+    const char HEADER[] = "GIF89a";
+    file.insert(file.end(), HEADER, HEADER + 6);
+    putLittleEndian(file, stats.width);
+    putLittleEndian(file, stats.height);
+    file.push_back(0xF0);
+    file.push_back(0);
+    file.push_back(0);
+    file.insert(file.end(), &PALETTE[0][0], &PALETTE[0][0] + sizeof(PALETTE));
+    const unsigned char LOOP[] = { 0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0 };
+    file.insert(file.end(), LOOP, LOOP + sizeof(LOOP));
+
+    for (int i = 0; i < count; i++)
+    {
+        GifFrame& frame = frames[i];
+        if (frame.data.empty())
+        {
+            continue;
+        }
+
+        // Shown until the next clip that changes something, in hundredths of a second
+        int shown = 1;
+        while (i + shown < count && frames[i + shown].data.empty())
+        {
+            shown++;
+        }
+        stats.framesFolded += shown - 1;
+        stats.frames++;
+        stats.pixels += (long long)rectCells(frame.cells) * GLYPHWIDTH * GLYPHHEIGHT * glyphSize * glyphSize;
+
+        // Left in place for the next frame to draw over
+        const unsigned char CONTROL[] = { 0x21, 0xF9, 4, 1 << 2 };
+        file.insert(file.end(), CONTROL, CONTROL + sizeof(CONTROL));
+        putLittleEndian(file, min(shown * FRAMEMS / 10, 65535));
+        file.push_back(0);
+        file.push_back(0);
+
+        file.push_back(0x2C);
+        putLittleEndian(file, frame.cells.left * GLYPHWIDTH * glyphSize);
+        putLittleEndian(file, frame.cells.top * GLYPHHEIGHT * glyphSize);
+        putLittleEndian(file, (frame.cells.right - frame.cells.left + 1) * GLYPHWIDTH * glyphSize);
+        putLittleEndian(file, (frame.cells.bottom - frame.cells.top + 1) * GLYPHHEIGHT * glyphSize);
+        file.push_back(0);
+        file.push_back(GIFMINCODESIZE);
+        file.insert(file.end(), frame.data.begin(), frame.data.end());
+    }
+    file.push_back(0x3B);
+
+    ofstream outFile(filename, ios::binary);
+    if (!outFile)
+    {
+        return false;
+    }
+    outFile.write((const char*)&file[0], file.size());
+    outFile.close();
+    stats.bytes = file.size();
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return !outFile.fail();
+}
+
+void exportMenu(Node* current, List& clips)
+{
+    char kind;
+    char name[FILENAMESIZE - 15], path[FILENAMESIZE];
+    int pixelSize = 1;
+    ExportStats stats;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "<P>NG of the canvas or <G>IF of the clips ? ";
+    cin >> kind;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    bool gif = kind == 'g' || kind == 'G';
+    if (!gif && kind != 'p' && kind != 'P')
+    {
+        return;
+    }
+    if (gif && clips.count == 0)
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "ERROR: There are no clips. ";
+        pauseScreen();
+        return;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the filename (don't enter '" << (gif ? "gif" : "png") << "'): ";
+    cin.getline(name, FILENAMESIZE - 15);
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the pixel size (1 to " << MAXPIXELSIZE << "): ";
+    cin >> pixelSize;
+    if (!cin)
+    {
+        pixelSize = 1;
+    }
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    snprintf(path, FILENAMESIZE, "SavedFiles/%s.%s", name, gif ? "gif" : "png");
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    bool saved = gif ? exportGif(clips, path, pixelSize, threads, stats) : exportPng(current->item, path, pixelSize, stats);
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (!saved)
+    {
+        cout << "ERROR: File could not be written. ";
+    }
+    else
+    {
+        cout << stats.width << "x" << stats.height << ", " << stats.frames << " frames";
+        if (gif)
+        {
+            cout << " (" << stats.framesFolded << " repeats folded)";
+        }
+        cout << ", " << stats.bytes / 1024 << " KB in " << stats.ms << " ms (encoding " << stats.encodeMs
+            << " ms on " << stats.threads << " threads) ";
+    }
+    pauseScreen();
+}
@@ -0,0 +1,278 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include "Definitions.h"
+using namespace std;
+
+// Budget and spill file state
+static long long historyBudget = HISTORYBUDGET;
+static FILE* spillFile = NULL;
+static long spillEnd = 0;       // where the next spilled state is written
+static int spillFileStates = 0;
+static long long spilledBytes = 0;
+static int pageIns = 0;
+
+int packBytes(const unsigned char data[], int size, unsigned char out[])
+{
+    int in = 0, length = 0;
+
+    while (in < size)
+    {
+        // Measure the run starting here
+        int run = 1;
+        while (in + run < size && run < 128 && data[in + run] == data[in])
+        {
+            run++;
+        }
+
+        if (run >= 3)
+        {
+            // Repeat: 257 - header copies of the next byte
+            out[length++] = (unsigned char)(257 - run);
+            out[length++] = data[in];
+            in += run;
+        }
+        else
+        {
+            // Literal: gather bytes until the next run of 3 or more
+            int start = in, count = 0;
+            while (in < size && count < 128)
+            {
+                if (in + 2 < size && data[in] == data[in + 1] && data[in] == data[in + 2])
+                {
+                    break;
+                }
+                in++;
+                count++;
+            }
+            out[length++] = (unsigned char)(count - 1);
+            memcpy(&out[length], &data[start], count);
+            length += count;
+        }
+    }
+    return length;
+}
+
+bool unpackBytes(const unsigned char packed[], int length, unsigned char out[], int size)
+{
+    int in = 0, written = 0;
+
+    while (in < length)
+    {
+        int header = packed[in++];
+
+        if (header < 128)
+        {
+            // Literal bytes
+            int count = header + 1;
+            if (in + count > length || written + count > size)
+            {
+                return false;
+            }
+            memcpy(&out[written], &packed[in], count);
+            in += count;
+            written += count;
+        }
+        else if (header > 128)
+        {
+            // Repeated byte
+            int count = 257 - header;
+            if (in >= length || written + count > size)
+            {
+                return false;
+            }
+            memset(&out[written], packed[in++], count);
+            written += count;
+        }
+    }
+    return written == size;
+}
+
+// Pages a node's canvas out of memory, writing it to the spill file unless the
+// session file already holds a copy
+// Returns false (leaving the node resident) if the spill file can't be written
+static bool spillNode(Node* node)
+{
+    unsigned char packed[PACKEDCANVASSIZE];
+
+    if (node->sessionOffset == 0)
+    {
+        node->sessionOffset = node->blob->sessionOffset;
+    }
+    if (node->sessionOffset > 0)
+    {
+        releaseCanvas(node);
+        return true;
+    }
+
+    if (spillFile == NULL)
+    {
+        spillFile = tmpfile();
+        if (spillFile == NULL)
+        {
+            return false;
+        }
+    }
+
+    int length = packBytes((unsigned char*)node->item, sizeof(ListItemType), packed);
+    if (fseek(spillFile, spillEnd, SEEK_SET) != 0 || fwrite(packed, 1, length, spillFile) != (size_t)length)
+    {
+        return false;
+    }
+
+    node->spillOffset = spillEnd;
+    node->spillLength = length;
+    spillEnd += length;
+    spillFileStates++;
+    spilledBytes += length;
+
+    releaseCanvas(node);
+    return true;
+}
+
+void enforceHistoryBudget(List& undoList, List& redoList)
+{
+    int residentLimit = (int)(historyBudget / sizeof(ListItemType));
+    int resident = 0;
+    Node* undoNode = undoList.head;
+    Node* redoNode = redoList.head;
+
+    // Walk outwards from the current canvas through both lists at once, so the
+    // states nearest to it (in either direction) are the ones kept in memory
+    while (undoNode != NULL || redoNode != NULL)
+    {
+        Node* nodes[2] = { undoNode, redoNode };
+        bool allSpilled = true;
+
+        for (int i = 0; i < 2; i++)
+        {
+            // Region states are small enough to stay in memory
+            if (nodes[i] != NULL && nodes[i]->patch != NULL)
+            {
+                allSpilled = false;
+                continue;
+            }
+            if (nodes[i] == NULL || isSpilled(nodes[i]))
+            {
+                continue;
+            }
+
+            allSpilled = false;
+            if (resident < residentLimit || !spillNode(nodes[i]))
+            {
+                resident++;
+            }
+        }
+
+        // Everything older than an already spilled state is spilled too
+        if (allSpilled && resident >= residentLimit)
+        {
+            break;
+        }
+
+        undoNode = undoNode != NULL ? undoNode->next : NULL;
+        redoNode = redoNode != NULL ? redoNode->next : NULL;
+    }
+}
+
+void pageIn(Node* node)
+{
+    if (!isSpilled(node))
+    {
+        return;
+    }
+
+    // A tween frame is drawn from its tween rather than read back
+    if (node->tween != NULL)
+    {
+        keepTweenFrame(node);
+        return;
+    }
+
+    unsigned char packed[PACKEDCANVASSIZE];
+    bool loaded;
+
+    allocateCanvas(node);
+    if (node->spillLength > 0)
+    {
+        loaded = fseek(spillFile, node->spillOffset, SEEK_SET) == 0
+            && fread(packed, 1, node->spillLength, spillFile) == (size_t)node->spillLength
+            && unpackBytes(packed, node->spillLength, (unsigned char*)node->item, sizeof(ListItemType));
+    }
+    else
+    {
+        loaded = readSessionCanvas(node->sessionOffset, node->item);
+        node->blob->sessionOffset = node->sessionOffset;
+    }
+
+    if (!loaded)
+    {
+        // The file is unreadable; a blank canvas is better than garbage
+        initCanvas(node->item);
+        node->blob->sessionOffset = 0;
+        node->sessionOffset = 0;
+    }
+
+    discardSpill(node);
+    sealCanvas(node);
+    pageIns++;
+}
+
+CanvasRow* residentCanvas(Node* node)
+{
+    pageIn(node);
+    return node->item;
+}
+
+void discardSpill(Node* node)
+{
+    if (node->spillLength == 0)
+    {
+        return;
+    }
+
+    spillFileStates--;
+    spilledBytes -= node->spillLength;
+    node->spillOffset = 0;
+    node->spillLength = 0;
+
+    // Once nothing lives in the spill file, start writing from the beginning again
+    if (spillFileStates == 0)
+    {
+        spillEnd = 0;
+    }
+}
+
+void setHistoryBudget(long long bytes)
+{
+    historyBudget = bytes < 0 ? 0 : bytes;
+}
+
+HistoryStats getHistoryStats(List& undoList, List& redoList)
+{
+    HistoryStats stats;
+    stats.budget = historyBudget;
+    stats.residentStates = 0;
+    stats.spilledStates = 0;
+    stats.regionStates = 0;
+
+    // States may be paged out to either file, so count them directly
+    List* lists[2] = { &undoList, &redoList };
+    for (int i = 0; i < 2; i++)
+    {
+        for (Node* node = lists[i]->head; node != NULL; node = node->next)
+        {
+            if (node->patch != NULL)
+                stats.regionStates++;
+            if (isSpilled(node) && node->patch == NULL)
+                stats.spilledStates++;
+            else
+                stats.residentStates++;
+        }
+    }
+
+    stats.spilledBytes = spilledBytes;
+    stats.spillFileBytes = spillEnd;
+    stats.pageIns = pageIns;
+    return stats;
+}
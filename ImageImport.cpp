@@ -0,0 +1,231 @@
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include "Definitions.h"
+#include "Parallel.h"
+using namespace std;
+
+// Largest width or height of an image that will be loaded
+const int MAXIMAGESIDE = 16384;
+
+// Least image pixels per thread before downsampling is split between threads
+const int PIXELSPERTHREAD = 1 << 18;
+
+// Reads the next number of a PNM header or ASCII raster, skipping blanks and
+// comments; returns -1 if there isn't one
+static int readNumber(const unsigned char* data, size_t size, size_t& at)
+{
+    while (at < size && (isspace(data[at]) || data[at] == '#'))
+    {
+        if (data[at] == '#')
+        {
+            while (at < size && data[at] != '\n')
+                at++;
+        }
+        else
+        {
+            at++;
+        }
+    }
+
+    if (at >= size || !isdigit(data[at]))
+    {
+        return -1;
+    }
+    long value = 0;
+    while (at < size && isdigit(data[at]) && value <= 65535)
+    {
+        value = value * 10 + (data[at++] - '0');
+    }
+    return value <= 65535 ? (int)value : -1;
+}
+
+bool loadImage(const char filename[], GrayImage& image)
+{
+    image.width = image.height = 0;
+    image.pixels = NULL;
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    vector<unsigned char> data;
+    unsigned char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + got);
+    }
+    fclose(file);
+
+    // P2 and P5 are gray, P3 and P6 colour; P2 and P3 are written in ASCII
+    if (data.size() < 2 || data[0] != 'P' || (data[1] != '2' && data[1] != '3' && data[1] != '5' && data[1] != '6'))
+    {
+        return false;
+    }
+    bool colour = data[1] == '3' || data[1] == '6';
+    bool ascii = data[1] == '2' || data[1] == '3';
+    size_t at = 2;
+    int width = readNumber(&data[0], data.size(), at);
+    int height = readNumber(&data[0], data.size(), at);
+    int maxValue = readNumber(&data[0], data.size(), at);
+    if (width <= 0 || height <= 0 || width > MAXIMAGESIDE || height > MAXIMAGESIDE || maxValue <= 0)
+    {
+        return false;
+    }
+
+    // Binary rasters start after a single blank
+    int channels = colour ? 3 : 1;
+    int sampleBytes = maxValue > 255 ? 2 : 1;
+    size_t samples = (size_t)width * height * channels;
+    at++;
+    if (!ascii && data.size() < at + samples * sampleBytes)
+    {
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels = new unsigned char[(size_t)width * height];
+
+    int sample[3] = { 0, 0, 0 };
+    for (size_t i = 0, pixel = 0; i < samples; i++)
+    {
+        int value;
+        if (ascii)
+            value = readNumber(&data[0], data.size(), at);
+        else if (sampleBytes == 2)
+            value = data[at + i * 2] << 8 | data[at + i * 2 + 1];
+        else
+            value = data[at + i];
+        if (value < 0)
+        {
+            deleteImage(image);
+            return false;
+        }
+
+        // Samples scaled to 0..255, colour turned to luminance (ITU-R BT.601)
+        sample[i % channels] = (min(value, maxValue) * 255 + maxValue / 2) / maxValue;
+        if ((int)(i % channels) == channels - 1)
+        {
+            image.pixels[pixel++] = (unsigned char)(colour ? (77 * sample[0] + 150 * sample[1] + 29 * sample[2] + 128) >> 8 : sample[0]);
+        }
+    }
+    return true;
+}
+
+void deleteImage(GrayImage& image)
+{
+    delete[] image.pixels;
+    image.pixels = NULL;
+}
+
+void fitImage(int width, int height, int maxRows, int maxCols, int& rows, int& cols)
+{
+    // A cell is about MAXCOLS / MAXROWS times as tall as it is wide, as in drawBox
+    double aspect = MAXCOLS / (double)MAXROWS;
+
+    cols = maxCols;
+    rows = (int)(cols * (double)height / (width * aspect) + 0.5);
+    if (rows > maxRows)
+    {
+        rows = maxRows;
+        cols = (int)(rows * width * aspect / height + 0.5);
+    }
+    rows = max(1, min(rows, maxRows));
+    cols = max(1, min(cols, maxCols));
+}
+
+// First image row or column covered by cell i of cells over size pixels
+static int spanStart(int i, int cells, int size)
+{
+    return (int)((long long)i * size / cells);
+}
+
+// Averages rows first .. last - 1 of the cells
+static void downsampleRows(const GrayImage* image, unsigned char* levels, int rows, int cols, int first, int last)
+{
+    int width = image->width;
+    vector<unsigned int> sums(width);
+
+    for (int row = first; row < last; row++)
+    {
+        // Cells smaller than a pixel (a small image) take the pixel they fall in
+        int top = spanStart(row, rows, image->height);
+        int bottom = max(spanStart(row + 1, rows, image->height), top + 1);
+
+        // Add up the image rows under this row of cells, a whole image row at a time
+        memset(&sums[0], 0, width * sizeof(unsigned int));
+        for (int y = top; y < bottom; y++)
+        {
+            const unsigned char* line = &image->pixels[(size_t)y * width];
+            unsigned int* sum = &sums[0];
+            for (int x = 0; x < width; x++)
+            {
+                sum[x] += line[x];
+            }
+        }
+
+        for (int col = 0; col < cols; col++)
+        {
+            int left = spanStart(col, cols, width);
+            int right = max(spanStart(col + 1, cols, width), left + 1);
+            unsigned long long total = 0;
+            for (int x = left; x < right; x++)
+            {
+                total += sums[x];
+            }
+            unsigned long long area = (unsigned long long)(bottom - top) * (right - left);
+            levels[row * cols + col] = (unsigned char)((total + area / 2) / area);
+        }
+    }
+}
+
+void downsampleImage(const GrayImage& image, unsigned char* levels, int rows, int cols, int threads)
+{
+    // Each thread takes a band of rows of cells, reading only the image rows under it
+    int most = (int)((long long)image.width * image.height / PIXELSPERTHREAD);
+    parallelFor(rows, min(threads, most), [&](int first, int last) { downsampleRows(&image, levels, rows, cols, first, last); });
+}
+
+void shadeCells(const unsigned char* levels, char* cells, int rows, int cols, const char ramp[], bool dither)
+{
+    int steps = (int)strlen(ramp) - 1;
+    if (steps <= 0)
+    {
+        memset(cells, steps == 0 ? ramp[0] : ' ', (size_t)rows * cols);
+        return;
+    }
+
+    // Floyd-Steinberg: what rounding to the nearest glyph gets wrong is passed
+    // on to the cells right and below, in 16ths; two rows of error are kept
+    vector<int> error(2 * (cols + 2), 0);
+    for (int row = 0; row < rows; row++)
+    {
+        int* here = &error[(row % 2) * (cols + 2) + 1];
+        int* below = &error[((row + 1) % 2) * (cols + 2) + 1];
+        memset(below - 1, 0, (cols + 2) * sizeof(int));
+
+        for (int col = 0; col < cols; col++)
+        {
+            int level = levels[row * cols + col];
+            if (dither)
+            {
+                level = min(255, max(0, level + here[col] / 16));
+            }
+            int glyph = (level * steps + 127) / 255;
+            cells[row * cols + col] = ramp[glyph];
+
+            if (dither)
+            {
+                int wrong = level - glyph * 255 / steps;
+                here[col + 1] += wrong * 7;
+                below[col - 1] += wrong * 3;
+                below[col] += wrong * 5;
+                below[col + 1] += wrong;
+            }
+        }
+    }
+}
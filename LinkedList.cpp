@@ -1,5 +1,4 @@
 #include <iostream>
-#include <Windows.h>
 #include <fstream>
 #include <string>
 #include "Definitions.h"
@@ -9,11 +8,19 @@ Node* newCanvas()
 {
 	// Create a new node
 	Node* newNode = new Node;
+	countAllocation(MEMNODE, sizeof(Node));
 
-	// Initialize the next pointer to null
+	// Initialize the next pointer to null, the node starts out in memory
 	newNode->next = NULL;
-
-	// Initialize the canvas with spaces
+	newNode->spillOffset = 0;
+	newNode->spillLength = 0;
+	newNode->sessionOffset = 0;
+	newNode->tween = NULL;
+	newNode->tweenFrame = 0;
+	newNode->patch = NULL;
+
+	// Give the node its own canvas and initialize it with spaces
+	allocateCanvas(newNode);
 	initCanvas(newNode->item);
 
 	// Return the new node
@@ -24,17 +31,27 @@ Node* newCanvas(Node* oldNode)
 {
 	// Create a new node
 	Node* newNode = new Node;
+	countAllocation(MEMNODE, sizeof(Node));
 
-	// Initialize the next pointer to null
+	// Initialize the next pointer to null, the node starts out in memory
 	newNode->next = NULL;
+	newNode->spillOffset = 0;
+	newNode->spillLength = 0;
+	newNode->sessionOffset = 0;
+	newNode->tween = NULL;
+	newNode->tweenFrame = 0;
+	newNode->patch = NULL;
 
-	// Copy the canvas from the old node to the new node
-	copyCanvas(newNode->item, oldNode->item);
+	// Share the old node's canvas through the store (only copied if not stored yet)
+	shareCanvas(newNode, oldNode);
 
 	// Return the new node
 	return newNode;
 }
 
+// Set once ESC is pressed while an animation plays
+static bool stopPlaying = false;
+
 void play(List& clips)
 {
 	// Check if there are enough clips to play an animation
@@ -45,14 +62,17 @@ void play(List& clips)
 
 	// Display message at the bottom of the screen
 	clearLine(MAXROWS + 1, CLEARCOLS);
-	cout << "Hold <ESC> to stop";
+	cout << "Press <ESC> to stop";
 
-	// loops as long as the ESCAPE key is not currently being pressed
-	while (!(GetKeyState(VK_ESCAPE) & 0x8000))
+	// loops until the ESCAPE key is pressed (keys are read on their own thread)
+	stopPlaying = false;
+	startKeyThread();
+	while (!stopPlaying)
 	{
 		// Play the animation once through
 		playRecursive(clips.head, clips.count);
 	}
+	stopKeyThread();
 
 	clearLine(MAXROWS + 1, CLEARCOLS);
 }
@@ -69,11 +89,13 @@ void playRecursive(Node* head, int count)
 	playRecursive(head->next, count - 1);
 
 	// shortens wait while hitting escape dramatically
-	if ((GetKeyState(VK_ESCAPE) & 0x8000))
+	if (stopPlaying)
+	{
 		return;
+	}
 
-	// Display the current clip
-	displayCanvas(head->item);
+	// Display the current clip (tween frames are drawn just for this)
+	displayCanvas(clipCanvas(head));
 
 	// Clears the area where the clip number is displayed to reset display clip count 
 	gotoxy(MAXROWS + 1, MAXCOLS - 50);
@@ -86,34 +108,127 @@ void playRecursive(Node* head, int count)
 	gotoxy(MAXROWS + 1, MAXCOLS - 50);
 	cout << "Clip: " << count;
 
-	// Pause for 100 milliseconds to slow down animation
+	// Pause for FRAMEMS to slow down animation, unless ESC is pressed meanwhile
+	presentFrame();
+	stopPlaying = waitForKey(ESC, FRAMEMS);
+}
+
+// Over the hard memory limit, frees the redo states (the edit ends them anyway),
+// then the oldest undo states, until there is room for a new one
+static void makeRoomForState(List& undoList, List& redoList)
+{
+	if (roomForState())
+	{
+		return;
+	}
+	deleteList(redoList);
 
-	Sleep(100);
+	while (undoList.head != NULL && !underHardLimit())
+	{
+		// The oldest state is at the end; nothing newer is built on it
+		Node** link = &undoList.head;
+		while ((*link)->next != NULL)
+		{
+			link = &(*link)->next;
+		}
+		deleteNode(*link);
+		*link = NULL;
+		undoList.count--;
+	}
 }
 
 void addUndoState(List& undoList, List& redoList, Node* current)
 {
-	// Create a new node with a copy of the current canvas
+	ProfileScope scope(PROFUNDO);
+
+	// Every edit keeps its undo state; if the clips alone are over the hard limit,
+	// the history is down to this one state
+	makeRoomForState(undoList, redoList);
+
+	// Logged so a crash recovery pushes the same state
+	logOperation(newOperation(OPUNDO));
+
+	// Create a new node with a copy of the current canvas; the store counts
+	// every canvas it didn't have to copy as bytes saved
+	long long saved = getStoreStats().totalBytesSaved;
 	Node* undoNode = newCanvas(current);
+	profileCount(PROFUNDOBYTES, sizeof(ListItemType) - (getStoreStats().totalBytesSaved - saved));
 
 	// Add the new node to the undo list
 	addNode(undoList, undoNode);
 
 	// Delete the redo list since we can no longer redo operations
 	deleteList(redoList);
+
+	// Move older states to disk if the history has outgrown its budget
+	enforceHistoryBudget(undoList, redoList);
+}
+
+void addUndoState(List& undoList, List& redoList, Node* current, Operation op)
+{
+	CellRect bounds;
+	if (operationBounds(current->item, op, bounds))
+	{
+		addUndoState(undoList, redoList, current, bounds);
+	}
+	else
+	{
+		addUndoState(undoList, redoList, current);
+	}
+}
+
+void addUndoState(List& undoList, List& redoList, Node* current, CellRect bounds)
+{
+	ProfileScope scope(PROFUNDO);
+	makeRoomForState(undoList, redoList);
+
+	// Logged like any undo state; crash recovery pushes a whole canvas instead
+	logOperation(newOperation(OPUNDO));
+
+	// Only the cells inside bounds are copied
+	Node* undoNode = newPatch(current->item, bounds);
+	profileCount(PROFUNDOBYTES, rectCells(undoNode->patch->bounds));
+	addNode(undoList, undoNode);
+	deleteList(redoList);
+	enforceHistoryBudget(undoList, redoList);
 }
 
 void restore(List& undoList, List& redoList, Node*& current)
 {
+	// A region state swaps its cells with the current canvas's, then holds the
+	// cells it replaced for going back the other way
+	if (undoList.head != NULL && undoList.head->patch != NULL)
+	{
+		Node* node = removeNode(undoList);
+		swapPatch(node, current->item);
+
+		// It now stands for another canvas, which the session hasn't written
+		node->sessionOffset = 0;
+		addNode(redoList, node);
+		enforceHistoryBudget(undoList, redoList);
+		return;
+	}
+
 	// Add the current canvas to the redo list
 	addNode(redoList, current);
 
 	// Get the canvas from the undo list and make it the current canvas
 	current = removeNode(undoList);
+
+	// Old states may have been spilled to disk; the current canvas gets edited,
+	// so it must be in memory and can't stay shared
+	pageIn(current);
+	makeWritable(current);
+
+	// Keep the states nearest to the new current canvas in memory
+	enforceHistoryBudget(undoList, redoList);
 }
 
 void addNode(List& list, Node* nodeToAdd)
 {
+	// Nodes in a list are read-only, identical canvases are stored once
+	sealCanvas(nodeToAdd);
+
 	// Set the new node's next pointer to point to the current head
 	nodeToAdd->next = list.head;
 
@@ -124,6 +239,29 @@ void addNode(List& list, Node* nodeToAdd)
 	list.count++;
 }
 
+bool addClip(List& clips, Node* node)
+{
+	// Sealed first, since a canvas the store already holds costs next to nothing
+	sealCanvas(node);
+	if (!roomForState())
+	{
+		deleteNode(node);
+		return false;
+	}
+	addNode(clips, node);
+	return true;
+}
+
+void clipNodes(List& clips, Node* nodes[])
+{
+	// The head is the newest clip, so the list fills nodes from the end
+	int number = clips.count;
+	for (Node* node = clips.head; node != NULL; node = node->next)
+	{
+		nodes[--number] = node;
+	}
+}
+
 Node* removeNode(List& list)
 {
 	// Check if the list is empty
@@ -147,6 +285,17 @@ Node* removeNode(List& list)
 	return nodeToRemove;
 }
 
+void deleteNode(Node* node)
+{
+	// Drop the canvas (in memory, spilled or still to be drawn), then the node itself
+	discardSpill(node);
+	releaseCanvas(node);
+	releaseTween(node);
+	releasePatch(node);
+	delete node;
+	countAllocation(MEMNODE, -(long long)sizeof(Node));
+}
+
 void deleteList(List& list)
 {
 	// Create a temporary pointer to track current node
@@ -159,7 +308,7 @@ void deleteList(List& list)
 		next = current->next;
 
 		// Delete the current node
-		delete current;
+		deleteNode(current);
 
 		// Move to the next node
 		current = next;
@@ -176,6 +325,7 @@ bool loadClips(List& clips, char filename[])
 	int clipNumber = 1;
 	bool success = false;
 	bool continueLoading = true;
+	ProfileScope scope(PROFLOADCLIPS);
 
 	// Clear the existing clips
 	deleteList(clips);
@@ -187,21 +337,23 @@ bool loadClips(List& clips, char filename[])
 
 		// Create a new node for this clip
 		Node* newNode = newCanvas();
+		profileCount(PROFFILEOPENS, 1);
 
 		// Try to load the file into the new node
 		// Failed to load this clip, must have reached the end
 		if (!loadCanvas(newNode->item, fullPath))
 		{
 
-			delete newNode;
+			deleteNode(newNode);
 			continueLoading = false;
 		}
 		// Successfully loaded - add to the front of the list
 		else
 		{
 
-			addNode(clips, newNode);
-			success = true;
+			// Stop at the hard memory limit, keeping the clips loaded so far
+			continueLoading = addClip(clips, newNode);
+			success = success || continueLoading;
 			clipNumber++;
 		}
 	}
@@ -239,7 +391,7 @@ bool saveClips(List& clips, char filename[])
 		snprintf(fullPath, FILENAMESIZE, "%s-%d.txt", filename, i + 1);
 
 		// Save the clip to a file
-		if (!saveCanvas(clipArray[i]->item, fullPath))
+		if (!saveCanvas(clipCanvas(clipArray[i]), fullPath))
 		{
 			allSaved = false;
 		}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <limits>
+#include "Definitions.h"
+using namespace std;
+
+// The recorded macro
+static vector<Operation> steps;
+static bool recording = false;
+
+void startMacro()
+{
+    steps.clear();
+    recording = true;
+}
+
+void stopMacro()
+{
+    recording = false;
+}
+
+bool isRecordingMacro()
+{
+    return recording;
+}
+
+int macroLength()
+{
+    return (int)steps.size();
+}
+
+void recordOperation(Operation op)
+{
+    if (recording && op.type != OPUNDO)
+    {
+        steps.push_back(op);
+    }
+}
+
+MacroStats replayMacro(Node* current, List& undoList, List& redoList, List& clips, bool allClips)
+{
+    MacroStats stats = { (int)steps.size(), 0, 0 };
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    if (!allClips)
+    {
+        // The whole replay is undone in one step
+        addUndoState(undoList, redoList, current);
+        for (size_t i = 0; i < steps.size(); i++)
+        {
+            if (steps[i].type == OPCLIP)
+            {
+                addClip(clips, newCanvas(current));
+            }
+            else
+            {
+                // Logged like any other edit so a crash can redo it, but not recorded into the macro again
+                logOperation(steps[i]);
+                applyOperation(current->item, steps[i], false);
+            }
+        }
+        stats.canvases = 1;
+    }
+    else
+    {
+        for (Node* clip = clips.head; clip != NULL; clip = clip->next)
+        {
+            // Clips are shared and sealed; take a private copy to change
+            pageIn(clip);
+            makeWritable(clip);
+            for (size_t i = 0; i < steps.size(); i++)
+            {
+                applyOperation(clip->item, steps[i], false);
+            }
+            sealCanvas(clip);
+            stats.canvases++;
+        }
+    }
+
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+void macroMenu(Node* current, List& undoList, List& redoList, List& clips)
+{
+    char input;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Macro: " << steps.size() << " steps" << (recording ? ", recording" : "") << "\n";
+    cout << "<R>ecord / <S>top / replay on <C>anvas / replay on <A>ll clips / <ESC> to cancel: ";
+    cin >> input;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    switch (input)
+    {
+    case 'r':
+    case 'R':
+        startMacro();
+        break;
+    case 's':
+    case 'S':
+        stopMacro();
+        break;
+    case 'c':
+    case 'C':
+    case 'a':
+    case 'A':
+    {
+        // Replaying while recording would record nothing useful
+        stopMacro();
+        MacroStats stats = replayMacro(current, undoList, redoList, clips, input == 'a' || input == 'A');
+        double operations = (double)stats.steps * stats.canvases;
+
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        clearLine(MAXROWS + 2, CLEARCOLS);
+        gotoxy(MAXROWS + 1, 0);
+        cout << "Replayed " << stats.steps << " steps on " << stats.canvases << " canvases in " << stats.ms << " ms ("
+            << (stats.ms > 0 ? operations * 1000 / stats.ms : 0) << " operations/s)\n";
+        pauseScreen();
+        break;
+    }
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <algorithm>
+#include "Definitions.h"
+using namespace std;
+
+static long long kindBytes[MEMKINDS] = {};
+static long long liveBytes = 0;
+static long long peakBytes = 0;
+static long long softLimit = MEMORYSOFTLIMIT;
+static long long hardLimit = MEMORYHARDLIMIT;
+static int refusals = 0;
+
+// Most bytes each list has been measured at
+static long long undoPeak = 0, redoPeak = 0, clipsPeak = 0;
+
+void countAllocation(MemoryKind kind, long long bytes)
+{
+    kindBytes[kind] += bytes;
+    liveBytes += bytes;
+    peakBytes = max(peakBytes, liveBytes);
+}
+
+bool underHardLimit()
+{
+    return liveBytes < hardLimit;
+}
+
+bool roomForState()
+{
+    if (underHardLimit())
+    {
+        return true;
+    }
+    refusals++;
+    return false;
+}
+
+void setMemoryLimits(long long soft, long long hard)
+{
+    softLimit = soft;
+    hardLimit = hard;
+}
+
+// Charges each state in list its node and its share of whatever canvas it uses
+static ListMemory measureList(List& list, long long& peak)
+{
+    ListMemory memory = {};
+
+    for (Node* node = list.head; node != NULL; node = node->next)
+    {
+        memory.states++;
+        memory.liveBytes += sizeof(Node);
+
+        if (!isSpilled(node))
+        {
+            int users = node->blob->refCount;
+            memory.liveBytes += sizeof(CanvasBlob) / users;
+            if (users > 1)
+                memory.sharedCanvases++;
+            else
+                memory.privateCanvases++;
+        }
+        else if (node->patch != NULL)
+        {
+            memory.liveBytes += sizeof(CanvasPatch) + rectCells(node->patch->bounds) + 1;
+            memory.regionStates++;
+        }
+        else if (node->tween != NULL)
+        {
+            // Frames share their tween and its base canvas
+            Tween* tween = node->tween;
+            long long base = sizeof(Tween) + sizeof(Node);
+            if (!isSpilled(tween->base))
+            {
+                base += sizeof(CanvasBlob) / tween->base->blob->refCount;
+            }
+            memory.liveBytes += base / tween->refCount;
+            memory.lazyStates++;
+        }
+        else if (node->spillLength > 0)
+        {
+            memory.spilledStates++;
+            memory.spilledBytes += node->spillLength;
+        }
+        else
+        {
+            // Still in the session file
+            memory.lazyStates++;
+        }
+    }
+
+    peak = max(peak, memory.liveBytes);
+    memory.peakBytes = peak;
+    return memory;
+}
+
+MemoryStats getMemoryStats(List& undoList, List& redoList, List& clips)
+{
+    MemoryStats stats;
+    stats.undo = measureList(undoList, undoPeak);
+    stats.redo = measureList(redoList, redoPeak);
+    stats.clips = measureList(clips, clipsPeak);
+    for (int i = 0; i < MEMKINDS; i++)
+    {
+        stats.kindBytes[i] = kindBytes[i];
+    }
+    stats.liveBytes = liveBytes;
+    stats.peakBytes = peakBytes;
+    stats.softLimit = softLimit;
+    stats.hardLimit = hardLimit;
+    stats.refusals = refusals;
+    return stats;
+}
@@ -1,10 +1,15 @@
 #include <iostream>
 #include <fstream>
 #include <cctype>
-#include <windows.h>
-#include <conio.h>
+#include <limits>
 #include <string>
 #include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <thread>
 #include "Definitions.h"
 using namespace std;
 
@@ -23,24 +28,44 @@ DrawPoint findEndPoint(DrawPoint start, int len, int angle)
     return end;
 }
 
+// While set, drawHelper only widens this rectangle (see operationBounds)
+static CellRect* measuring = NULL;
+
+void measureDrawing(CellRect* bounds)
+{
+    measuring = bounds;
+}
+
 // Use this to draw characters into the canvas, with the option of performing animation
 void drawHelper(char canvas[][MAXCOLS], Point p, char ch, bool animate)
 {
     // Pause time between steps (in milliseconds)
     const int TIME = 50;
 
+    if (measuring != NULL)
+    {
+        measuring->top = min(measuring->top, p.row);
+        measuring->left = min(measuring->left, p.col);
+        measuring->bottom = max(measuring->bottom, p.row);
+        measuring->right = max(measuring->right, p.col);
+        return;
+    }
+
+    profileCount(PROFDRAWS, 1);
+
     // Make sure point is within bounds
     if (p.row >= 0 && p.row < MAXROWS && p.col >= 0 && p.col < MAXCOLS)
     {
         // Draw character into the canvas
+        noteCellWrite(canvas, p.row, p.col, ch);
         canvas[p.row][p.col] = ch;
 
         // If animation is enabled, draw to screen at same time
         if (animate)
         {
             gotoxy(p.row, p.col);
-            printf("%c", ch);
-            Sleep(TIME);
+            cout << ch;
+            sleepMs(TIME);
         }
     }
 }
@@ -162,6 +187,7 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
     int height, branchAngle;
     char pointChar;
     Point userPoint, userPoint2;
+    Operation op;
     char animateChar = animate ? 'Y' : 'N';
     int boxSize;
 
@@ -181,7 +207,7 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
 
         // Display draw menu line
         clearLine(MAXROWS + 2, CLEARCOLS);
-        cout << "<F>ill / <L>ine / <B>ox / <N>ested Boxes / <T>ree / <M>ain Menu: ";
+        cout << "<F>ill / <L>ine / <B>ox / <N>ested Boxes / <T>ree / <G>ame of Life / <W>rite Banner / <R>otate or Flip / <M>ain Menu: ";
 
         cin >> input;
         cin.clear();
@@ -215,7 +241,9 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
         case 'i':
         case 'I':
             // Add the current canvas to the clips list
-            addNode(clips, newCanvas(current));
+            if (addClip(clips, newCanvas(current))) {
+                recordOperation(newOperation(OPCLIP));
+            }
             break;
             // play animation clips
         case 'p':
@@ -242,14 +270,18 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             if (pointChar == ESC)
                 break;
 
-            // Add to undo list before modifying the canvas
-            addUndoState(undoList, redoList, current);
-
             if (pointChar == 'c' || pointChar == 'C') {
                 userPoint.col = MAXCOLS / 2;
                 userPoint.row = MAXROWS - 1;
             }
-            treeRecursive(current->item, userPoint, height, 270, branchAngle, animate);
+            op = newOperation(OPTREE);
+            op.start = userPoint;
+            op.size = height;
+            op.angle = branchAngle;
+
+            // Add to undo list before modifying the canvas (just the cells the tree covers)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
             break;
             // draw box
         case 'b':
@@ -257,6 +289,8 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             clearLine(MAXROWS + 1, CLEARCOLS);
             cout << "Enter size: ";
             cin >> boxSize;
+            // A box twice the canvas height is drawn entirely off it, so nothing past that changes the drawing
+            boxSize = max(-2 * MAXROWS, min(boxSize, 2 * MAXROWS));
             cin.clear();
             cin.ignore((numeric_limits<streamsize>::max)(), '\n');
             clearLine(MAXROWS + 1, CLEARCOLS);
@@ -265,14 +299,17 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             if (pointChar == ESC)
                 break;
 
-            // Add to undo list before modifying the canvas
-            addUndoState(undoList, redoList, current);
-
             if (pointChar == 'c' || pointChar == 'C') {
                 userPoint.row = MAXROWS / 2;
                 userPoint.col = MAXCOLS / 2;
             }
-            drawBox(current->item, userPoint, boxSize, animate);
+            op = newOperation(OPBOX);
+            op.start = userPoint;
+            op.size = boxSize;
+
+            // Add to undo list before modifying the canvas (just the cells the box covers)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
             break;
             // draw nested boxes
         case 'n':
@@ -280,6 +317,8 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             clearLine(MAXROWS + 1, CLEARCOLS);
             cout << "Enter size of largest box: ";
             cin >> boxSize;
+            // A box twice the canvas height is drawn entirely off it, so nothing past that changes the drawing
+            boxSize = max(-2 * MAXROWS, min(boxSize, 2 * MAXROWS));
             cin.clear();
             cin.ignore((numeric_limits<streamsize>::max)(), '\n');
             clearLine(MAXROWS + 1, CLEARCOLS);
@@ -288,14 +327,17 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             if (pointChar == ESC)
                 break;
 
-            // Add to undo list before modifying the canvas
-            addUndoState(undoList, redoList, current);
-
             if (pointChar == 'c' || pointChar == 'C') {
                 userPoint.row = MAXROWS / 2;
                 userPoint.col = MAXCOLS / 2;
             }
-            drawBoxesRecursive(current->item, userPoint, boxSize, animate);
+            op = newOperation(OPBOXES);
+            op.start = userPoint;
+            op.size = boxSize;
+
+            // Add to undo list before modifying the canvas (just the cells the boxes cover)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
             break;
             // draw line
         case 'l':
@@ -311,10 +353,33 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             if (pointChar == ESC)
                 break;
 
-            // Add to undo list before modifying the canvas
-            addUndoState(undoList, redoList, current);
+            op = newOperation(OPLINE);
+            op.start = userPoint;
+            op.end = userPoint2;
+
+            // Add to undo list before modifying the canvas (just the cells the line covers)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
+            break;
+            // rotate, flip or scale the canvas or part of it
+        case 'r':
+        case 'R':
+            if (!transformMenu(op))
+                break;
 
-            drawLine(current->item, userPoint, userPoint2, animate);
+            // Add to undo list before modifying the canvas (just the cells moved and where they land)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
+            break;
+            // add generations of a cellular automaton to the clips
+        case 'g':
+        case 'G':
+            automatonMenu(current, clips);
+            break;
+            // draw or scroll large text in a FIGlet font
+        case 'w':
+        case 'W':
+            bannerMenu(current, undoList, redoList, clips);
             break;
             // fill area
         case 'f':
@@ -325,13 +390,663 @@ void menuTwo(Node*& current, List& undoList, List& redoList, List& clips, bool&
             if (pointChar == ESC)
                 break;
 
-            // Add to undo list before modifying the canvas
-            addUndoState(undoList, redoList, current);
+            op = newOperation(OPFILL);
+            op.start = userPoint;
+            op.ch = pointChar;
+
+            // Add to undo list before modifying the canvas (just the area being filled)
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
+            break;
+        }
+
+        // Record what changed in the session file
+        checkpointSession(current, undoList, redoList, clips);
+    }
+}
+
+// Shows statistics in place of the drawing until a key is pressed
+void displayStats(List& undoList, List& redoList, List& clips)
+{
+    // Number of pages of statistics
+    const int STATSPAGES = 4;
+
+    int page = 0;
+    char input;
+
+    do {
+        StoreStats store = getStoreStats();
+        HistoryStats history = getHistoryStats(undoList, redoList);
+        SessionStats session = getSessionStats();
+        OpLogStats log = getOpLogStats();
+        TerminalStats terminal = getTerminalStats();
+        PlaneStats planes = getPlaneStats();
+        TweenStats tweens = getTweenStats();
+        BannerStats banners = getBannerStats();
+        ProfileStats profile = getProfileStats();
+        MemoryStats memory = getMemoryStats(undoList, redoList, clips);
+        OnionStats onion = getOnionStats();
+        SheetStats sheet = getSheetStats();
+
+        // Blank out the drawing area and the menu lines
+        for (int row = 0; row <= MAXROWS + 2; row++)
+        {
+            clearLine(row, CLEARCOLS);
+        }
+
+        gotoxy(0, 0);
+        if (page == 0)
+        {
+            cout << "Canvas store (undo / redo / clips)\n";
+            cout << "  States:              " << undoList.count << " / " << redoList.count << " / " << clips.count << "\n";
+            cout << "  Unique canvases:     " << store.uniqueCanvases << "\n";
+            cout << "  Handles:             " << store.handles << "\n";
+            cout << "  Bytes saved:         " << store.bytesSaved << " now, " << store.totalBytesSaved << " overall\n";
+            cout << "\n";
+            cout << "History (undo / redo)\n";
+            cout << "  Memory budget:       " << history.budget / 1024 << " KB\n";
+            cout << "  Resident states:     " << history.residentStates << " (" << history.regionStates
+                << " holding only the cells an operation changed)\n";
+            cout << "  Spilled states:      " << history.spilledStates << " (" << history.spilledBytes << " bytes compressed)\n";
+            cout << "  Spill file:          " << history.spillFileBytes << " bytes\n";
+            cout << "  Paged back in:       " << history.pageIns << "\n";
+            cout << "\n";
+            cout << "Session (" << SESSIONFILE << (session.active ? ")\n" : ", not open)\n");
+            cout << "  Opened in:           " << session.openMs << " ms (" << session.restoredStates << " states restored)\n";
+            cout << "  File size:           " << session.fileBytes << " bytes\n";
+            cout << "  Written this run:    " << session.bytesWritten << " bytes (" << session.canvasRecords << " canvases, "
+                << session.listsRecords << " checkpoints)\n";
+        }
+        else if (page == 1)
+        {
+            cout << "Operation log (" << OPLOGFILE << (log.active ? ")\n" : ", not open)\n");
+            cout << "  Logged:              " << log.opsLogged << " operations (" << log.cellOps << " keystrokes), "
+                << log.payloadBytes << " bytes encoded\n";
+            cout << "  Group commits:       " << log.commits << " (" << (log.commits > 0 ? (double)log.opsLogged / log.commits : 0)
+                << " operations each, " << log.commitMs << " ms to write and sync)\n";
+            cout << "  Write amplification: " << (log.payloadBytes > 0 ? (double)log.bytesLogged / log.payloadBytes : 0) << " ("
+                << (log.opsLogged > 0 ? (double)log.bytesLogged / log.opsLogged : 0) << " bytes/op vs "
+                << sizeof(ListItemType) << " for a full autosave)\n";
+            cout << "  Added per edit:      " << log.appendUs << " us (worst " << log.maxAppendUs << " us), "
+                << log.recoveredOps << " operations recovered at startup\n";
+            cout << "\n";
+            cout << "Terminal\n";
+            cout << "  Frames drawn:        " << terminal.frames << " (" << terminal.writes << " writes, " << terminal.reads << " reads, "
+                << terminal.modeSwitches << " mode switches, "
+                << (terminal.frames > 0 ? (double)(terminal.writes + terminal.reads + terminal.modeSwitches) / terminal.frames : 0)
+                << " calls per frame)\n";
+            cout << "  Key to screen:       " << terminal.latencyMs << " ms (worst " << terminal.maxLatencyMs << " ms), "
+                << terminal.keysPresented << " keys in " << terminal.keyFrames << " frames\n";
+            cout << "\n";
+            cout << "Character planes" << (planes.tracking ? "\n" : " (not in use)\n");
+            cout << "  Characters tracked:  " << planes.distinct << "\n";
+            cout << "  Updated cells:       " << planes.cellUpdates << " (" << planes.rebuilds << " full rebuilds)\n";
+            cout << "  Too many characters: " << planes.overflows << " times (" << planes.fallbacks << " scans instead)\n";
+            cout << "\n";
+            cout << "Tweens\n";
+            cout << "  Frames not kept:     " << tweens.lazyFrames << " in " << tweens.tweens << " tweens ("
+                << (long long)tweens.lazyFrames * sizeof(ListItemType) / 1024 << " KB of canvases not allocated)\n";
+            cout << "  Frames drawn:        " << tweens.framesDrawn << " (" << tweens.framesKept << " given their own canvas)\n";
+        }
+        else if (page == 2)
+        {
+            cout << "Banners\n";
+            cout << "  Fonts loaded:        " << banners.fonts << " (" << banners.glyphsParsed << " glyphs parsed, "
+                << banners.atlasBytes << " bytes of atlas)\n";
+            cout << "  Glyph cache:         " << banners.lookups << " lookups, "
+                << (banners.lookups > 0 ? 100.0 * (banners.lookups - banners.misses) / banners.lookups : 0) << "% hits\n";
+            cout << "  Rendered:            " << banners.renders << " banners ("
+                << (banners.renders > 0 ? banners.renderUs / banners.renders : 0) << " us each)\n";
+            cout << "\n";
+            cout << "Profiler" << (profile.enabled ? "\n" : " (off)\n");
+            const char* names[PROFTIMERS] = { "displayCanvas", "applyOperation", "addUndoState", "loadClips" };
+            for (int i = 0; i < PROFTIMERS; i++)
+            {
+                cout << "  " << names[i] << ":" << string(20 - strlen(names[i]), ' ') << profile.calls[i] << " calls, "
+                    << profile.totalMs[i] << " ms (worst " << profile.maxMs[i] << " ms)\n";
+            }
+            cout << "  Counted:             " << profile.counts[PROFDRAWS] << " drawHelper calls, "
+                << profile.counts[PROFFILLCELLS] << " fill cells, " << profile.counts[PROFUNDOBYTES] << " undo bytes copied, "
+                << profile.counts[PROFFILEOPENS] << " clip files opened\n";
+            cout << "  Trace:               " << profile.events << " calls kept (" << profile.droppedEvents << " dropped)\n";
+            cout << "\n";
+            cout << "Onion skin" << (onion.frames > 0 ? "\n" : " (off)\n");
+            cout << "  Clips shown:         " << onion.frames << " either side of clip " << onion.clip << " ("
+                << onion.layerCells << " cells, composited " << onion.layerBuilds << " times)\n";
+            cout << "  Frames drawn:        " << onion.fullFrames << " whole, " << onion.incrementalFrames << " incrementally ("
+                << (onion.incrementalFrames > 0 ? (double)onion.cellsWritten / onion.incrementalFrames : 0) << " cells each)\n";
+            cout << "\n";
+            cout << "Contact sheet\n";
+            cout << "  Thumbnails:          " << sheet.made << " made (on up to " << sheet.threads << " threads), " << sheet.reused
+                << " cached, " << sheet.cached << " kept now\n";
+            cout << "  Sheets drawn:        " << sheet.sheets << " (" << sheet.lastMs << " ms for the last)\n";
+        }
+        else
+        {
+            cout << "Memory (soft limit " << memory.softLimit / 1024 << " KB, hard limit " << memory.hardLimit / 1024 << " KB)\n";
+            cout << "  In use:              " << memory.liveBytes / 1024 << " KB (peak " << memory.peakBytes / 1024 << " KB), "
+                << memory.refusals << " times over the hard limit\n";
+            cout << "  By kind:             " << memory.kindBytes[MEMCANVAS] / 1024 << " KB canvases, "
+                << memory.kindBytes[MEMNODE] / 1024 << " KB nodes, " << memory.kindBytes[MEMTWEEN] / 1024 << " KB tweens, "
+                << memory.kindBytes[MEMPATCH] / 1024 << " KB region states\n";
+            const char* names[3] = { "Undo", "Redo", "Clips" };
+            const ListMemory* lists[3] = { &memory.undo, &memory.redo, &memory.clips };
+            for (int i = 0; i < 3; i++)
+            {
+                const ListMemory& list = *lists[i];
+                cout << "\n";
+                cout << names[i] << "\n";
+                cout << "  In use:              " << list.liveBytes / 1024 << " KB (peak " << list.peakBytes / 1024 << " KB), "
+                    << (list.states > 0 ? list.liveBytes / list.states : 0) << " bytes per state\n";
+                cout << "  States:              " << list.states << ": " << list.privateCanvases << " own canvas, "
+                    << list.sharedCanvases << " shared, " << list.regionStates << " regions, " << list.lazyStates << " not drawn or loaded yet, "
+                    << list.spilledStates << " paged out (" << list.spilledBytes / 1024 << " KB on disk)\n";
+            }
+        }
+
+        gotoxy(MAXROWS + 1, 0);
+        cout << "Page " << page + 1 << "/" << STATSPAGES
+            << ": <N>ext page / <B> to change the history budget / <L> to change the memory limits / <P>rofiler " << (profile.enabled ? "off" : "on")
+            << " / <W>rite the profile trace / any other key to continue . . .";
+        input = getKey();
+        page = (page + 1) % STATSPAGES;
+    } while (input == 'n' || input == 'N');
+
+    if (input == 'b' || input == 'B')
+    {
+        long long budgetKB;
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter history budget in KB: ";
+        cin >> budgetKB;
+        if (cin)
+        {
+            setHistoryBudget(budgetKB * 1024);
+            enforceHistoryBudget(undoList, redoList);
+        }
+        cin.clear();
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    }
+    else if (input == 'l' || input == 'L')
+    {
+        long long softKB, hardKB;
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the soft then hard memory limit in KB: ";
+        cin >> softKB >> hardKB;
+        if (cin && softKB > 0 && hardKB >= softKB)
+        {
+            setMemoryLimits(softKB * 1024, hardKB * 1024);
+        }
+        cin.clear();
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    }
+    else if (input == 'p' || input == 'P')
+    {
+        enableProfiler(!profilerEnabled());
+    }
+    else if (input == 'w' || input == 'W')
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        if (writeProfileTrace())
+            cout << "Profile trace written to " << PROFILEJSON << " and " << PROFILECSV << ". ";
+        else
+            cout << "ERROR: Could not write the profile trace. ";
+        pauseScreen();
+    }
+
+    // Clear the statistics so the canvas can be redrawn cleanly
+    for (int row = 0; row <= MAXROWS + 1; row++)
+    {
+        clearLine(row, CLEARCOLS);
+    }
+}
+
+void findMenu(Node* current, List& clips)
+{
+    // Matches highlighted on the canvas, and positions or clips listed, at most
+    const int MAXHIGHLIGHTED = 200;
+    const int MAXLISTED = 8;
+
+    static char pattern[MAXROWS * MAXCOLS];
+    int patRows = 0, patCols = 0;
+    char wildcard = '\0', input;
+    string text;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter text to find, or @name to find the art in SavedFiles/name.txt: ";
+    getline(cin, text);
+
+    if (text.size() > 1 && text[0] == '@')
+    {
+        // The art in the file, trimmed to the cells holding something
+        ListItemType art;
+        char filePath[FILENAMESIZE];
+        int top = MAXROWS, left = MAXCOLS, bottom = -1, right = -1;
+
+        snprintf(filePath, FILENAMESIZE, "SavedFiles/%s.txt", text.c_str() + 1);
+        if (loadCanvas(art, filePath))
+        {
+            for (int row = 0; row < MAXROWS; row++)
+            {
+                for (int col = 0; col < MAXCOLS; col++)
+                {
+                    if (art[row][col] != ' ')
+                    {
+                        top = min(top, row);
+                        bottom = max(bottom, row);
+                        left = min(left, col);
+                        right = max(right, col);
+                    }
+                }
+            }
+        }
+        for (int row = top; row <= bottom; row++)
+        {
+            memcpy(&pattern[(row - top) * (right - left + 1)], &art[row][left], right - left + 1);
+        }
+        patRows = bottom - top + 1;
+        patCols = right - left + 1;
+    }
+    else if (text.size() <= (size_t)MAXCOLS)
+    {
+        memcpy(pattern, text.c_str(), text.size());
+        patRows = 1;
+        patCols = (int)text.size();
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (patRows <= 0 || patCols <= 0)
+    {
+        cout << "ERROR: Nothing to find. ";
+        pauseScreen();
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        return;
+    }
+
+    cout << "Pattern is " << patRows << "x" << patCols << ". Wildcard character (<ENTER> for none): ";
+    cin.get(input);
+    if (input != '\n')
+    {
+        wildcard = input;
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Search the <C>anvas or <A>ll clips: ";
+    cin >> input;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    if (input == 'a' || input == 'A')
+    {
+        // Clips are numbered as they're played and saved, the oldest first
+        int clip = clips.count, matches = 0;
+        vector<int> found;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (Node* node = clips.head; node != NULL; node = node->next, clip--)
+        {
+            int count = findPattern(&clipCanvas(node)[0][0], MAXROWS, MAXCOLS, pattern, patRows, patCols,
+                wildcard, NULL, 0);
+            if (count > 0)
+            {
+                found.push_back(clip);
+                matches += count;
+            }
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << matches << " matches in " << found.size() << " of " << clips.count << " clips (" << ms << " ms)";
+        for (int i = 0; i < (int)found.size() && i < MAXLISTED; i++)
+        {
+            cout << (i == 0 ? ": " : " ") << found[found.size() - 1 - i];
+        }
+        cout << ((int)found.size() > MAXLISTED ? " ..." : "");
+    }
+    else
+    {
+        Point found[MAXHIGHLIGHTED];
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int count = findPattern(&current->item[0][0], MAXROWS, MAXCOLS, pattern, patRows, patCols,
+            wildcard, found, MAXHIGHLIGHTED);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        // Show the matched cells in reverse video
+        displayCanvas(current->item);
+        for (int i = 0; i < count && i < MAXHIGHLIGHTED; i++)
+        {
+            for (int row = 0; row < patRows; row++)
+            {
+                for (int col = 0; col < patCols; col++)
+                {
+                    char ch = pattern[row * patCols + col];
+                    if (ch != wildcard)
+                    {
+                        gotoxy(found[i].row + row, found[i].col + col);
+                        cout << "\x1b[7m" << ch << "\x1b[0m";
+                    }
+                }
+            }
+        }
+
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << count << " matches (" << us << " us)";
+        for (int i = 0; i < count && i < MAXLISTED; i++)
+        {
+            cout << (i == 0 ? ": " : " ") << found[i].row << "," << found[i].col;
+        }
+        cout << (count > MAXLISTED ? " ..." : "");
+    }
 
-            fillRecursive(current->item, userPoint.row, userPoint.col, current->item[userPoint.row][userPoint.col], pointChar, animate);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    pauseScreen();
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
+
+void automatonMenu(Node* current, List& clips)
+{
+    // Most generations one run may add
+    const int MAXGENERATIONS = 10000;
+
+    AutomatonRule rule;
+    int generations;
+    char liveGlyph = '#', deadGlyph = ' ', wrap = 'N';
+    string text;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the rule (<ENTER> for B3/S23, Conway's Life): ";
+    getline(cin, text);
+    if (!parseRule(text.empty() ? "B3/S23" : text.c_str(), rule))
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "ERROR: Rules look like B3/S23. ";
+        pauseScreen();
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        return;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the number of generations to add as clips: ";
+    cin >> generations;
+    bool valid = cin && generations > 0 && generations <= MAXGENERATIONS;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    if (!valid)
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        return;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the live then dead character (<ENTER> for # and space): ";
+    getline(cin, text);
+    liveGlyph = text.size() > 0 ? text[0] : liveGlyph;
+    deadGlyph = text.size() > 1 ? text[1] : deadGlyph;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Wrap around the edges (Y/N): ";
+    cin >> wrap;
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    // Anything on the canvas but the dead character is alive
+    CellGrid grid = newGrid(MAXROWS, MAXCOLS);
+    CellGrid next = newGrid(MAXROWS, MAXCOLS);
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    double stepMs = 0;
+    gridFromCells(&current->item[0][0], grid, deadGlyph);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int added = 0;
+    for (int i = 0; i < generations; i++)
+    {
+        chrono::steady_clock::time_point stepStart = chrono::steady_clock::now();
+        stepGrid(grid, next, rule, wrap == 'y' || wrap == 'Y', threads);
+        stepMs += chrono::duration<double, milli>(chrono::steady_clock::now() - stepStart).count();
+        swap(grid, next);
+
+        Node* node = newCanvas();
+        cellsFromGrid(grid, &node->item[0][0], liveGlyph, deadGlyph);
+        canvasChanged(node->item);
+        if (!addClip(clips, node))
+        {
             break;
         }
+        added++;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    deleteGrid(grid);
+    deleteGrid(next);
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << added << " generations added as clips in " << ms << " ms: " << added * 1000 / ms
+        << " generations/s (" << added * 1000 / stepMs << "/s stepping alone)";
+    if (added < generations)
+    {
+        cout << ", then the memory limit was reached";
+    }
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    pauseScreen();
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
+
+// Draws the image in path into canvas, centred; adds the pixels read to pixels
+static bool importImage(const char path[], char canvas[][MAXCOLS], const char ramp[], bool dither, long long& pixels)
+{
+    GrayImage image;
+    if (!loadImage(path, image))
+    {
+        return false;
+    }
+
+    unsigned char levels[MAXROWS * MAXCOLS];
+    char cells[MAXROWS * MAXCOLS];
+    int rows, cols;
+    fitImage(image.width, image.height, MAXROWS, MAXCOLS, rows, cols);
+    downsampleImage(image, levels, rows, cols, (int)max(1u, thread::hardware_concurrency()));
+    shadeCells(levels, cells, rows, cols, ramp, dither);
+
+    initCanvas(canvas);
+    int top = (MAXROWS - rows) / 2, left = (MAXCOLS - cols) / 2;
+    for (int row = 0; row < rows; row++)
+    {
+        memcpy(&canvas[top + row][left], &cells[row * cols], cols);
+    }
+    canvasChanged(canvas);
+
+    pixels += (long long)image.width * image.height;
+    deleteImage(image);
+    return true;
+}
+
+void importMenu(Node* current, List& undoList, List& redoList, List& clips)
+{
+    // Glyphs from darkest to lightest, for light text on a dark terminal
+    const char DEFAULTRAMP[] = " .:-=+*#%@";
+
+    string name, ramp;
+    char dither = 'N';
+    int images = 0;
+    long long pixels = 0;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the image file (name.pgm or name.ppm), or name for name-1.pgm, name-2.pgm, ... as clips: ";
+    getline(cin, name);
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Enter the characters from dark to light (<ENTER> for \"" << DEFAULTRAMP << "\"): ";
+    getline(cin, ramp);
+    if (ramp.empty())
+    {
+        ramp = DEFAULTRAMP;
     }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Dither (Y/N): ";
+    cin >> dither;
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    char filePath[FILENAMESIZE];
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (name.find('.') != string::npos)
+    {
+        // One image, onto the current canvas
+        snprintf(filePath, FILENAMESIZE, "SavedFiles/%s", name.c_str());
+        ListItemType canvas;
+        if (importImage(filePath, canvas, ramp.c_str(), dither == 'y' || dither == 'Y', pixels))
+        {
+            addUndoState(undoList, redoList, current);
+            copyCanvas(current->item, canvas);
+            images++;
+        }
+    }
+    else if (!name.empty())
+    {
+        // A sequence, numbered from 1 like saved clips, each image becoming a clip
+        for (bool more = true; more; )
+        {
+            Node* node = newCanvas();
+            snprintf(filePath, FILENAMESIZE, "SavedFiles/%s-%d.pgm", name.c_str(), images + 1);
+            more = importImage(filePath, node->item, ramp.c_str(), dither == 'y' || dither == 'Y', pixels);
+            if (!more)
+            {
+                snprintf(filePath, FILENAMESIZE, "SavedFiles/%s-%d.ppm", name.c_str(), images + 1);
+                more = importImage(filePath, node->item, ramp.c_str(), dither == 'y' || dither == 'Y', pixels);
+            }
+
+            if (more)
+            {
+                // Stop at the hard memory limit
+                more = addClip(clips, node);
+                images += more ? 1 : 0;
+            }
+            else
+            {
+                deleteNode(node);
+            }
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (images == 0)
+    {
+        cout << "ERROR: No image could be read. ";
+    }
+    else
+    {
+        cout << images << (images == 1 ? " image" : " images") << " imported in " << ms << " ms ("
+            << pixels / 1000.0 / ms << " Mpixels/s)";
+    }
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    pauseScreen();
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
+
+void bannerMenu(Node* current, List& undoList, List& redoList, List& clips)
+{
+    static char cells[MAXROWS * MAXBANNERWIDTH];
+    string name, text;
+    char input;
+    Point corner;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the font in Fonts/ (don't enter '.flf', <ENTER> for block): ";
+    getline(cin, name);
+
+    char filePath[FILENAMESIZE];
+    snprintf(filePath, FILENAMESIZE, "Fonts/%s.flf", name.empty() ? "block" : name.c_str());
+    Font* font = loadFont(filePath);
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    if (font == NULL)
+    {
+        cout << "ERROR: Font cannot be read. ";
+        pauseScreen();
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        return;
+    }
+
+    cout << "Enter the text: ";
+    getline(cin, text);
+    int height = fontHeight(font);
+    int width = renderBanner(font, text.c_str(), cells, MAXBANNERWIDTH);
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "<D>raw it on the canvas or <S>croll it across the canvas into new clips: ";
+    cin >> input;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    if (input == 'd' || input == 'D')
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Type any letter to choose the top left corner, or <C> for centred / <ESC> to cancel";
+        input = getPoint(corner);
+        if (input != ESC)
+        {
+            if (input == 'c' || input == 'C')
+            {
+                corner = Point((MAXROWS - height) / 2, (MAXCOLS - width) / 2);
+            }
+            // Only the banner's rectangle changes
+            CellRect bounds = { corner.row, corner.col, corner.row + height - 1, corner.col + width - 1 };
+            addUndoState(undoList, redoList, current, bounds);
+            blitBanner(current->item, cells, height, width, MAXBANNERWIDTH, corner.row, corner.col);
+        }
+    }
+    else if (input == 's' || input == 'S')
+    {
+        int step = 0;
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the columns to move each frame: ";
+        cin >> step;
+        cin.clear();
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+        if (step > 0)
+        {
+            // From just off the right edge to just off the left, the banner
+            // rendered again for every frame
+            BannerStats before = getBannerStats();
+            int frames = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int col = MAXCOLS; col > -width; col -= step, frames++)
+            {
+                Node* node = newCanvas();
+                copyCanvas(node->item, current->item);
+                width = renderBanner(font, text.c_str(), cells, MAXBANNERWIDTH);
+                blitBanner(node->item, cells, height, width, MAXBANNERWIDTH, (MAXROWS - height) / 2, col);
+                if (!addClip(clips, node))
+                {
+                    break;
+                }
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            BannerStats after = getBannerStats();
+
+            long long lookups = after.lookups - before.lookups;
+            clearLine(MAXROWS + 1, CLEARCOLS);
+            cout << frames << " frames added as clips in " << ms << " ms: " << (after.renderUs - before.renderUs) / max(frames, 1)
+                << " us to render each, " << (lookups > 0 ? 100.0 * (lookups - (after.misses - before.misses)) / lookups : 100)
+                << "% glyph cache hits";
+            clearLine(MAXROWS + 2, CLEARCOLS);
+            pauseScreen();
+        }
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
 }
 
 // Get a single point from screen, with character entered at that point
@@ -343,10 +1058,10 @@ char getPoint(Point& pt)
     // Move cursor to row,col and then get
     // a single character from the keyboard
     gotoxy(row, col);
-    input = _getch();
+    input = getKey();
     while (input != ESC) {
         if (input == SPECIAL) {
-            input = _getch();
+            input = getKey();
             switch (input) { // moves cursor around by arrow keys
             case LEFTARROW:
                 if (col > 0 && col <= MAXCOLS) {
@@ -375,14 +1090,14 @@ char getPoint(Point& pt)
             }
         }
         else if (input == '\0') // handles function keys
-            input = _getch(); // gets input again
+            input = getKey(); // gets input again
         else if (input != '\n' && input != '\t' && input != '\r' && input != '\b') { // handles whitespace keys
             cout << input;
             gotoxy(row, col);
             pt = { row, col }; // updates pointer to location user entered location at
             return input; // returns the character user entered
         }
-        input = _getch();
+        input = getKey();
     }
     return ESC;
 }
@@ -391,8 +1106,9 @@ char getPoint(Point& pt)
 void fillRecursive(char canvas[][MAXCOLS], int row, int col, char oldCh, char newCh, bool animate)
 {
     Point point(row, col);
+    profileCount(PROFFILLCELLS, 1);
     // base case ends if character is not what needs to be filled or out of bounds
-    if (canvas[row][col] != oldCh || row < 0 || row >= MAXROWS || col < 0 || col >= MAXCOLS)
+    if (row < 0 || row >= MAXROWS || col < 0 || col >= MAXCOLS || canvas[row][col] != oldCh)
         return;
     // recursive fills current position with newCh then runs again on cardinal directions from current index
     drawHelper(canvas, point, newCh, animate);
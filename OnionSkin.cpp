@@ -0,0 +1,248 @@
+#include <cstdio>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "Definitions.h"
+using namespace std;
+
+// Most clips shown either side of the canvas
+const int MAXONIONFRAMES = 9;
+
+// Where a cell on screen comes from
+enum OnionLayer
+{
+    ONIONCANVAS,    // the canvas itself
+    ONIONEARLIER,   // a clip before the canvas
+    ONIONLATER      // a clip after it
+};
+
+// Escape sequence starting each layer's cells: earlier clips dim red, later ones dim cyan
+static const char* LAYERSTYLES[3] = { "\x1b[0m", "\x1b[2;31m", "\x1b[2;36m" };
+
+static int onionFrames = 0;
+static int onionClip = 0;
+
+// The neighbouring clips composited, nearest on top, and which side each cell came from
+static char layer[MAXROWS][MAXCOLS];
+static char layerFrom[MAXROWS][MAXCOLS];
+
+// What each neighbouring clip held when the layer was built (see clipKey), 0
+// where there was none (earlier clips first, nearest first, then later ones),
+// and how many clips there were
+static bool layerValid = false;
+static unsigned long long builtKeys[2 * MAXONIONFRAMES];
+static int builtCount = 0;
+
+// What is on screen now, as last drawn by displayOnionSkin
+static char shown[MAXROWS][MAXCOLS];
+static char shownFrom[MAXROWS][MAXCOLS];
+
+static OnionStats stats = {};
+
+void setOnionSkin(int frames, int clip)
+{
+    onionFrames = max(0, min(frames, MAXONIONFRAMES));
+    onionClip = max(0, clip);
+    layerValid = false;
+}
+
+int onionSkinFrames()
+{
+    return onionFrames;
+}
+
+// Copies the cells of a clip that hold something onto the layer, marked as from
+static void addToLayer(char canvas[][MAXCOLS], OnionLayer from)
+{
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            if (canvas[row][col] != ' ')
+            {
+                layer[row][col] = canvas[row][col];
+                layerFrom[row][col] = (char)from;
+            }
+        }
+    }
+}
+
+void updateOnionSkin(List& clips)
+{
+    if (onionFrames == 0)
+    {
+        return;
+    }
+
+    // Clips are numbered oldest first, so the head is the last
+    builtCount = clips.count;
+    int at = onionClip == 0 || onionClip > clips.count ? clips.count + 1 : onionClip;
+    vector<Node*> earlier(onionFrames + 1, (Node*)NULL), later(onionFrames + 1, (Node*)NULL);
+    int number = clips.count;
+    for (Node* node = clips.head; node != NULL && at - number <= onionFrames; node = node->next, number--)
+    {
+        if (number < at)
+            earlier[at - number] = node;
+        else if (number > at && number - at <= onionFrames)
+            later[number - at] = node;
+    }
+
+    // Clips are changed in place too (by macros, patches and loading), so the
+    // layer is kept only while every neighbour still holds what it did
+    unsigned long long keys[2 * MAXONIONFRAMES] = {};
+    for (int distance = 1; distance <= onionFrames; distance++)
+    {
+        keys[distance - 1] = earlier[distance] != NULL ? clipKey(earlier[distance]) : 0;
+        keys[MAXONIONFRAMES + distance - 1] = later[distance] != NULL ? clipKey(later[distance]) : 0;
+    }
+    if (layerValid && memcmp(keys, builtKeys, sizeof(keys)) == 0)
+    {
+        return;
+    }
+
+    // Farthest first, so the nearest clips end up on top
+    memset(layer, ' ', sizeof(layer));
+    memset(layerFrom, ONIONCANVAS, sizeof(layerFrom));
+    for (int distance = onionFrames; distance >= 1; distance--)
+    {
+        if (later[distance] != NULL)
+            addToLayer(clipCanvas(later[distance]), ONIONLATER);
+        if (earlier[distance] != NULL)
+            addToLayer(clipCanvas(earlier[distance]), ONIONEARLIER);
+    }
+
+    stats.layerCells = 0;
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            if (layerFrom[row][col] != ONIONCANVAS)
+                stats.layerCells++;
+        }
+    }
+    stats.layerBuilds++;
+
+    layerValid = true;
+    memcpy(builtKeys, keys, sizeof(keys));
+}
+
+// Draws the cells whose composite differs from what is on screen, a run of
+// neighbouring cells at a time; returns the number of cells drawn
+static int drawChanged(char canvas[][MAXCOLS])
+{
+    string out;
+    int cells = 0;
+
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        int style = -1;
+        bool inRun = false;
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            // The canvas hides the clips under it
+            char ch = canvas[row][col];
+            char from = ONIONCANVAS;
+            if (ch == ' ' && layerValid)
+            {
+                ch = layer[row][col];
+                from = layerFrom[row][col];
+            }
+
+            if (ch == shown[row][col] && from == shownFrom[row][col])
+            {
+                inRun = false;
+                continue;
+            }
+            if (!inRun)
+            {
+                char move[16];
+                out.append(move, snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, col + 1));
+                inRun = true;
+            }
+            if (from != style)
+            {
+                out += LAYERSTYLES[(int)from];
+                style = from;
+            }
+            out += ch;
+            shown[row][col] = ch;
+            shownFrom[row][col] = from;
+            cells++;
+        }
+        if (style > ONIONCANVAS)
+        {
+            out += LAYERSTYLES[ONIONCANVAS];
+        }
+    }
+
+    cout.write(out.data(), out.size());
+    return cells;
+}
+
+void displayOnionSkin(char canvas[][MAXCOLS], bool incremental)
+{
+    if (onionFrames == 0)
+    {
+        displayCanvas(canvas);
+        return;
+    }
+
+    if (!incremental)
+    {
+        // The plain canvas first, then the clips showing through it
+        displayCanvas(canvas);
+        memcpy(shown, canvas, sizeof(shown));
+        memset(shownFrom, ONIONCANVAS, sizeof(shownFrom));
+        drawChanged(canvas);
+        stats.fullFrames++;
+        return;
+    }
+
+    ProfileScope scope(PROFDISPLAY);
+    countFrame();
+    stats.cellsWritten += drawChanged(canvas);
+    stats.incrementalFrames++;
+}
+
+OnionStats getOnionStats()
+{
+    OnionStats current = stats;
+    current.frames = onionFrames;
+    current.clip = onionClip == 0 || onionClip > builtCount ? builtCount + 1 : onionClip;
+    return current;
+}
+
+void onionMenu(List& clips)
+{
+    int count = 0, number = 0;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the number of clips to show either side (0 for none, at most " << MAXONIONFRAMES << "): ";
+    cin >> count;
+    bool valid = cin && count >= 0;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    if (valid && count > 0)
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the clip this canvas is (1 to " << clips.count << ", 0 for a new one after the last): ";
+        cin >> number;
+        valid = cin && number >= 0 && number <= clips.count;
+        cin.clear();
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    }
+
+    if (valid)
+    {
+        setOnionSkin(count, number);
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
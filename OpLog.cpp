@@ -0,0 +1,318 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "Definitions.h"
+using namespace std;
+
+/*
+* Operation log layout (integers are little-endian)
+*   header: "TXAL", u32 version, u64 hash of the checkpointed canvas the log applies to
+*   groups: u32 payload length, u32 payload checksum, payload of encoded operations
+* Each group is written and synced in one go (a group commit). A group torn by a
+* crash fails its checksum, and replay stops there.
+*/
+const char OPLOGMAGIC[] = "TXAL";
+const unsigned OPLOGVERSION = 1;
+const int OPLOGHEADERSIZE = 16;
+const int GROUPHEADERSIZE = 8;
+
+// A group is committed once this many operations are waiting, or after COMMITINTERVAL ms
+const int GROUPOPS = 64;
+const int COMMITINTERVAL = 100;
+
+// The log file; only touched while holding fileMutex
+static FILE* logFile = NULL;
+static mutex fileMutex;
+static unsigned long long logBase = 0;
+static bool logEmpty = true;
+
+// Operations waiting for the next group commit; guarded by logMutex
+static mutex logMutex;
+static condition_variable logWake;
+static vector<unsigned char> pending;
+static int pendingOps = 0;
+static bool stopping = false;
+static thread committer;
+
+// Counters; guarded by logMutex
+static OpLogStats stats = {};
+static double totalAppendUs = 0;
+static double totalCommitMs = 0;
+
+static void put32(unsigned char* p, unsigned value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+static unsigned get32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+static unsigned checksum(const unsigned char data[], int length)
+{
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool syncFile(FILE* file)
+{
+    if (fflush(file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Reads the operations a previous run left in the log, if they apply on top of
+// a checkpoint whose canvas hashes to baseHash
+static vector<unsigned char> readLeftovers(unsigned long long baseHash)
+{
+    vector<unsigned char> ops;
+    unsigned char header[OPLOGHEADERSIZE];
+    FILE* file = fopen(OPLOGFILE, "rb");
+
+    if (file == NULL)
+    {
+        return ops;
+    }
+
+    unsigned long long hash = 0;
+    if (fread(header, 1, OPLOGHEADERSIZE, file) == OPLOGHEADERSIZE && memcmp(header, OPLOGMAGIC, 4) == 0
+        && get32(&header[4]) == OPLOGVERSION)
+    {
+        hash = get32(&header[8]) | ((unsigned long long)get32(&header[12]) << 32);
+    }
+
+    // Read whole groups until the end, or a torn or corrupt group
+    unsigned char groupHeader[GROUPHEADERSIZE];
+    while (hash == baseHash && fread(groupHeader, 1, GROUPHEADERSIZE, file) == GROUPHEADERSIZE)
+    {
+        unsigned length = get32(groupHeader);
+        if (length == 0 || length > 1024 * 1024)
+        {
+            break;
+        }
+
+        size_t start = ops.size();
+        ops.resize(start + length);
+        if (fread(&ops[start], 1, length, file) != length || checksum(&ops[start], length) != get32(&groupHeader[4]))
+        {
+            ops.resize(start);
+            break;
+        }
+    }
+
+    fclose(file);
+    return ops;
+}
+
+// Writes every buffered operation as one group and syncs it
+void commitOpLog()
+{
+    lock_guard<mutex> fileLock(fileMutex);
+    vector<unsigned char> group;
+
+    {
+        lock_guard<mutex> lock(logMutex);
+        group.swap(pending);
+        pendingOps = 0;
+    }
+    if (group.empty() || logFile == NULL)
+    {
+        return;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    unsigned char groupHeader[GROUPHEADERSIZE];
+    put32(groupHeader, (unsigned)group.size());
+    put32(&groupHeader[4], checksum(group.data(), (int)group.size()));
+
+    fwrite(groupHeader, 1, GROUPHEADERSIZE, logFile);
+    fwrite(group.data(), 1, group.size(), logFile);
+    syncFile(logFile);
+    logEmpty = false;
+
+    lock_guard<mutex> lock(logMutex);
+    stats.commits++;
+    stats.bytesLogged += GROUPHEADERSIZE + group.size();
+    totalCommitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.commitMs = totalCommitMs / stats.commits;
+}
+
+// Background thread: commits a group whenever enough operations are waiting,
+// or every COMMITINTERVAL ms while any are, so editing never waits on a sync
+static void commitLoop()
+{
+    unique_lock<mutex> lock(logMutex);
+    while (!stopping)
+    {
+        logWake.wait_for(lock, chrono::milliseconds(COMMITINTERVAL));
+        if (!pending.empty())
+        {
+            lock.unlock();
+            commitOpLog();
+            lock.lock();
+        }
+    }
+}
+
+void openOpLog(Node*& current, List& undoList, List& redoList, List& clips)
+{
+    if (!getSessionStats().active)
+    {
+        return;
+    }
+
+    // Redo whatever was done after the last checkpoint (if the program crashed)
+    vector<unsigned char> ops = readLeftovers(hashCanvas(current->item));
+    int position = 0, length;
+    Operation op;
+
+    while ((length = decodeOperation(ops.data() + position, (int)ops.size() - position, op)) > 0)
+    {
+        if (op.type == OPUNDO)
+        {
+            addUndoState(undoList, redoList, current);
+        }
+        else
+        {
+            applyOperation(current->item, op, false);
+        }
+        position += length;
+        stats.recoveredOps++;
+    }
+
+    // The checkpoint holds the replayed edits and starts a fresh log
+    checkpointSession(current, undoList, redoList, clips);
+
+    stopping = false;
+    committer = thread(commitLoop);
+}
+
+void logOperation(Operation op)
+{
+    if (logFile == NULL)
+    {
+        return;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    unsigned char encoded[MAXOPSIZE];
+    int length = encodeOperation(op, encoded);
+
+    lock_guard<mutex> lock(logMutex);
+    pending.insert(pending.end(), encoded, encoded + length);
+    pendingOps++;
+    if (pendingOps >= GROUPOPS)
+    {
+        logWake.notify_one();
+    }
+
+    stats.opsLogged++;
+    if (op.type == OPCELL)
+    {
+        stats.cellOps++;
+    }
+    stats.payloadBytes += length;
+
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    totalAppendUs += us;
+    stats.appendUs = totalAppendUs / stats.opsLogged;
+    if (us > stats.maxAppendUs)
+    {
+        stats.maxAppendUs = us;
+    }
+}
+
+void resetOpLog(unsigned long long baseHash)
+{
+    lock_guard<mutex> fileLock(fileMutex);
+
+    // Anything still buffered is covered by the checkpoint
+    {
+        lock_guard<mutex> lock(logMutex);
+        pending.clear();
+        pendingOps = 0;
+    }
+
+    if (logFile != NULL && logEmpty && logBase == baseHash)
+    {
+        return;
+    }
+
+    if (logFile != NULL)
+    {
+        fclose(logFile);
+    }
+    logFile = fopen(OPLOGFILE, "w+b");
+    if (logFile == NULL)
+    {
+        return;
+    }
+
+    unsigned char header[OPLOGHEADERSIZE];
+    memcpy(header, OPLOGMAGIC, 4);
+    put32(&header[4], OPLOGVERSION);
+    put32(&header[8], (unsigned)baseHash);
+    put32(&header[12], (unsigned)(baseHash >> 32));
+    fwrite(header, 1, OPLOGHEADERSIZE, logFile);
+    syncFile(logFile);
+
+    logBase = baseHash;
+    logEmpty = true;
+    stats.active = true;
+}
+
+void closeOpLog()
+{
+    if (committer.joinable())
+    {
+        {
+            lock_guard<mutex> lock(logMutex);
+            stopping = true;
+        }
+        logWake.notify_one();
+        committer.join();
+    }
+
+    lock_guard<mutex> fileLock(fileMutex);
+    if (logFile != NULL)
+    {
+        // After a clean exit the session holds everything, so the log isn't needed
+        bool clean = logEmpty && pending.empty();
+        fclose(logFile);
+        logFile = NULL;
+        if (clean)
+        {
+            remove(OPLOGFILE);
+        }
+    }
+    stats.active = false;
+}
+
+OpLogStats getOpLogStats()
+{
+    lock_guard<mutex> lock(logMutex);
+    return stats;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include "Definitions.h"
+using namespace std;
+
+static void put16(unsigned char* p, int value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+static int get16(const unsigned char* p)
+{
+    return (short)(p[0] | (p[1] << 8));
+}
+
+Operation newOperation(OpType type)
+{
+    Operation op;
+    op.type = type;
+    op.start = Point(0, 0);
+    op.end = Point(0, 0);
+    op.size = 0;
+    op.angle = 0;
+    op.ch = ' ';
+    op.newCh = ' ';
+    return op;
+}
+
+void applyOperation(char canvas[][MAXCOLS], Operation op, bool animate)
+{
+    ProfileScope scope(PROFOPERATION, op.type);
+
+    switch (op.type)
+    {
+    case OPUNDO:
+    case OPCLIP:
+        break;
+    case OPCELL:
+        if (op.start.row >= 0 && op.start.row < MAXROWS && op.start.col >= 0 && op.start.col < MAXCOLS)
+        {
+            noteCellWrite(canvas, op.start.row, op.start.col, op.ch);
+            canvas[op.start.row][op.start.col] = op.ch;
+        }
+        break;
+    case OPFILL:
+        // Filling with the character already there would never finish
+        if (op.start.row >= 0 && op.start.row < MAXROWS && op.start.col >= 0 && op.start.col < MAXCOLS
+            && canvas[op.start.row][op.start.col] != op.ch)
+        {
+            // Animated fills are drawn cell by cell; otherwise fill 64 cells at a time
+            if (animate || !fillPlanes(canvas, op.start.row, op.start.col, op.ch))
+            {
+                fillRecursive(canvas, op.start.row, op.start.col, canvas[op.start.row][op.start.col], op.ch, animate);
+            }
+        }
+        break;
+    case OPLINE:
+        drawLine(canvas, op.start, op.end, animate);
+        break;
+    case OPBOX:
+        drawBox(canvas, op.start, op.size, animate);
+        break;
+    case OPBOXES:
+        drawBoxesRecursive(canvas, op.start, op.size, animate);
+        break;
+    case OPTREE:
+        treeRecursive(canvas, op.start, op.size, 270, op.angle, animate);
+        break;
+    case OPREPLACE:
+        replace(canvas, op.ch, op.newCh);
+        break;
+    case OPMOVE:
+        moveCanvas(canvas, op.end.row, op.end.col);
+        break;
+    case OPCLEAR:
+        initCanvas(canvas);
+        break;
+    case OPTRANSFORM:
+        applyTransform(canvas, op);
+        break;
+    }
+}
+
+void performOperation(char canvas[][MAXCOLS], Operation op, bool animate)
+{
+    // Log first, so an operation interrupted part way can be redone
+    logOperation(op);
+    recordOperation(op);
+    applyOperation(canvas, op, animate);
+}
+
+int encodeOperation(Operation op, unsigned char out[])
+{
+    int length = 0;
+    out[length++] = (unsigned char)op.type;
+
+    switch (op.type)
+    {
+    case OPCELL:
+    case OPFILL:
+        // Always a point inside the canvas, so a byte per coordinate will do
+        out[length++] = (unsigned char)op.start.row;
+        out[length++] = (unsigned char)op.start.col;
+        out[length++] = (unsigned char)op.ch;
+        break;
+    case OPLINE:
+        put16(&out[1], op.start.row);
+        put16(&out[3], op.start.col);
+        put16(&out[5], op.end.row);
+        put16(&out[7], op.end.col);
+        length += 8;
+        break;
+    case OPBOX:
+    case OPBOXES:
+        put16(&out[1], op.start.row);
+        put16(&out[3], op.start.col);
+        put16(&out[5], op.size);
+        length += 6;
+        break;
+    case OPTREE:
+        put16(&out[1], op.start.row);
+        put16(&out[3], op.start.col);
+        put16(&out[5], op.size);
+        put16(&out[7], op.angle);
+        length += 8;
+        break;
+    case OPREPLACE:
+        out[length++] = (unsigned char)op.ch;
+        out[length++] = (unsigned char)op.newCh;
+        break;
+    case OPMOVE:
+        put16(&out[1], op.end.row);
+        put16(&out[3], op.end.col);
+        length += 4;
+        break;
+    case OPTRANSFORM:
+        // The rectangle lies inside the canvas, so a byte per coordinate will do
+        out[length++] = (unsigned char)op.angle;
+        out[length++] = (unsigned char)op.start.row;
+        out[length++] = (unsigned char)op.start.col;
+        out[length++] = (unsigned char)op.end.row;
+        out[length++] = (unsigned char)op.end.col;
+        out[length++] = (unsigned char)op.size;
+        break;
+    case OPUNDO:
+    case OPCLEAR:
+    case OPCLIP:
+        break;
+    }
+    return length;
+}
+
+int decodeOperation(const unsigned char data[], int length, Operation& op)
+{
+    // Encoded size of each operation type, in OpType order
+    const int SIZES[] = { 1, 4, 4, 9, 7, 7, 9, 3, 5, 1, 1, 7 };
+
+    if (length < 1 || data[0] > OPTRANSFORM || length < SIZES[data[0]])
+    {
+        return 0;
+    }
+
+    op = newOperation((OpType)data[0]);
+    switch (op.type)
+    {
+    case OPCELL:
+    case OPFILL:
+        op.start = Point(data[1], data[2]);
+        op.ch = (char)data[3];
+        break;
+    case OPLINE:
+        op.start = Point(get16(&data[1]), get16(&data[3]));
+        op.end = Point(get16(&data[5]), get16(&data[7]));
+        break;
+    case OPBOX:
+    case OPBOXES:
+        op.start = Point(get16(&data[1]), get16(&data[3]));
+        op.size = get16(&data[5]);
+        break;
+    case OPTREE:
+        op.start = Point(get16(&data[1]), get16(&data[3]));
+        op.size = get16(&data[5]);
+        op.angle = get16(&data[7]);
+        break;
+    case OPREPLACE:
+        op.ch = (char)data[1];
+        op.newCh = (char)data[2];
+        break;
+    case OPMOVE:
+        op.end = Point(get16(&data[1]), get16(&data[3]));
+        break;
+    case OPTRANSFORM:
+        op.angle = data[1];
+        op.start = Point(data[2], data[3]);
+        op.end = Point(data[4], data[5]);
+        op.size = data[6];
+        break;
+    case OPUNDO:
+    case OPCLEAR:
+    case OPCLIP:
+        break;
+    }
+    return SIZES[op.type];
+}
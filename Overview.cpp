@@ -0,0 +1,273 @@
+#include <cstdio>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Definitions.h"
+using namespace std;
+
+// The clips and the current canvas laid out as tiles, and what each tile held
+// when it was last written into the pyramid (see clipKey)
+static Pyramid world = {};
+static int across = 0;
+static vector<unsigned long long> tileKeys;
+
+Pyramid newPyramid(int rows, int cols)
+{
+    Pyramid pyramid = {};
+    for (;;)
+    {
+        int level = pyramid.levels++;
+        pyramid.rows[level] = rows;
+        pyramid.cols[level] = cols;
+        pyramid.glyphs[level] = new char[(size_t)rows * cols];
+        pyramid.weights[level] = new int[(size_t)rows * cols];
+        memset(pyramid.glyphs[level], ' ', (size_t)rows * cols);
+        memset(pyramid.weights[level], 0, (size_t)rows * cols * sizeof(int));
+
+        if ((rows <= MAXROWS && cols <= MAXCOLS) || pyramid.levels == MAXPYRAMIDLEVELS)
+        {
+            return pyramid;
+        }
+        rows = (rows + 1) / 2;
+        cols = (cols + 1) / 2;
+    }
+}
+
+void deletePyramid(Pyramid& pyramid)
+{
+    for (int level = 0; level < pyramid.levels; level++)
+    {
+        delete[] pyramid.glyphs[level];
+        delete[] pyramid.weights[level];
+    }
+    pyramid.levels = 0;
+}
+
+// Works out cell row, col of level (above 0) from the cells under it
+// Returns FALSE if it didn't change
+static bool combineCell(Pyramid& pyramid, int level, int row, int col)
+{
+    int below = level - 1, belowRows = pyramid.rows[below], belowCols = pyramid.cols[below];
+    char glyphs[4];
+    int weights[4], count = 0;
+
+    // The glyphs under the cell, each weighted by every cell it stands for
+    for (int r = row * 2; r < min(row * 2 + 2, belowRows); r++)
+    {
+        for (int c = col * 2; c < min(col * 2 + 2, belowCols); c++)
+        {
+            size_t at = (size_t)r * belowCols + c;
+            char ch = pyramid.glyphs[below][at];
+            if (ch == ' ')
+            {
+                continue;
+            }
+            int i = 0;
+            while (i < count && glyphs[i] != ch)
+            {
+                i++;
+            }
+            if (i == count)
+            {
+                glyphs[count] = ch;
+                weights[count++] = 0;
+            }
+            weights[i] += pyramid.weights[below][at];
+        }
+    }
+
+    // The heaviest wins, the first found on a tie
+    char best = ' ';
+    int bestWeight = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (weights[i] > bestWeight)
+        {
+            best = glyphs[i];
+            bestWeight = weights[i];
+        }
+    }
+
+    size_t at = (size_t)row * pyramid.cols[level] + col;
+    if (pyramid.glyphs[level][at] == best && pyramid.weights[level][at] == bestWeight)
+    {
+        return false;
+    }
+    pyramid.glyphs[level][at] = best;
+    pyramid.weights[level][at] = bestWeight;
+    return true;
+}
+
+bool setPyramidCell(Pyramid& pyramid, int row, int col, char ch)
+{
+    size_t at = (size_t)row * pyramid.cols[0] + col;
+    if (pyramid.glyphs[0][at] == ch)
+    {
+        return false;
+    }
+    pyramid.glyphs[0][at] = ch;
+    pyramid.weights[0][at] = ch != ' ' ? 1 : 0;
+
+    for (int level = 1; level < pyramid.levels; level++)
+    {
+        row /= 2;
+        col /= 2;
+        if (!combineCell(pyramid, level, row, col))
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+void viewPyramid(const Pyramid& pyramid, int level, int top, int left, char canvas[][MAXCOLS])
+{
+    int rows = pyramid.rows[level], cols = pyramid.cols[level];
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        memset(canvas[row], ' ', MAXCOLS);
+        int from = max(0, -left), to = min(MAXCOLS, cols - left);
+        if (top + row >= 0 && top + row < rows && from < to)
+        {
+            memcpy(&canvas[row][from], &pyramid.glyphs[level][(size_t)(top + row) * cols + left + from], to - from);
+        }
+    }
+    canvasChanged(canvas);
+}
+
+// Brings the tiles up to date with the clips and current canvas, laying them
+// out afresh if there are more than fit; adds the cells written to cells
+// Returns the number of tiles written
+static int updateWorld(Node* current, List& clips, long long& cells)
+{
+    static ListItemType blank;
+    static unsigned long long blankKey = 0;
+    int tiles = clips.count + 1;
+
+    // Tiles are laid out in a square, so the whole of it is about the shape of the screen
+    if (world.levels == 0 || tiles > across * across)
+    {
+        deletePyramid(world);
+        across = 1;
+        while (across * across < tiles)
+        {
+            across *= 2;
+        }
+        world = newPyramid(across * (MAXROWS + 1) - 1, across * (MAXCOLS + 1) - 1);
+        memset(blank, ' ', sizeof(blank));
+        blankKey = hashCanvas(blank);
+        tileKeys.assign(across * across, blankKey);
+    }
+
+    vector<Node*> nodes(clips.count);
+    clipNodes(clips, nodes.data());
+
+    // Tiles past the current canvas are blanked, in case there were more clips before
+    int written = 0;
+    for (int i = 0; i < across * across; i++)
+    {
+        unsigned long long key = i < clips.count ? clipKey(nodes[i]) : i == clips.count ? hashCanvas(current->item) : blankKey;
+        if (key == tileKeys[i])
+        {
+            continue;
+        }
+
+        CanvasRow* canvas = i < clips.count ? clipCanvas(nodes[i]) : i == clips.count ? current->item : blank;
+        int top = i / across * (MAXROWS + 1), left = i % across * (MAXCOLS + 1);
+        for (int row = 0; row < MAXROWS; row++)
+        {
+            for (int col = 0; col < MAXCOLS; col++)
+            {
+                if (setPyramidCell(world, top + row, left + col, canvas[row][col]))
+                {
+                    cells++;
+                }
+            }
+        }
+        tileKeys[i] = key;
+        written++;
+    }
+    return written;
+}
+
+void overviewMenu(Node* current, List& clips)
+{
+    static ListItemType view;
+    long long cells = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int tiles = updateWorld(current, clips, cells);
+    double updateMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // Start zoomed out as far as it goes, which fits on the screen
+    int level = world.levels - 1, top = 0, left = 0;
+    char input;
+
+    for (;;)
+    {
+        // Constant time whatever the level: one screen of cells is copied
+        start = chrono::steady_clock::now();
+        viewPyramid(world, level, top, left, view);
+        displayCanvas(view);
+        double viewUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        int rows = world.rows[level], cols = world.cols[level];
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "1/" << (1 << level) << " size: rows " << top + 1 << "-" << min(top + MAXROWS, rows) << " of " << rows
+            << ", columns " << left + 1 << "-" << min(left + MAXCOLS, cols) << " of " << cols << " (" << viewUs << " us) / "
+            << tiles << " of " << clips.count + 1 << " tiles updated, " << cells << " cells (" << updateMs << " ms)";
+        clearLine(MAXROWS + 2, CLEARCOLS);
+        cout << "<Arrows> to pan / <+> zoom in / <-> zoom out / any other key to return . . .";
+
+        input = getKey();
+        if (input == SPECIAL)
+        {
+            switch (getKey())
+            {
+            case LEFTARROW:
+                left -= MAXCOLS / 4;
+                break;
+            case RIGHTARROW:
+                left += MAXCOLS / 4;
+                break;
+            case UPARROW:
+                top -= MAXROWS / 4;
+                break;
+            case DOWNARROW:
+                top += MAXROWS / 4;
+                break;
+            }
+        }
+        else if ((input == '+' || input == '=') && level > 0)
+        {
+            // Keep the middle of the screen where it is
+            level--;
+            top = (top + MAXROWS / 2) * 2 - MAXROWS / 2;
+            left = (left + MAXCOLS / 2) * 2 - MAXCOLS / 2;
+        }
+        else if ((input == '-' || input == '_') && level < world.levels - 1)
+        {
+            level++;
+            top = (top + MAXROWS / 2) / 2 - MAXROWS / 2;
+            left = (left + MAXCOLS / 2) / 2 - MAXCOLS / 2;
+        }
+        else if (input == '\0')
+        {
+            // function keys come as '\0' followed by a code, which is ignored
+            (void)getKey();
+        }
+        else
+        {
+            break;
+        }
+
+        // Stay over the tiles
+        top = max(0, min(top, world.rows[level] - MAXROWS));
+        left = max(0, min(left, world.cols[level] - MAXCOLS));
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}
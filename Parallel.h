@@ -0,0 +1,33 @@
+#pragma once
+#include <thread>
+#include <vector>
+
+/*
+* Runs work(first, last) over items 0 .. count - 1, split into a band for each of
+* up to threads threads (never more than there are items); the first band is run
+* on this thread. work must only write what belongs to the items of its band.
+* Returns the number of threads used
+*/
+template <typename Work>
+int parallelFor(int count, int threads, Work work)
+{
+    if (threads > count)
+        threads = count;
+    if (threads <= 1)
+    {
+        work(0, count);
+        return 1;
+    }
+
+    std::vector<std::thread> bands;
+    for (int i = 1; i < threads; i++)
+    {
+        bands.push_back(std::thread(work, count * i / threads, count * (i + 1) / threads));
+    }
+    work(0, count / threads);
+    for (size_t i = 0; i < bands.size(); i++)
+    {
+        bands[i].join();
+    }
+    return threads;
+}
@@ -0,0 +1,256 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Definitions.h"
+using namespace std;
+
+// Multiplier of the rolling hash; arithmetic wraps at 2^64
+const unsigned long long HASHBASE = 1099511628211ULL;
+
+// Returns HASHBASE to the power width
+static unsigned long long hashPower(int width)
+{
+    unsigned long long power = 1;
+    for (int i = 0; i < width; i++)
+    {
+        power *= HASHBASE;
+    }
+    return power;
+}
+
+static unsigned long long hashCells(const char* cells, int width)
+{
+    unsigned long long hash = 0;
+    for (int i = 0; i < width; i++)
+    {
+        hash = hash * HASHBASE + (unsigned char)cells[i];
+    }
+    return hash;
+}
+
+// Returns TRUE if pattern matches text with its top left corner at row, col
+static bool matchesAt(const char* text, int cols, const char* pattern, int patRows, int patCols,
+    char wildcard, int row, int col)
+{
+    for (int r = 0; r < patRows; r++)
+    {
+        const char* line = &text[(row + r) * cols + col];
+        const char* want = &pattern[r * patCols];
+        for (int c = 0; c < patCols; c++)
+        {
+            if (want[c] != line[c] && want[c] != wildcard)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Stores a match if there's room and counts it
+static void addMatch(Point found[], int maxFound, int& count, int row, int col)
+{
+    if (found != NULL && count < maxFound)
+    {
+        found[count] = Point(row, col);
+    }
+    count++;
+}
+
+/*
+* Baker-Bird for a pattern without wildcards
+* Rows of the pattern are numbered, equal rows sharing a number; every window
+* of patCols cells in the text gets the number of the pattern row it equals
+* (or -1), found by a rolling hash and confirmed with memcmp. Reading down a
+* column, those numbers must spell out the pattern's rows, which KMP finds.
+*/
+static int bakerBird(const char* text, int rows, int cols, const char* pattern, int patRows, int patCols,
+    Point found[], int maxFound)
+{
+    int count = 0;
+
+    // Number the distinct pattern rows
+    vector<int> rowId(patRows);
+    vector<unsigned long long> idHash;
+    vector<int> idRow;
+    unsigned long long idFilter[64] = {};   // bit h >> 52 set for each row hash h
+    for (int r = 0; r < patRows; r++)
+    {
+        rowId[r] = -1;
+        for (size_t id = 0; id < idRow.size() && rowId[r] < 0; id++)
+        {
+            if (memcmp(&pattern[r * patCols], &pattern[idRow[id] * patCols], patCols) == 0)
+            {
+                rowId[r] = (int)id;
+            }
+        }
+        if (rowId[r] < 0)
+        {
+            rowId[r] = (int)idRow.size();
+            idRow.push_back(r);
+            idHash.push_back(hashCells(&pattern[r * patCols], patCols));
+            idFilter[idHash.back() >> 58] |= 1ULL << (idHash.back() >> 52 & 63);
+        }
+    }
+
+    // KMP failure function over the sequence of row numbers
+    vector<int> fail(patRows, 0);
+    for (int i = 1, k = 0; i < patRows; i++)
+    {
+        while (k > 0 && rowId[i] != rowId[k])
+            k = fail[k - 1];
+        if (rowId[i] == rowId[k])
+            k++;
+        fail[i] = k;
+    }
+
+    // Rows of the pattern matched so far, ending at the current text row, per column
+    int windows = cols - patCols + 1;
+    vector<int> state(windows, 0);
+    unsigned long long power = hashPower(patCols);
+
+    for (int row = 0; row < rows; row++)
+    {
+        const char* line = &text[row * cols];
+        unsigned long long hash = hashCells(line, patCols);
+
+        for (int col = 0; col < windows; col++)
+        {
+            if (col > 0)
+            {
+                hash = hash * HASHBASE - (unsigned char)line[col - 1] * power + (unsigned char)line[col + patCols - 1];
+            }
+
+            // Most windows equal no pattern row and are turned away by the filter
+            int& k = state[col];
+            if ((idFilter[hash >> 58] >> (hash >> 52 & 63) & 1) == 0)
+            {
+                k = 0;
+                continue;
+            }
+
+            int id = -1;
+            for (size_t i = 0; i < idHash.size(); i++)
+            {
+                if (idHash[i] == hash && memcmp(&line[col], &pattern[idRow[i] * patCols], patCols) == 0)
+                {
+                    id = (int)i;
+                    break;
+                }
+            }
+
+            while (k > 0 && rowId[k] != id)
+                k = fail[k - 1];
+            if (rowId[k] == id)
+                k++;
+            if (k == patRows)
+            {
+                addMatch(found, maxFound, count, row - patRows + 1, col);
+                k = fail[k - 1];
+            }
+        }
+    }
+
+    // Matches end on increasing rows, so they come out in order already
+    return count;
+}
+
+int findPattern(const char* text, int rows, int cols, const char* pattern, int patRows, int patCols,
+    char wildcard, Point found[], int maxFound)
+{
+    if (patRows <= 0 || patCols <= 0 || patRows > rows || patCols > cols)
+    {
+        return 0;
+    }
+
+    if (wildcard == '\0' || memchr(pattern, wildcard, patRows * patCols) == NULL)
+    {
+        return bakerBird(text, rows, cols, pattern, patRows, patCols, found, maxFound);
+    }
+
+    // A run of fixed cells in one pattern row anchors the search: the one with
+    // the most different characters, since blank space matches nearly
+    // everywhere, then the longest
+    int anchorRow = 0, anchorCol = 0, anchorWidth = 0, anchorKinds = 0;
+    for (int r = 0; r < patRows; r++)
+    {
+        const char* line = &pattern[r * patCols];
+        for (int c = 0, run = 0, kinds = 0; c < patCols; c++)
+        {
+            if (line[c] == wildcard)
+            {
+                run = kinds = 0;
+                continue;
+            }
+            run++;
+            if (memchr(&line[c - run + 1], line[c], run - 1) == NULL)
+            {
+                kinds++;
+            }
+            if (kinds > anchorKinds || (kinds == anchorKinds && run > anchorWidth))
+            {
+                anchorRow = r;
+                anchorCol = c - run + 1;
+                anchorWidth = run;
+                anchorKinds = kinds;
+            }
+        }
+    }
+
+    int count = 0;
+
+    // Nothing but wildcards: matches everywhere
+    if (anchorWidth == 0)
+    {
+        for (int row = 0; row + patRows <= rows; row++)
+        {
+            for (int col = 0; col + patCols <= cols; col++)
+            {
+                addMatch(found, maxFound, count, row, col);
+            }
+        }
+        return count;
+    }
+
+    // Find the anchor with a rolling hash, then check the rest of the pattern
+    unsigned long long want = hashCells(&pattern[anchorRow * patCols + anchorCol], anchorWidth);
+    unsigned long long power = hashPower(anchorWidth);
+    int lastCol = cols - patCols + anchorCol;
+
+    for (int row = anchorRow; row <= rows - patRows + anchorRow; row++)
+    {
+        const char* line = &text[row * cols];
+        unsigned long long hash = hashCells(&line[anchorCol], anchorWidth);
+
+        for (int col = anchorCol; col <= lastCol; col++)
+        {
+            if (col > anchorCol)
+            {
+                hash = hash * HASHBASE - (unsigned char)line[col - 1] * power + (unsigned char)line[col + anchorWidth - 1];
+            }
+            if (hash == want && matchesAt(text, cols, pattern, patRows, patCols, wildcard, row - anchorRow, col - anchorCol))
+            {
+                addMatch(found, maxFound, count, row - anchorRow, col - anchorCol);
+            }
+        }
+    }
+    return count;
+}
+
+int findPatternNaive(const char* text, int rows, int cols, const char* pattern, int patRows, int patCols,
+    char wildcard, Point found[], int maxFound)
+{
+    int count = 0;
+
+    for (int row = 0; row + patRows <= rows; row++)
+    {
+        for (int col = 0; col + patCols <= cols; col++)
+        {
+            if (matchesAt(text, cols, pattern, patRows, patCols, wildcard, row, col))
+            {
+                addMatch(found, maxFound, count, row, col);
+            }
+        }
+    }
+    return count;
+}
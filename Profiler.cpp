@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <vector>
+#include "Definitions.h"
+using namespace std;
+
+// Most timed calls kept for the trace; older ones are overwritten
+const int MAXPROFILEEVENTS = 16384;
+
+// A timed call, with the work counted while it ran
+struct ProfileEvent
+{
+    ProfileTimer timer;
+    int detail;
+    long long startNs;          // since the profiler was turned on
+    long long durationNs;
+    long long counts[PROFCOUNTERS];
+};
+
+static const char* TIMERNAMES[PROFTIMERS] = { "display", "operation", "undo", "loadClips" };
+static const char* LINENAMES[PROFTIMERS] = { "display", "op", "undo", "load" };
+static const char* COUNTERNAMES[PROFCOUNTERS] = { "draws", "fillCells", "undoBytes", "fileOpens" };
+static const char* OPNAMES[] = { "undo", "cell", "fill", "line", "box", "boxes", "tree", "replace", "move", "clear", "clip", "transform" };
+
+static bool enabled = false;
+static chrono::steady_clock::time_point started;
+static ProfileStats stats = {};
+static vector<ProfileEvent> events;
+static int nextEvent = 0;
+
+// What the profile line showed last, so it can show what happened since
+static ProfileStats shown = {};
+
+static long long nowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+}
+
+ProfileScope::ProfileScope(ProfileTimer timer, int detail)
+{
+    this->timer = timer;
+    this->detail = detail;
+    startNs = -1;
+    if (enabled)
+    {
+        memcpy(startCounts, stats.counts, sizeof(startCounts));
+        startNs = nowNs();
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    // Turned on or off while the scope ran: nothing sensible to record
+    if (startNs < 0 || !enabled)
+    {
+        return;
+    }
+
+    long long durationNs = nowNs() - startNs;
+    double ms = durationNs / 1e6;
+    stats.calls[timer]++;
+    stats.totalMs[timer] += ms;
+    if (ms > stats.maxMs[timer])
+    {
+        stats.maxMs[timer] = ms;
+    }
+
+    ProfileEvent& event = events[nextEvent];
+    event.timer = timer;
+    event.detail = detail;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    for (int i = 0; i < PROFCOUNTERS; i++)
+    {
+        event.counts[i] = stats.counts[i] - startCounts[i];
+    }
+    nextEvent = (nextEvent + 1) % MAXPROFILEEVENTS;
+    if (stats.events < MAXPROFILEEVENTS)
+        stats.events++;
+    else
+        stats.droppedEvents++;
+}
+
+void profileCount(ProfileCounter counter, long long amount)
+{
+    if (enabled)
+    {
+        stats.counts[counter] += amount;
+    }
+}
+
+void enableProfiler(bool enable)
+{
+    if (enable && !enabled)
+    {
+        stats = ProfileStats();
+        shown = ProfileStats();
+        events.resize(MAXPROFILEEVENTS);
+        nextEvent = 0;
+        started = chrono::steady_clock::now();
+    }
+    enabled = enable;
+    stats.enabled = enable;
+}
+
+bool profilerEnabled()
+{
+    return enabled;
+}
+
+void displayProfileLine()
+{
+    clearLine(MAXROWS + 3, CLEARCOLS);
+    if (!enabled)
+    {
+        return;
+    }
+
+    // Time per timer and work counted since the line was last shown
+    char part[64];
+    cout << "Profile:";
+    for (int i = 0; i < PROFTIMERS; i++)
+    {
+        int calls = stats.calls[i] - shown.calls[i];
+        if (calls > 0)
+        {
+            snprintf(part, sizeof(part), " %s %.2f ms%s /", LINENAMES[i], stats.totalMs[i] - shown.totalMs[i],
+                calls > 1 ? (" (" + to_string(calls) + "x)").c_str() : "");
+            cout << part;
+        }
+    }
+    cout << " " << stats.counts[PROFDRAWS] - shown.counts[PROFDRAWS] << " draws / "
+        << stats.counts[PROFFILLCELLS] - shown.counts[PROFFILLCELLS] << " fill cells / "
+        << stats.counts[PROFUNDOBYTES] - shown.counts[PROFUNDOBYTES] << " B copied / "
+        << stats.counts[PROFFILEOPENS] - shown.counts[PROFFILEOPENS] << " opens";
+    shown = stats;
+}
+
+// Name of a timed call in the trace: operations are named by their type
+static const char* eventName(const ProfileEvent& event)
+{
+    if (event.timer == PROFOPERATION && event.detail >= 0 && event.detail < (int)(sizeof(OPNAMES) / sizeof(OPNAMES[0])))
+    {
+        return OPNAMES[event.detail];
+    }
+    return TIMERNAMES[event.timer];
+}
+
+bool writeProfileTrace()
+{
+    ofstream json(PROFILEJSON);
+    ofstream csv(PROFILECSV);
+    if (!json || !csv)
+    {
+        return false;
+    }
+
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    csv << "name,category,start_us,duration_us";
+    for (int i = 0; i < PROFCOUNTERS; i++)
+    {
+        csv << "," << COUNTERNAMES[i];
+    }
+    csv << "\n";
+
+    // Oldest first; once the buffer has wrapped the oldest is the next to be overwritten
+    char start[32], duration[32];
+    int first = stats.events < MAXPROFILEEVENTS ? 0 : nextEvent;
+    for (int n = 0; n < stats.events; n++)
+    {
+        const ProfileEvent& event = events[(first + n) % MAXPROFILEEVENTS];
+        snprintf(start, sizeof(start), "%.3f", event.startNs / 1e3);
+        snprintf(duration, sizeof(duration), "%.3f", event.durationNs / 1e3);
+        json << "{\"name\":\"" << eventName(event) << "\",\"cat\":\"" << TIMERNAMES[event.timer]
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << start << ",\"dur\":" << duration
+            << ",\"args\":{";
+        csv << eventName(event) << "," << TIMERNAMES[event.timer] << "," << start << "," << duration;
+        for (int i = 0; i < PROFCOUNTERS; i++)
+        {
+            json << (i > 0 ? "," : "") << "\"" << COUNTERNAMES[i] << "\":" << event.counts[i];
+            csv << "," << event.counts[i];
+        }
+        json << "}},\n";
+        csv << "\n";
+    }
+
+    // Totals as one counter sample at the end of the trace
+    snprintf(start, sizeof(start), "%.3f", enabled || stats.events > 0 ? nowNs() / 1e3 : 0.0);
+    json << "{\"name\":\"totals\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << start << ",\"args\":{";
+    csv << "totals,,,";
+    for (int i = 0; i < PROFCOUNTERS; i++)
+    {
+        json << (i > 0 ? "," : "") << "\"" << COUNTERNAMES[i] << "\":" << stats.counts[i];
+        csv << "," << stats.counts[i];
+    }
+    json << "}}\n]}\n";
+    csv << "\n";
+
+    return (bool)json && (bool)csv;
+}
+
+ProfileStats getProfileStats()
+{
+    return stats;
+}
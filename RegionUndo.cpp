@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "Definitions.h"
+using namespace std;
+
+// Operations changing more than this share of the canvas keep a whole canvas
+// instead, which the canvas store can share with identical states
+const double REGIONSHARE = 0.5;
+
+// Widens bounds to take in row, col
+static void include(CellRect& bounds, int row, int col)
+{
+    bounds.top = min(bounds.top, row);
+    bounds.left = min(bounds.left, col);
+    bounds.bottom = max(bounds.bottom, row);
+    bounds.right = max(bounds.right, col);
+}
+
+// The rectangle a fill from row, col would cover, found without writing to canvas
+static void fillBounds(char canvas[][MAXCOLS], int row, int col, CellRect& bounds)
+{
+    static bool seen[MAXROWS][MAXCOLS];
+    static Point pending[MAXROWS * MAXCOLS];
+    char oldCh = canvas[row][col];
+    int count = 0;
+
+    memset(seen, 0, sizeof(seen));
+    seen[row][col] = true;
+    pending[count++] = Point(row, col);
+
+    while (count > 0)
+    {
+        Point p = pending[--count];
+        include(bounds, p.row, p.col);
+
+        const int STEPS[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+        for (int i = 0; i < 4; i++)
+        {
+            int r = p.row + STEPS[i][0], c = p.col + STEPS[i][1];
+            if (r >= 0 && r < MAXROWS && c >= 0 && c < MAXCOLS && !seen[r][c] && canvas[r][c] == oldCh)
+            {
+                seen[r][c] = true;
+                pending[count++] = Point(r, c);
+            }
+        }
+    }
+}
+
+int rectCells(CellRect bounds)
+{
+    if (bounds.bottom < bounds.top || bounds.right < bounds.left)
+    {
+        return 0;
+    }
+    return (bounds.bottom - bounds.top + 1) * (bounds.right - bounds.left + 1);
+}
+
+bool operationBounds(char canvas[][MAXCOLS], Operation op, CellRect& bounds)
+{
+    // Starts empty; operations which change nothing leave it that way
+    bounds.top = MAXROWS;
+    bounds.left = MAXCOLS;
+    bounds.bottom = -1;
+    bounds.right = -1;
+
+    switch (op.type)
+    {
+    case OPUNDO:
+    case OPCLIP:
+        break;
+    case OPCELL:
+        include(bounds, op.start.row, op.start.col);
+        break;
+    case OPFILL:
+        if (op.start.row >= 0 && op.start.row < MAXROWS && op.start.col >= 0 && op.start.col < MAXCOLS
+            && canvas[op.start.row][op.start.col] != op.ch)
+        {
+            fillBounds(canvas, op.start.row, op.start.col, bounds);
+        }
+        break;
+    case OPLINE:
+    case OPBOX:
+    case OPBOXES:
+    case OPTREE:
+        // What gets drawn doesn't depend on the canvas, so draw it without writing
+        measureDrawing(&bounds);
+        if (op.type == OPLINE)
+            drawLine(canvas, op.start, op.end, false);
+        else if (op.type == OPBOX)
+            drawBox(canvas, op.start, op.size, false);
+        else if (op.type == OPBOXES)
+            drawBoxesRecursive(canvas, op.start, op.size, false);
+        else
+            treeRecursive(canvas, op.start, op.size, 270, op.angle, false);
+        measureDrawing(NULL);
+        break;
+    case OPREPLACE:
+    {
+        // Every cell holding the old character lies inside the content's rectangle,
+        // but spaces lie everywhere
+        const CanvasContent& content = canvasContent(canvas);
+        if (op.ch == ' ')
+        {
+            return false;
+        }
+        if (op.ch != op.newCh && content.counts[(unsigned char)op.ch] > 0)
+        {
+            include(bounds, content.top, content.left);
+            include(bounds, content.bottom, content.right);
+        }
+        break;
+    }
+    case OPTRANSFORM:
+    {
+        // The cells blanked and the cells written
+        CellRect from, to;
+        if (transformRects(canvas, op, from, to))
+        {
+            include(bounds, from.top, from.left);
+            include(bounds, from.bottom, from.right);
+            include(bounds, to.top, to.left);
+            include(bounds, to.bottom, to.right);
+        }
+        break;
+    }
+    case OPMOVE:
+    case OPCLEAR:
+        return false;
+    }
+
+    // Clip to the canvas
+    bounds.top = max(bounds.top, 0);
+    bounds.left = max(bounds.left, 0);
+    bounds.bottom = min(bounds.bottom, MAXROWS - 1);
+    bounds.right = min(bounds.right, MAXCOLS - 1);
+
+    return rectCells(bounds) <= REGIONSHARE * MAXROWS * MAXCOLS;
+}
+
+Node* newPatch(char canvas[][MAXCOLS], CellRect bounds)
+{
+    CanvasPatch* patch = new CanvasPatch;
+    patch->bounds.top = max(bounds.top, 0);
+    patch->bounds.left = max(bounds.left, 0);
+    patch->bounds.bottom = min(bounds.bottom, MAXROWS - 1);
+    patch->bounds.right = min(bounds.right, MAXCOLS - 1);
+
+    // An empty rectangle is kept with no rows, so nothing is swapped
+    int cells = rectCells(patch->bounds);
+    int cols = patch->bounds.right - patch->bounds.left + 1;
+    if (cells == 0)
+    {
+        patch->bounds.bottom = patch->bounds.top - 1;
+    }
+    patch->cells = new char[cells + 1];
+    for (int row = patch->bounds.top; row <= patch->bounds.bottom; row++)
+    {
+        memcpy(&patch->cells[(row - patch->bounds.top) * cols], &canvas[row][patch->bounds.left], cols);
+    }
+    countAllocation(MEMPATCH, sizeof(CanvasPatch) + cells + 1);
+
+    // A state with no canvas of its own, like a tween frame
+    Node* node = new Node;
+    countAllocation(MEMNODE, sizeof(Node));
+    node->item = NULL;
+    node->blob = NULL;
+    node->next = NULL;
+    node->spillOffset = 0;
+    node->spillLength = 0;
+    node->sessionOffset = 0;
+    node->tween = NULL;
+    node->tweenFrame = 0;
+    node->patch = patch;
+    return node;
+}
+
+void swapPatch(Node* node, char canvas[][MAXCOLS])
+{
+    CanvasPatch* patch = node->patch;
+    int cols = patch->bounds.right - patch->bounds.left + 1;
+
+    for (int row = patch->bounds.top; row <= patch->bounds.bottom; row++)
+    {
+        char* cells = &patch->cells[(row - patch->bounds.top) * cols];
+        for (int col = patch->bounds.left; col <= patch->bounds.right; col++)
+        {
+            char ch = cells[col - patch->bounds.left];
+            cells[col - patch->bounds.left] = canvas[row][col];
+            noteCellWrite(canvas, row, col, ch);
+            canvas[row][col] = ch;
+        }
+    }
+}
+
+void releasePatch(Node* node)
+{
+    CanvasPatch* patch = node->patch;
+    if (patch == NULL)
+    {
+        return;
+    }
+
+    countAllocation(MEMPATCH, -(long long)(sizeof(CanvasPatch) + rectCells(patch->bounds) + 1));
+    delete[] patch->cells;
+    delete patch;
+    node->patch = NULL;
+}
@@ -0,0 +1,982 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "Definitions.h"
+using namespace std;
+
+/*
+* Session file layout (integers are little-endian)
+*   header:  "TXAS", u32 version, u16 rows, u16 cols
+*   records: u8 type, u32 payload length, payload, u32 payload checksum
+* A canvas record holds one PackBits-compressed canvas and is identified by its
+* file offset. A lists record holds the offset of the current canvas, then for each
+* of the undo, redo and clips lists its length and the offsets of its states (head
+* first). Lists only change at their heads, so most checkpoints write a delta record
+* instead: the offset of the previous lists/delta record and the current canvas,
+* then for each list how many states are kept from the tail of the previous
+* version, followed by the count and offsets of the new states in front of them.
+* Every lists or delta record is followed by a trailer record pointing back at it,
+* so the latest lists can be found from the end of the file.
+*/
+const char SESSIONMAGIC[] = "TXAS";
+const unsigned SESSIONVERSION = 1;
+const int SESSIONHEADERSIZE = 12;
+const int RECORDOVERHEAD = 9;
+const int TRAILERSIZE = RECORDOVERHEAD + 4;
+const unsigned char CANVASRECORD = 1;
+const unsigned char LISTSRECORD = 2;
+const unsigned char TRAILERRECORD = 3;
+const unsigned char DELTARECORD = 4;
+
+// Compact the file on close once it is this much larger than the live data
+const long COMPACTSLACK = 64 * 1024;
+
+// Open session file and the read-only mapping taken when it was opened
+static FILE* sessionFile = NULL;
+static long sessionEnd = 0;
+static const unsigned char* mapped = NULL;
+static long mappedSize = 0;
+#ifdef _WIN32
+static HANDLE mapFileHandle = NULL;
+static HANDLE mapHandle = NULL;
+#endif
+
+// What the last checkpoint wrote, so unchanged state isn't written again
+static unsigned long long currentHash = 0;
+static long currentOffset = 0;
+static ListItemType currentCanvas;
+static unsigned* lastLists = NULL;
+static int lastListsLength = 0;
+static long lastListsOffset = 0;
+static long deltaBytes = 0;     // delta payload written since the last full lists record
+
+static SessionStats stats = {};
+
+static void put32(unsigned char* p, unsigned value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static unsigned get32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+// FNV-1a hash used to detect torn or corrupt records
+static unsigned checksum(const unsigned char data[], int length)
+{
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Maps the whole session file read-only, if it exists and isn't empty
+static void mapSessionFile()
+{
+#ifdef _WIN32
+    mapFileHandle = CreateFileA(SESSIONFILE, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapFileHandle == INVALID_HANDLE_VALUE)
+    {
+        mapFileHandle = NULL;
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(mapFileHandle, &size) && size.QuadPart > 0)
+    {
+        mapHandle = CreateFileMappingA(mapFileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapHandle != NULL)
+        {
+            mapped = (const unsigned char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+            mappedSize = mapped != NULL ? (long)size.QuadPart : 0;
+        }
+    }
+#else
+    int fd = open(SESSIONFILE, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            mapped = (const unsigned char*)view;
+            mappedSize = (long)info.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+static void unmapSessionFile()
+{
+#ifdef _WIN32
+    if (mapped != NULL)
+        UnmapViewOfFile(mapped);
+    if (mapHandle != NULL)
+        CloseHandle(mapHandle);
+    if (mapFileHandle != NULL)
+        CloseHandle(mapFileHandle);
+    mapHandle = NULL;
+    mapFileHandle = NULL;
+#else
+    if (mapped != NULL)
+        munmap((void*)mapped, mappedSize);
+#endif
+    mapped = NULL;
+    mappedSize = 0;
+}
+
+// Appends a record to file at end, returning its offset (or -1 on failure)
+static long writeRecord(FILE* file, long& end, unsigned char type, const unsigned char payload[], int length)
+{
+    unsigned char head[5], tail[4];
+    long offset = end;
+
+    head[0] = type;
+    put32(&head[1], length);
+    put32(tail, checksum(payload, length));
+
+    if (fseek(file, offset, SEEK_SET) != 0 || fwrite(head, 1, 5, file) != 5
+        || (length > 0 && fwrite(payload, 1, length, file) != (size_t)length)
+        || fwrite(tail, 1, 4, file) != 4)
+    {
+        return -1;
+    }
+
+    end += RECORDOVERHEAD + length;
+    if (file == sessionFile)
+    {
+        stats.bytesWritten += RECORDOVERHEAD + length;
+    }
+    return offset;
+}
+
+// Returns the payload of a record inside the mapping, or NULL if it isn't a
+// complete, valid record of the given type
+static const unsigned char* mappedRecord(long offset, unsigned char type, int& length)
+{
+    if (offset < SESSIONHEADERSIZE || offset + RECORDOVERHEAD > mappedSize || mapped[offset] != type)
+    {
+        return NULL;
+    }
+
+    length = (int)get32(&mapped[offset + 1]);
+    if (length < 0 || length > mappedSize - offset - RECORDOVERHEAD)
+    {
+        return NULL;
+    }
+
+    const unsigned char* payload = &mapped[offset + 5];
+    if (get32(&payload[length]) != checksum(payload, length))
+    {
+        return NULL;
+    }
+    return payload;
+}
+
+// Reads the packed canvas stored at offset (from the mapping when possible, or
+// from the file for records written after it was mapped)
+// Returns the packed length, or -1 if the record is missing or corrupt
+static int readPackedCanvas(long offset, unsigned char packed[])
+{
+    int length;
+
+    if (offset < mappedSize)
+    {
+        const unsigned char* payload = mappedRecord(offset, CANVASRECORD, length);
+        if (payload == NULL || length > PACKEDCANVASSIZE)
+        {
+            return -1;
+        }
+        memcpy(packed, payload, length);
+        return length;
+    }
+
+    unsigned char head[5], tail[4];
+    if (sessionFile == NULL || fseek(sessionFile, offset, SEEK_SET) != 0
+        || fread(head, 1, 5, sessionFile) != 5 || head[0] != CANVASRECORD)
+    {
+        return -1;
+    }
+
+    length = (int)get32(&head[1]);
+    if (length < 0 || length > PACKEDCANVASSIZE
+        || fread(packed, 1, length, sessionFile) != (size_t)length
+        || fread(tail, 1, 4, sessionFile) != 4 || get32(tail) != checksum(packed, length))
+    {
+        return -1;
+    }
+    return length;
+}
+
+bool readSessionCanvas(long offset, char canvas[][MAXCOLS])
+{
+    unsigned char packed[PACKEDCANVASSIZE];
+    int length = readPackedCanvas(offset, packed);
+
+    return length >= 0 && unpackBytes(packed, length, (unsigned char*)canvas, sizeof(ListItemType));
+}
+
+// Appends a canvas record, returning its offset (or 0 on failure)
+static long writeCanvasRecord(FILE* file, long& end, char canvas[][MAXCOLS])
+{
+    unsigned char packed[PACKEDCANVASSIZE];
+    int length = packBytes((unsigned char*)canvas, sizeof(ListItemType), packed);
+
+    long offset = writeRecord(file, end, CANVASRECORD, packed, length);
+    if (offset < 0)
+    {
+        return 0;
+    }
+    if (file == sessionFile)
+    {
+        stats.canvasRecords++;
+    }
+    return offset;
+}
+
+// Notes that the current canvas, canvas, was written at offset
+static void rememberCurrent(long offset, char canvas[][MAXCOLS])
+{
+    currentOffset = offset;
+    currentHash = hashCanvas(canvas);
+    memcpy(currentCanvas, canvas, sizeof(ListItemType));
+}
+
+// Makes sure a list node's canvas is in the session file, returning its offset
+static long sessionOffsetOf(Node* node)
+{
+    if (node->sessionOffset == 0 && node->blob != NULL)
+    {
+        // A state pushed from the current canvas is usually what the last
+        // checkpoint wrote for it (the hash only says where to look, as in the store)
+        if (node->blob->sessionOffset == 0 && currentOffset != 0 && node->blob->hash == currentHash
+            && memcmp(node->item, currentCanvas, sizeof(ListItemType)) == 0)
+        {
+            node->blob->sessionOffset = currentOffset;
+        }
+
+        // A shared canvas only needs to be written once
+        if (node->blob->sessionOffset == 0)
+        {
+            node->blob->sessionOffset = writeCanvasRecord(sessionFile, sessionEnd, node->item);
+        }
+        node->sessionOffset = node->blob->sessionOffset;
+    }
+    else if (node->sessionOffset == 0 && node->tween != NULL)
+    {
+        // A tween frame is drawn just to be written, and stays without a canvas
+        node->sessionOffset = writeCanvasRecord(sessionFile, sessionEnd, clipCanvas(node));
+    }
+    else if (node->sessionOffset == 0)
+    {
+        // Only in the spill file, bring it back to copy it across
+        pageIn(node);
+        return sessionOffsetOf(node);
+    }
+    return node->sessionOffset;
+}
+
+// Finds where each list's values start in a flattened lists array
+static void listSlices(const unsigned values[], int start[3], int count[3])
+{
+    int position = 1;
+    for (int i = 0; i < 3; i++)
+    {
+        count[i] = (int)values[position];
+        start[i] = position + 1;
+        position = start[i] + count[i];
+    }
+}
+
+// Appends a lists record (full, or as a delta against lastLists) and the trailer
+// pointing at it. Returns the record's offset, or -1 on failure.
+static long writeListsRecord(FILE* file, long& end, const unsigned values[], int length, bool full)
+{
+    unsigned* fields = new unsigned[length + 6];
+    int fieldCount = 0;
+
+    if (full)
+    {
+        memcpy(fields, values, length * sizeof(unsigned));
+        fieldCount = length;
+    }
+    else
+    {
+        int oldStart[3], oldCount[3], newStart[3], newCount[3];
+        listSlices(lastLists, oldStart, oldCount);
+        listSlices(values, newStart, newCount);
+
+        fields[fieldCount++] = (unsigned)lastListsOffset;
+        fields[fieldCount++] = values[0];
+        for (int i = 0; i < 3; i++)
+        {
+            // Count the states shared with the tail of the previous version
+            int keep = 0;
+            while (keep < oldCount[i] && keep < newCount[i]
+                && lastLists[oldStart[i] + oldCount[i] - 1 - keep] == values[newStart[i] + newCount[i] - 1 - keep])
+            {
+                keep++;
+            }
+
+            fields[fieldCount++] = (unsigned)keep;
+            fields[fieldCount++] = (unsigned)(newCount[i] - keep);
+            for (int j = 0; j < newCount[i] - keep; j++)
+            {
+                fields[fieldCount++] = values[newStart[i] + j];
+            }
+        }
+    }
+
+    unsigned char* payload = new unsigned char[fieldCount * 4];
+    unsigned char trailer[4];
+    for (int i = 0; i < fieldCount; i++)
+    {
+        put32(&payload[i * 4], fields[i]);
+    }
+
+    long offset = writeRecord(file, end, full ? LISTSRECORD : DELTARECORD, payload, fieldCount * 4);
+    delete[] payload;
+    delete[] fields;
+    if (offset < 0)
+    {
+        return -1;
+    }
+
+    put32(trailer, (unsigned)offset);
+    if (writeRecord(file, end, TRAILERRECORD, trailer, 4) < 0)
+    {
+        return -1;
+    }
+
+    deltaBytes = full ? 0 : deltaBytes + fieldCount * 4;
+    if (file == sessionFile)
+    {
+        stats.listsRecords++;
+    }
+    return offset;
+}
+
+// Reads a delta record's entry for one list: the states kept from the previous
+// version, and the new states (pointing into the payload)
+// Returns false if the payload is malformed
+static bool deltaSlice(const unsigned char* payload, int length, int list, int& keep, int& count, const unsigned char*& states)
+{
+    int position = 8;
+    for (int i = 0; i <= list; i++)
+    {
+        if (position + 8 > length)
+        {
+            return false;
+        }
+        keep = (int)get32(&payload[position]);
+        count = (int)get32(&payload[position + 4]);
+        states = &payload[position + 8];
+        if (keep < 0 || count < 0 || count > (length - position - 8) / 4)
+        {
+            return false;
+        }
+        position += 8 + count * 4;
+    }
+    return true;
+}
+
+// Resolves the lists or delta record at offset into a flattened lists array
+// (as built by buildLists), following delta records back to the last full one.
+// Lists are rebuilt newest record first, taking from each older record only the
+// states the newer ones kept, so the work is proportional to the result.
+// Returns NULL if the chain is broken or corrupt.
+static unsigned* resolveLists(long offset, int& length)
+{
+    vector<const unsigned char*> chain;
+    vector<int> lengths;
+    int payloadLength;
+
+    deltaBytes = 0;
+    for (;;)
+    {
+        const unsigned char* payload = mappedRecord(offset, DELTARECORD, payloadLength);
+        if (payload == NULL)
+        {
+            payload = mappedRecord(offset, LISTSRECORD, payloadLength);
+            if (payload == NULL || payloadLength < 16)
+            {
+                return NULL;
+            }
+            chain.push_back(payload);
+            lengths.push_back(payloadLength);
+            break;
+        }
+
+        long base = (long)get32(payload);
+        if (payloadLength < 8 || base >= offset)
+        {
+            return NULL;
+        }
+        chain.push_back(payload);
+        lengths.push_back(payloadLength);
+        deltaBytes += payloadLength;
+        offset = base;
+    }
+
+    // The full record at the end of the chain
+    const unsigned char* full = chain.back();
+    int fullFields = lengths.back() / 4;
+    int fullStart[3], fullCount[3];
+    vector<unsigned> fullValues(fullFields);
+    for (int i = 0; i < fullFields; i++)
+    {
+        fullValues[i] = get32(&full[i * 4]);
+    }
+
+    int position = 1;
+    for (int i = 0; i < 3; i++)
+    {
+        if (position >= fullFields)
+        {
+            return NULL;
+        }
+        fullCount[i] = (int)fullValues[position];
+        fullStart[i] = position + 1;
+        position = fullStart[i] + fullCount[i];
+        if (fullCount[i] < 0 || position > fullFields)
+        {
+            return NULL;
+        }
+    }
+
+    vector<unsigned> result;
+    result.push_back(chain.size() > 1 ? get32(&chain[0][4]) : fullValues[0]);
+
+    for (int list = 0; list < 3; list++)
+    {
+        size_t countPosition = result.size();
+        result.push_back(0);
+
+        // want = how many states still come from older records (-1 = all of them)
+        int want = -1;
+        for (size_t i = 0; i + 1 < chain.size(); i++)
+        {
+            int keep, count;
+            const unsigned char* states;
+            if (!deltaSlice(chain[i], lengths[i], list, keep, count, states))
+            {
+                return NULL;
+            }
+
+            int take = want < 0 ? count : want - keep;
+            if (take > count)
+            {
+                return NULL;
+            }
+            for (int j = count - (take > 0 ? take : 0); j < count; j++)
+            {
+                result.push_back(get32(&states[j * 4]));
+            }
+            if (want < 0 || want > keep)
+            {
+                want = keep;
+            }
+        }
+
+        int take = want < 0 ? fullCount[list] : want;
+        if (take > fullCount[list])
+        {
+            return NULL;
+        }
+        for (int j = fullCount[list] - take; j < fullCount[list]; j++)
+        {
+            result.push_back(fullValues[fullStart[list] + j]);
+        }
+        result[countPosition] = (unsigned)(result.size() - countPosition - 1);
+    }
+
+    length = (int)result.size();
+    unsigned* values = new unsigned[length];
+    memcpy(values, result.data(), length * sizeof(unsigned));
+    return values;
+}
+
+// Puts the cells of a region state's patch into canvas
+static void putPatchCells(const CanvasPatch* patch, char canvas[][MAXCOLS])
+{
+    int cols = patch->bounds.right - patch->bounds.left + 1;
+    for (int row = patch->bounds.top; row <= patch->bounds.bottom; row++)
+    {
+        memcpy(&canvas[row][patch->bounds.left], &patch->cells[(row - patch->bounds.top) * cols], cols);
+    }
+}
+
+// Builds the lists record contents: current offset, then for each of the undo,
+// redo and clips lists its length followed by the offsets of its states
+// (canvas is what region states in the undo and redo lists build on)
+// Returns a new array holding length values
+static unsigned* buildLists(long current, char canvas[][MAXCOLS], List* lists[3], int& length)
+{
+    static ListItemType expanded;
+    length = 4 + lists[0]->count + lists[1]->count + lists[2]->count;
+    unsigned* values = new unsigned[length];
+    int n = 0;
+
+    values[n++] = (unsigned)current;
+    for (int i = 0; i < 3; i++)
+    {
+        // Region states keep only their cells in memory; one not yet written is
+        // written as a whole canvas, built in expanded from its neighbour nearer
+        // the current canvas. Only the states up to the last such need building.
+        int needed = 0, position = 0;
+        for (Node* node = lists[i]->head; node != NULL && i < 2; node = node->next)
+        {
+            position++;
+            if (node->patch != NULL && node->sessionOffset == 0)
+            {
+                needed = position;
+            }
+        }
+
+        CanvasRow* newer = canvas;
+        position = 0;
+        values[n++] = (unsigned)lists[i]->count;
+        for (Node* node = lists[i]->head; node != NULL; node = node->next)
+        {
+            position++;
+            if (node->patch != NULL && position <= needed)
+            {
+                if (newer != expanded)
+                {
+                    memcpy(expanded, newer, sizeof(ListItemType));
+                }
+                putPatchCells(node->patch, expanded);
+                newer = expanded;
+                if (node->sessionOffset == 0)
+                {
+                    node->sessionOffset = writeCanvasRecord(sessionFile, sessionEnd, expanded);
+                }
+                values[n++] = (unsigned)node->sessionOffset;
+            }
+            else
+            {
+                values[n++] = (unsigned)sessionOffsetOf(node);
+                if (position < needed)
+                {
+                    newer = residentCanvas(node);
+                }
+            }
+        }
+    }
+    return values;
+}
+
+// Returns the sorted, distinct session offsets used by the list nodes
+// (the list states must already be in the session file)
+static unsigned* distinctOffsets(List* lists[3], int& distinct)
+{
+    unsigned* offsets = new unsigned[lists[0]->count + lists[1]->count + lists[2]->count + 1];
+    int n = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (Node* node = lists[i]->head; node != NULL; node = node->next)
+        {
+            offsets[n++] = (unsigned)node->sessionOffset;
+        }
+    }
+    sort(offsets, offsets + n);
+    distinct = (int)(unique(offsets, offsets + n) - offsets);
+    return offsets;
+}
+
+// Writes the session header to a new, empty file
+static bool writeHeader(FILE* file, long& end)
+{
+    unsigned char header[SESSIONHEADERSIZE];
+
+    memcpy(header, SESSIONMAGIC, 4);
+    put32(&header[4], SESSIONVERSION);
+    header[8] = (unsigned char)MAXROWS;
+    header[9] = (unsigned char)(MAXROWS >> 8);
+    header[10] = (unsigned char)MAXCOLS;
+    header[11] = (unsigned char)(MAXCOLS >> 8);
+
+    end = SESSIONHEADERSIZE;
+    return fwrite(header, 1, SESSIONHEADERSIZE, file) == SESSIONHEADERSIZE;
+}
+
+// Returns true if the mapping starts with a header for this build's canvas size
+static bool validHeader()
+{
+    return mappedSize >= SESSIONHEADERSIZE && memcmp(mapped, SESSIONMAGIC, 4) == 0
+        && get32(&mapped[4]) == SESSIONVERSION
+        && (mapped[8] | (mapped[9] << 8)) == MAXROWS && (mapped[10] | (mapped[11] << 8)) == MAXCOLS;
+}
+
+// Finds the latest complete lists record in the mapping
+// Fast path: the trailer at the end of the file. After a crash the tail may be
+// torn, so fall back to scanning every record from the start.
+// Returns the offset of the lists record (0 if none) and sets validEnd to the
+// end of the last intact trailer
+static long findLists(long& validEnd)
+{
+    int length;
+    const unsigned char* trailer = mappedRecord(mappedSize - TRAILERSIZE, TRAILERRECORD, length);
+
+    if (trailer != NULL && length == 4)
+    {
+        long offset = (long)get32(trailer);
+        if (mappedRecord(offset, LISTSRECORD, length) != NULL || mappedRecord(offset, DELTARECORD, length) != NULL)
+        {
+            validEnd = mappedSize;
+            return offset;
+        }
+    }
+
+    long offset = SESSIONHEADERSIZE, lists = 0;
+    validEnd = SESSIONHEADERSIZE;
+    while (offset + RECORDOVERHEAD <= mappedSize)
+    {
+        unsigned char type = mapped[offset];
+        const unsigned char* payload = mappedRecord(offset, type, length);
+        if (payload == NULL)
+        {
+            break;
+        }
+
+        if (type == TRAILERRECORD && length == 4)
+        {
+            lists = (long)get32(payload);
+            validEnd = offset + RECORDOVERHEAD + length;
+        }
+        offset += RECORDOVERHEAD + length;
+    }
+    return lists;
+}
+
+// Creates a node whose canvas stays in the session file until it is needed
+static Node* lazyNode(long offset)
+{
+    Node* node = new Node;
+    countAllocation(MEMNODE, sizeof(Node));
+    node->item = NULL;
+    node->blob = NULL;
+    node->next = NULL;
+    node->spillOffset = 0;
+    node->spillLength = 0;
+    node->sessionOffset = offset;
+    node->tween = NULL;
+    node->tweenFrame = 0;
+    node->patch = NULL;
+    return node;
+}
+
+// Rebuilds a list from its slice of a flattened lists array (head first)
+static void restoreList(List& list, const unsigned values[], int start, int count)
+{
+    // Add from the tail so the list ends up in the saved order
+    for (int i = start + count - 1; i >= start; i--)
+    {
+        addNode(list, lazyNode((long)values[i]));
+    }
+}
+
+// Rewrites the session file holding only what the lists and current canvas use
+static void compactSession(Node* current, List& undoList, List& redoList, List& clips)
+{
+    char tempName[FILENAMESIZE];
+    snprintf(tempName, FILENAMESIZE, "%s.tmp", SESSIONFILE);
+
+    FILE* file = fopen(tempName, "w+b");
+    long end = 0;
+    if (file == NULL || !writeHeader(file, end))
+    {
+        if (file != NULL)
+            fclose(file);
+        return;
+    }
+
+    // Collect every distinct offset still referenced
+    List* lists[3] = { &undoList, &redoList, &clips };
+    int distinct, length;
+    unsigned* oldOffsets = distinctOffsets(lists, distinct);
+    unsigned* newOffsets = new unsigned[distinct + 1];
+
+    // Copy each canvas record across without decompressing it
+    bool ok = true;
+    for (int i = 0; i < distinct && ok; i++)
+    {
+        unsigned char packed[PACKEDCANVASSIZE];
+        int packedLength = readPackedCanvas(oldOffsets[i], packed);
+        newOffsets[i] = 0;
+        if (packedLength >= 0)
+        {
+            long offset = writeRecord(file, end, CANVASRECORD, packed, packedLength);
+            ok = offset > 0;
+            newOffsets[i] = (unsigned)offset;
+        }
+    }
+
+    // Point every node (and shared blob) at its new record
+    for (int i = 0; i < 3; i++)
+    {
+        for (Node* node = lists[i]->head; node != NULL; node = node->next)
+        {
+            int index = (int)(lower_bound(oldOffsets, oldOffsets + distinct, (unsigned)node->sessionOffset) - oldOffsets);
+            node->sessionOffset = newOffsets[index];
+            if (node->blob != NULL)
+            {
+                node->blob->sessionOffset = node->sessionOffset;
+            }
+        }
+    }
+
+    rememberCurrent(writeCanvasRecord(file, end, current->item), current->item);
+    unsigned* values = buildLists(currentOffset, current->item, lists, length);
+    long listsOffset = writeListsRecord(file, end, values, length, true);
+    ok = ok && currentOffset > 0 && listsOffset > 0;
+    ok = fflush(file) == 0 && ok;
+    fclose(file);
+
+    // Swap the compacted file in
+    unmapSessionFile();
+    if (sessionFile != NULL)
+    {
+        fclose(sessionFile);
+    }
+    if (ok)
+    {
+        remove(SESSIONFILE);
+        ok = rename(tempName, SESSIONFILE) == 0;
+    }
+    if (!ok)
+    {
+        remove(tempName);
+    }
+
+    sessionFile = fopen(SESSIONFILE, "r+b");
+    if (sessionFile != NULL)
+    {
+        fseek(sessionFile, 0, SEEK_END);
+        sessionEnd = ftell(sessionFile);
+    }
+    mapSessionFile();
+
+    delete[] lastLists;
+    lastLists = values;
+    lastListsLength = length;
+    lastListsOffset = listsOffset;
+    delete[] oldOffsets;
+    delete[] newOffsets;
+}
+
+bool openSession(Node*& current, List& undoList, List& redoList, List& clips)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool restored = false;
+    long listsOffset = 0, validEnd = 0;
+
+    mapSessionFile();
+    if (validHeader())
+    {
+        listsOffset = findLists(validEnd);
+    }
+    else if (mapped != NULL)
+    {
+        // Not a session file this build can read; keep it rather than overwrite it
+        char backupName[FILENAMESIZE];
+        snprintf(backupName, FILENAMESIZE, "%s.bak", SESSIONFILE);
+        unmapSessionFile();
+        remove(backupName);
+        rename(SESSIONFILE, backupName);
+    }
+
+    int length = 0;
+    unsigned* values = listsOffset > 0 ? resolveLists(listsOffset, length) : NULL;
+    if (values != NULL)
+    {
+        Node* canvas = newCanvas();
+
+        if (readSessionCanvas((long)values[0], canvas->item))
+        {
+            List* lists[3] = { &undoList, &redoList, &clips };
+            int start[3], count[3];
+            listSlices(values, start, count);
+            for (int i = 0; i < 3; i++)
+            {
+                restoreList(*lists[i], values, start[i], count[i]);
+            }
+            current = canvas;
+            restored = true;
+            stats.restoredStates = undoList.count + redoList.count + clips.count;
+
+            // Nothing needs writing until something changes
+            rememberCurrent((long)values[0], canvas->item);
+            lastLists = values;
+            lastListsLength = length;
+            lastListsOffset = listsOffset;
+        }
+        else
+        {
+            deleteNode(canvas);
+            delete[] values;
+        }
+    }
+
+    if (mapped != NULL)
+    {
+        sessionFile = fopen(SESSIONFILE, "r+b");
+        sessionEnd = validEnd;
+    }
+    else
+    {
+        sessionFile = fopen(SESSIONFILE, "w+b");
+        if (sessionFile != NULL && !writeHeader(sessionFile, sessionEnd))
+        {
+            fclose(sessionFile);
+            sessionFile = NULL;
+        }
+    }
+
+    if (sessionFile != NULL)
+    {
+        stats.active = true;
+        fseek(sessionFile, 0, SEEK_END);
+        if (restored && ftell(sessionFile) != sessionEnd)
+        {
+            // The tail was torn by a crash; rewrite the file cleanly
+            compactSession(current, undoList, redoList, clips);
+        }
+    }
+
+    stats.openMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return restored;
+}
+
+void checkpointSession(Node* current, List& undoList, List& redoList, List& clips)
+{
+    if (sessionFile == NULL)
+    {
+        return;
+    }
+
+    // Write any new list states (before the current canvas, so a state pushed
+    // from it can reuse what the last checkpoint wrote)
+    List* lists[3] = { &undoList, &redoList, &clips };
+    long checkpointStart = sessionEnd;
+    int length;
+    unsigned* values = buildLists(currentOffset, current->item, lists, length);
+
+    // The current canvas changes in place, so write it again whenever it changed
+    unsigned long long hash = hashCanvas(current->item);
+    if (currentOffset == 0 || hash != currentHash || memcmp(current->item, currentCanvas, sizeof(ListItemType)) != 0)
+    {
+        rememberCurrent(writeCanvasRecord(sessionFile, sessionEnd, current->item), current->item);
+        values[0] = (unsigned)currentOffset;
+    }
+
+    // Then the lists themselves if they changed; a full record once the deltas
+    // since the last one add up to more than a full record would take
+    if (length != lastListsLength || memcmp(values, lastLists, length * sizeof(unsigned)) != 0)
+    {
+        bool full = lastListsOffset == 0 || deltaBytes > length * 4;
+        long offset = writeListsRecord(sessionFile, sessionEnd, values, length, full);
+        if (offset > 0)
+        {
+            delete[] lastLists;
+            lastLists = values;
+            lastListsLength = length;
+            lastListsOffset = offset;
+        }
+        else
+        {
+            delete[] values;
+        }
+    }
+    else
+    {
+        delete[] values;
+    }
+
+    // The operations logged since the last checkpoint are part of this one, so
+    // make it durable before the log drops them
+    if (sessionEnd != checkpointStart)
+    {
+        syncFile(sessionFile);
+    }
+    else
+    {
+        fflush(sessionFile);
+    }
+    resetOpLog(currentHash);
+
+    // States read back from the spill file may now be dropped from memory again
+    enforceHistoryBudget(undoList, redoList);
+}
+
+void closeSession(Node* current, List& undoList, List& redoList, List& clips)
+{
+    if (sessionFile == NULL)
+    {
+        return;
+    }
+
+    checkpointSession(current, undoList, redoList, clips);
+
+    // Live data is the distinct canvases referenced plus the current canvas and lists
+    List* lists[3] = { &undoList, &redoList, &clips };
+    int distinct;
+    unsigned* offsets = distinctOffsets(lists, distinct);
+    long live = SESSIONHEADERSIZE + RECORDOVERHEAD + PACKEDCANVASSIZE + lastListsLength * 4 + 2 * TRAILERSIZE;
+
+    for (int i = 0; i < distinct; i++)
+    {
+        unsigned char packed[PACKEDCANVASSIZE];
+        live += RECORDOVERHEAD + readPackedCanvas(offsets[i], packed);
+    }
+    delete[] offsets;
+
+    if (sessionEnd > live * 2 + COMPACTSLACK)
+    {
+        compactSession(current, undoList, redoList, clips);
+    }
+
+    unmapSessionFile();
+    if (sessionFile != NULL)
+    {
+        fclose(sessionFile);
+        sessionFile = NULL;
+    }
+    delete[] lastLists;
+    lastLists = NULL;
+    lastListsLength = 0;
+    lastListsOffset = 0;
+    stats.active = false;
+}
+
+SessionStats getSessionStats()
+{
+    stats.fileBytes = sessionEnd;
+    return stats;
+}
@@ -0,0 +1,518 @@
+#include <iostream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <conio.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+#include "Definitions.h"
+using namespace std;
+
+// Output is kept until the frame is flushed; this is far more than a frame needs
+const int FRAMEBUFFERSIZE = 64 * 1024;
+
+// How long to wait for the rest of an escape sequence after ESC (milliseconds)
+const int ESCAPEWAIT = 25;
+
+// How often the input thread checks whether it should stop (milliseconds)
+const int INPUTCHECK = 50;
+
+// Keys the input thread can get ahead of the program by
+const int KEYQUEUESIZE = 256;
+
+static TerminalStats stats = {};
+
+// Counted from the input thread as well
+static atomic<int> readCalls(0);
+
+// A key as read by the input thread, and when
+struct KeyEvent
+{
+    char key;
+    chrono::steady_clock::time_point time;
+};
+
+// Single producer, single consumer ring buffer. The producer only moves tail and
+// the consumer only moves head, so neither ever waits on a lock.
+template <typename T, int SIZE>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(const T& item)
+    {
+        unsigned at = tail.load(memory_order_relaxed);
+        if (at - head.load(memory_order_acquire) == SIZE)
+        {
+            return false;
+        }
+        items[at % SIZE] = item;
+        tail.store(at + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        unsigned at = head.load(memory_order_relaxed);
+        if (at == tail.load(memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[at % SIZE];
+        head.store(at + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    T items[SIZE];
+    atomic<unsigned> head;
+    atomic<unsigned> tail;
+};
+
+static SpscQueue<KeyEvent, KEYQUEUESIZE> keyQueue;
+static thread inputThread;
+static atomic<bool> stopInput(false);
+
+// Read times of the keys taken since the last presentFrame
+static vector<chrono::steady_clock::time_point> unpresented;
+static double totalLatencyMs = 0;
+
+// Writes everything in data with as few calls as the system allows
+static void writeOut(const char* data, long length)
+{
+    while (length > 0)
+    {
+#ifdef _WIN32
+        DWORD written = 0;
+        stats.writes++;
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, (DWORD)length, &written, NULL) || written == 0)
+        {
+            return;
+        }
+#else
+        stats.writes++;
+        long written = (long)write(STDOUT_FILENO, data, (size_t)length);
+        if (written <= 0)
+        {
+            return;
+        }
+#endif
+        stats.bytesWritten += written;
+        data += written;
+        length -= written;
+    }
+}
+
+// Collects everything written to cout, and writes it out in one go when flushed
+class FrameBuffer : public streambuf
+{
+public:
+    FrameBuffer()
+    {
+        setp(buffer, buffer + FRAMEBUFFERSIZE);
+    }
+
+protected:
+    int overflow(int ch)
+    {
+        sync();
+        if (ch != EOF)
+        {
+            *pptr() = (char)ch;
+            pbump(1);
+        }
+        return ch == EOF ? 0 : ch;
+    }
+
+    int sync()
+    {
+        if (pptr() > pbase())
+        {
+            writeOut(pbase(), (long)(pptr() - pbase()));
+            setp(buffer, buffer + FRAMEBUFFERSIZE);
+        }
+        return 0;
+    }
+
+private:
+    char buffer[FRAMEBUFFERSIZE];
+};
+
+static FrameBuffer frameBuffer;
+static streambuf* originalBuffer = NULL;
+
+#ifdef _WIN32
+
+static void rawInput(bool raw)
+{
+    // _getch already reads single keys without echo
+}
+
+#else
+
+static termios cookedSettings;
+static bool haveSettings = false;
+static bool inRawMode = false;
+
+// Arrow keys arrive as ESC [ A..D; the key code waits here for the next getKey
+static int pendingKey = -1;
+
+static void rawInput(bool raw)
+{
+    if (!haveSettings || raw == inRawMode)
+    {
+        return;
+    }
+
+    termios settings = cookedSettings;
+    if (raw)
+    {
+        // Single keys, no echo, Enter as '\r' (as _getch gives them); reads never wait
+        settings.c_lflag &= ~(ICANON | ECHO);
+        settings.c_iflag &= ~ICRNL;
+        settings.c_cc[VMIN] = 0;
+        settings.c_cc[VTIME] = 0;
+    }
+    stats.modeSwitches++;
+    tcsetattr(STDIN_FILENO, TCSANOW, &settings);
+    inRawMode = raw;
+}
+
+// Waits up to timeout milliseconds (-1 for ever) for a byte, and reads it
+static int readByte(int timeout)
+{
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    unsigned char ch;
+
+    readCalls++;
+    if (poll(&input, 1, timeout) <= 0)
+    {
+        return -1;
+    }
+    readCalls++;
+    return read(STDIN_FILENO, &ch, 1) == 1 ? ch : -1;
+}
+
+// Reads a key, turning escape sequences into SPECIAL followed by the key code
+static int readKey(int timeout)
+{
+    if (pendingKey >= 0)
+    {
+        int key = pendingKey;
+        pendingKey = -1;
+        return key;
+    }
+
+    int ch = readByte(timeout);
+    if (ch == ESC)
+    {
+        int next = readByte(ESCAPEWAIT);
+        if (next == '[' || next == 'O')
+        {
+            switch (readByte(ESCAPEWAIT))
+            {
+            case 'A':
+                pendingKey = (unsigned char)UPARROW;
+                break;
+            case 'B':
+                pendingKey = (unsigned char)DOWNARROW;
+                break;
+            case 'C':
+                pendingKey = (unsigned char)RIGHTARROW;
+                break;
+            case 'D':
+                pendingKey = (unsigned char)LEFTARROW;
+                break;
+            default:
+                pendingKey = 0;
+                break;
+            }
+            return (unsigned char)SPECIAL;
+        }
+        // ESC on its own is just ESC; a key typed straight after it comes next
+        pendingKey = next;
+    }
+    else if (ch == 127)
+    {
+        ch = '\b';
+    }
+    return ch;
+}
+
+#endif
+
+// cin is tied to this, so line input always starts with the frame on screen and
+// the terminal back in line mode
+class InputTie : public streambuf
+{
+protected:
+    int sync()
+    {
+        cout.flush();
+        rawInput(false);
+        return 0;
+    }
+};
+
+static InputTie inputTie;
+static ostream tieStream(&inputTie);
+
+void openTerminal()
+{
+#ifdef _WIN32
+    // Let the console interpret the escape sequences used to move the cursor
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(output, &mode))
+    {
+        SetConsoleMode(output, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#else
+    haveSettings = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &cookedSettings) == 0;
+#endif
+
+    originalBuffer = cout.rdbuf(&frameBuffer);
+    cin.tie(&tieStream);
+
+    // Start from a blank screen
+    cout << "\x1b[2J";
+}
+
+void closeTerminal()
+{
+    gotoxy(MAXROWS + 3, 0);
+    cout.flush();
+    rawInput(false);
+    cin.tie(&cout);
+    if (originalBuffer != NULL)
+    {
+        cout.rdbuf(originalBuffer);
+        originalBuffer = NULL;
+    }
+}
+
+char getKey()
+{
+    cout.flush();
+#ifdef _WIN32
+    readCalls++;
+    return (char)_getch();
+#else
+    rawInput(true);
+    int key = readKey(-1);
+    return key < 0 ? ESC : (char)key;
+#endif
+}
+
+int pollKey()
+{
+    cout.flush();
+#ifdef _WIN32
+    readCalls++;
+    if (!_kbhit())
+    {
+        return -1;
+    }
+    readCalls++;
+    return (unsigned char)_getch();
+#else
+    rawInput(true);
+    int key = readKey(0);
+    return key < 0 ? -1 : (unsigned char)key;
+#endif
+}
+
+// Input thread: reads keys into keyQueue until ESC, or until asked to stop
+static void readKeys()
+{
+    while (!stopInput)
+    {
+        int key;
+#ifdef _WIN32
+        readCalls++;
+        if (!_kbhit())
+        {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            continue;
+        }
+        readCalls++;
+        key = (char)_getch();
+#else
+        key = readKey(INPUTCHECK);
+        if (key < 0)
+        {
+            continue;
+        }
+#endif
+        KeyEvent event = { (char)key, chrono::steady_clock::now() };
+        while (!keyQueue.push(event) && !stopInput)
+        {
+            this_thread::yield();
+        }
+        if (event.key == ESC)
+        {
+            return;
+        }
+    }
+}
+
+void startKeyThread()
+{
+    // The terminal is switched to key input here, as it can't be from the thread
+    cout.flush();
+    rawInput(true);
+
+    stopInput = false;
+    inputThread = thread(readKeys);
+}
+
+void stopKeyThread()
+{
+    if (inputThread.joinable())
+    {
+        stopInput = true;
+        inputThread.join();
+    }
+
+    // Keys nobody asked for are dropped
+    KeyEvent event;
+    while (keyQueue.pop(event))
+    {
+    }
+    unpresented.clear();
+}
+
+bool nextKeyEvent(char& key, int ms)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    KeyEvent event;
+
+    while (!keyQueue.pop(event))
+    {
+        if (chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    key = event.key;
+    unpresented.push_back(event.time);
+    return true;
+}
+
+bool waitForKey(char key, int ms)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    char next;
+
+    for (;;)
+    {
+        int left = (int)chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (!nextKeyEvent(next, left > 0 ? left : 0))
+        {
+            return false;
+        }
+        if (next == key)
+        {
+            return true;
+        }
+    }
+}
+
+void presentFrame()
+{
+    cout.flush();
+
+    // Every key taken since the last frame is on screen now
+    if (!unpresented.empty())
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (size_t i = 0; i < unpresented.size(); i++)
+        {
+            double ms = chrono::duration<double, milli>(now - unpresented[i]).count();
+            totalLatencyMs += ms;
+            if (ms > stats.maxLatencyMs)
+            {
+                stats.maxLatencyMs = ms;
+            }
+        }
+        stats.keysPresented += (int)unpresented.size();
+        stats.keyFrames++;
+        unpresented.clear();
+    }
+}
+
+void pauseScreen()
+{
+    cout << "Press any key to continue . . .";
+    (void)getKey();
+}
+
+void sleepMs(int ms)
+{
+    // Whatever was drawn so far should be seen during the pause
+    cout.flush();
+    this_thread::sleep_for(chrono::milliseconds(ms));
+}
+
+void countFrame()
+{
+    stats.frames++;
+}
+
+TerminalStats getTerminalStats()
+{
+    TerminalStats current = stats;
+    current.reads = readCalls;
+    current.latencyMs = stats.keysPresented > 0 ? totalLatencyMs / stats.keysPresented : 0;
+    return current;
+}
+
+/*
+  Moves the cursor in the output window to a specified row and column.
+  The next output produced by the program will begin at this position.
+*/
+void gotoxy(short row, short col)
+{
+    char sequence[16];
+    int length = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1, col + 1);
+    cout.write(sequence, length);
+}
+
+
+/*
+  Clears a line on the output screen, then resets the cursor back to the
+  beginning of this line.
+  lineNum is the line number on the output screen to clear
+  numOfChars is the number of characters to clear on this line
+*/
+void clearLine(int lineNum, int numOfChars)
+{
+    static const string spaces(CLEARCOLS, ' ');
+
+    // Move cursor to the beginning of the specified line on the console
+    gotoxy(lineNum, 0);
+
+    // Overwrite the characters, or everything to the end of the line when asked
+    // for a full line (spaces would wrap on a narrower terminal)
+    if (numOfChars >= CLEARCOLS)
+    {
+        cout << "\x1b[K";
+    }
+    else
+    {
+        cout.write(spaces.data(), numOfChars);
+    }
+
+    // Move cursor back to the beginning of the line
+    gotoxy(lineNum, 0);
+}
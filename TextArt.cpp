@@ -6,15 +6,22 @@
 #include <iostream>
 #include <fstream>
 #include <cctype>
-#include <windows.h>
-#include <conio.h>
 #include <string>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <chrono>
 #include "Definitions.h"
+#include "CanvasKernels.h"
 using namespace std;
 
 const int MENULINE = 23;
 const char INVALIDCHARS[] = "<>:\"/\\|?*";
 
+// Kernels specialized for the drawing canvas
+typedef Canvas<MAXROWS, MAXCOLS> DrawingCanvas;
+
 // Function declarations
 void loadCanvas(char canvas[][MAXCOLS]);
 bool loadCanvas(char canvas[][MAXCOLS], char filename[]);
@@ -29,24 +36,36 @@ void editCanvas(char canvas[][MAXCOLS]);
 void copyCanvas(char to[][MAXCOLS], char from[][MAXCOLS]);
 void replace(char canvas[][MAXCOLS], char oldCh, char newCh);
 void moveCanvas(char canvas[][MAXCOLS], int rowValue, int colValue);
-void clearLine(int lineNum, int numOfChars);
-void gotoxy(short row, short col);
 
+// Left out when these functions are built into the benchmarks (see CMakeLists.txt)
+#ifndef TEXTARTLIBRARY
 int main()
 {
-    //Initialize the current canvas as a Node
-    Node* current = newCanvas();
+    Node* current = NULL;
 
     // Input variables
     char input = 'a', oldChar, newChar;
     int moveRow, moveCol;
     bool animate = false;
+    Operation op;
 
     // Initialize the undo, redo, and clips lists
     List undoList = { NULL, 0 };
     List redoList = { NULL, 0 };
     List clipsList = { NULL, 0 };
 
+    // Take over the terminal (and put it back before exiting)
+    openTerminal();
+
+    // Restore the previous session, or initialize the current canvas as a new Node
+    if (!openSession(current, undoList, redoList, clipsList))
+    {
+        current = newCanvas();
+    }
+
+    // Redo any edits a crash kept from the session, and log new ones from here on
+    openOpLog(current, undoList, redoList, clipsList);
+
     // Clear the screen manually using gotoxy and clearLine
     gotoxy(0, 0);
     for (int i = 0; i <= MAXROWS + 3; i++) {
@@ -54,8 +73,9 @@ int main()
     }
 
     while (input != 'q' && input != 'Q') {
-        // Display the current canvas
-        displayCanvas(current->item);
+        // Display the current canvas, over its neighbouring clips if asked for
+        updateOnionSkin(clipsList);
+        displayOnionSkin(current->item, false);
 
         // Display the top menu line with undo/redo/clip information
         clearLine(MAXROWS + 1, CLEARCOLS);
@@ -67,10 +87,42 @@ int main()
         if (clipsList.count >= 2) {
             cout << " / <P>lay";
         }
+        if (clipsList.count >= 1) {
+            cout << " / o<N>ion: ";
+            if (onionSkinFrames() > 0)
+                cout << onionSkinFrames();
+            else
+                cout << "off";
+            cout << " / <V>iew all / <Z>oom";
+        }
+        cout << " / macro<K>: " << macroLength() << (isRecordingMacro() ? " REC" : "");
+
+        // What's on the canvas, and the rectangle it takes up
+        const CanvasContent& content = canvasContent(current->item);
+        if (content.inked > 0) {
+            cout << " / " << content.distinct - (content.counts[' '] > 0 ? 1 : 0) << " chars in " << content.bottom - content.top + 1
+                << "x" << content.right - content.left + 1;
+        }
+        else {
+            cout << " / blank";
+        }
+
+        // Memory held by the canvases, flagged past the soft and hard limits
+        MemoryStats memory = getMemoryStats(undoList, redoList, clipsList);
+        cout << " / mem: " << memory.liveBytes / 1024 << " KB";
+        if (memory.liveBytes >= memory.hardLimit) {
+            cout << " FULL";
+        }
+        else if (memory.liveBytes >= memory.softLimit) {
+            cout << " HIGH";
+        }
+
+        // Timings and counts of the last command, while profiling
+        displayProfileLine();
 
         // Display the main menu line
         clearLine(MAXROWS + 2, CLEARCOLS);
-        cout << "<E>dit / <M>ove / <R>eplace / <D>raw / <C>lear / <L>oad / <S>ave / <Q>uit: ";
+        cout << "<E>dit / <M>ove / <T>ween / <R>eplace / <F>ind / <D>raw / <C>lear / <L>oad / <S>ave / <?>Stats / <Q>uit: ";
 
         // Get user input
         cin >> input;
@@ -107,7 +159,34 @@ int main()
         case 'i':
         case 'I':
             // Create a copy of the current canvas and add it to the clips list
-            addNode(clipsList, newCanvas(current));
+            if (addClip(clipsList, newCanvas(current)))
+            {
+                recordOperation(newOperation(OPCLIP));
+            }
+            break;
+
+            // show the neighbouring clips under the canvas
+        case 'n':
+        case 'N':
+            if (clipsList.count >= 1) {
+                onionMenu(clipsList);
+            }
+            break;
+
+            // show every clip at once, shrunk
+        case 'v':
+        case 'V':
+            if (clipsList.count >= 1) {
+                contactSheetMenu(current, undoList, redoList, clipsList);
+            }
+            break;
+
+            // pan and zoom over the clips and the canvas together
+        case 'z':
+        case 'Z':
+            if (clipsList.count >= 1) {
+                overviewMenu(current, clipsList);
+            }
             break;
 
             // play animation clips
@@ -139,6 +218,9 @@ int main()
             cin >> moveCol;
             cout << "Enter the row units to move: ";
             cin >> moveRow;
+            // Anything moved a canvas or more away is gone, so keep the amounts where the op log can hold them
+            moveRow = max(-MAXROWS, min(moveRow, MAXROWS));
+            moveCol = max(-MAXCOLS, min(moveCol, MAXCOLS));
             clearLine(MAXROWS + 1, 50);
             clearLine(MAXROWS + 2, 50);
 
@@ -146,7 +228,15 @@ int main()
             addUndoState(undoList, redoList, current);
 
             // Move the canvas contents
-            moveCanvas(current->item, moveRow, moveCol);
+            op = newOperation(OPMOVE);
+            op.end = Point(moveRow, moveCol);
+            performOperation(current->item, op, animate);
+            break;
+
+            // find a pattern on the canvas or in the clips
+        case 'f':
+        case 'F':
+            findMenu(current, clipsList);
             break;
 
             // replace character in canvas
@@ -162,11 +252,13 @@ int main()
             clearLine(MAXROWS + 1, 50);
             clearLine(MAXROWS + 2, 50);
 
-            // Add current state to undo list before modifying
-            addUndoState(undoList, redoList, current);
-
-            // Replace characters in the canvas
-            replace(current->item, oldChar, newChar);
+            // Replace characters in the canvas, adding the cells that may
+            // change to the undo list first
+            op = newOperation(OPREPLACE);
+            op.ch = oldChar;
+            op.newCh = newChar;
+            addUndoState(undoList, redoList, current, op);
+            performOperation(current->item, op, animate);
 
             break;
 
@@ -174,7 +266,7 @@ int main()
         case 'l':
         case 'L':
             clearLine(MAXROWS + 1, CLEARCOLS);
-            cout << "<C>anvas or <A>nimation ? ";
+            cout << "<C>anvas, <A>nimation, <I>mage or <P>atch ? ";
             char loadType;
             cin >> loadType;
             cin.clear();
@@ -204,24 +296,33 @@ int main()
                 if (!loadClips(clipsList, filePath))
                 {
                     cout << "ERROR: File could not be read: ";
-                    system("pause");
+                    pauseScreen();
                 }
                 else
                 {
                     // Add these lines to show success message and pause
                     // Wait for a keypress
                     cout << "Clips loaded!" << endl;
-                    cout << "Press any key to continue . . .";
-                    (void)_getch();
+                    pauseScreen();
                 }
             }
+            else if (loadType == 'I' || loadType == 'i')
+            {
+                // Convert a PGM or PPM image, or a numbered sequence of them
+                importMenu(current, undoList, redoList, clipsList);
+            }
+            else if (loadType == 'P' || loadType == 'p')
+            {
+                // Apply a saved patch to saved files, or to the canvas or clips
+                patchMenu(current, undoList, redoList, clipsList);
+            }
             break;
 
             // save canvas or animation to file
         case 's':
         case 'S':
             clearLine(MAXROWS + 1, CLEARCOLS);
-            cout << "<C>anvas or <A>nimation ? ";
+            cout << "<C>anvas, <A>nimation, <D>iff or <I>mage ? ";
             char saveType;
             cin >> saveType;
             cin.clear();
@@ -253,7 +354,7 @@ int main()
                 if (!valid)
                 {
                     cout << "ERROR: Invalid filename. ";
-                    system("pause");
+                    pauseScreen();
                 }
                 else {
                     // Form the base path
@@ -264,16 +365,25 @@ int main()
                     if (!saveClips(clipsList, filePath))
                     {
                         cout << "ERROR: Files could not be written. ";
-                        system("pause");
+                        pauseScreen();
                     }
                     else
                     {
                         cout << "Animation files saved!\n";
-                        cout << "Press any key to continue . . .";
-                        (void)_getch();
+                        pauseScreen();
                     }
                 }
             }
+            else if (saveType == 'D' || saveType == 'd')
+            {
+                // Compare two saved canvases or animations, saving the patch between them
+                diffMenu();
+            }
+            else if (saveType == 'I' || saveType == 'i')
+            {
+                // Draw the canvas as a PNG or the clips as an animated GIF
+                exportMenu(current, clipsList);
+            }
             break;
 
             //draw menu
@@ -282,6 +392,23 @@ int main()
             menuTwo(current, undoList, redoList, clipsList, animate);
             break;
 
+            // add a tween of the current canvas to the clips
+        case 't':
+        case 'T':
+            tweenMenu(current, clipsList);
+            break;
+
+            // record or replay a macro
+        case 'k':
+        case 'K':
+            macroMenu(current, undoList, redoList, clipsList);
+            break;
+
+            // show statistics
+        case '?':
+            displayStats(undoList, redoList, clipsList);
+            break;
+
             //clear canvas
         case 'c':
         case 'C':
@@ -289,7 +416,7 @@ int main()
             addUndoState(undoList, redoList, current);
 
             // Clear the canvas
-            initCanvas(current->item);
+            performOperation(current->item, newOperation(OPCLEAR), animate);
 
             break;
 
@@ -301,47 +428,23 @@ int main()
             clearLine(MAXROWS + 2, 100);
             break;
         }
+
+        // Record what changed in the session file
+        checkpointSession(current, undoList, redoList, clipsList);
     }
 
-    // Clean up memory before exiting
-    delete current;
+    // Save the session, then clean up memory before exiting
+    closeSession(current, undoList, redoList, clipsList);
+    closeOpLog();
+    closeTerminal();
+    deleteNode(current);
     deleteList(undoList);
     deleteList(redoList);
     deleteList(clipsList);
 
     return 0;
 }
-
-
-/*
-  Moves the cursor in the output window to a specified row and column.
-  The next output produced by the program will begin at this position.
-*/
-void gotoxy(short row, short col)
-{
-    COORD pos = { col, row };
-    SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), pos);
-}
-
-
-/*
-  Clears a line on the output screen, then resets the cursor back to the
-  beginning of this line.
-  lineNum is the line number on the output screen to clear
-  numOfChars is the number of characters to clear on this line
-*/
-void clearLine(int lineNum, int numOfChars)
-{
-    // Move cursor to the beginning of the specified line on the console
-    gotoxy(lineNum, 0);
-
-    // Write a specified number of spaces to overwrite characters
-    for (int x = 0; x < numOfChars; x++)
-        cout << " ";
-
-    // Move cursor back to the beginning of the line
-    gotoxy(lineNum, 0);
-}
+#endif
 
 
 /*
@@ -351,12 +454,20 @@ void clearLine(int lineNum, int numOfChars)
 */
 void replace(char canvas[][MAXCOLS], char oldCh, char newCh)
 {
-    // Goes over every index, checks if they have oldCh, and if so, replaces it with newCh
-    for (int i = 0; i < MAXROWS; i++) {
-        for (int j = 0; j < MAXCOLS; j++) {
-            if (canvas[i][j] == oldCh)
-                canvas[i][j] = newCh;
+    // Merge the character planes when they're available, else scan the cells
+    // that hold something (all of them when replacing spaces)
+    if (!replacePlanes(canvas, oldCh, newCh))
+    {
+        const CanvasContent& content = canvasContent(canvas);
+        if (oldCh == ' ')
+        {
+            DrawingCanvas::replace(canvas, oldCh, newCh);
         }
+        else if (content.counts[(unsigned char)oldCh] > 0)
+        {
+            DrawingCanvas::replaceRect(canvas, content.top, content.left, content.bottom, content.right, oldCh, newCh);
+        }
+        canvasChanged(canvas);
     }
 }
 
@@ -367,56 +478,76 @@ void replace(char canvas[][MAXCOLS], char oldCh, char newCh)
 */
 void editCanvas(char canvas[][MAXCOLS])
 {
-    char input;
+    // Shortest time between frames (about 60 a second); keys arriving
+    // in the meantime are shown together
+    const int FRAMETIME = 16;
+
+    char input = '\0';
     int row = 0, col = 0;
+    bool special = false, skip = false;
+    chrono::steady_clock::time_point lastFrame = chrono::steady_clock::now();
 
-    // Move cursor to row,col and then get
-    // a single character from the keyboard
+    // Keys are read on their own thread, so drawing never holds them up
     gotoxy(row, col);
-    input = _getch();
-    while (input != ESC) {
+    presentFrame();
+    startKeyThread();
 
-        if (input == SPECIAL) {
-            input = _getch();
-            switch (input) {
-            case LEFTARROW:
-                if (col > 0 && col <= MAXCOLS) {
-                    col--;
-                    gotoxy(row, col);
-                }
-                break;
-            case RIGHTARROW:
-                if (col >= 0 && col < MAXCOLS - 1) {
-                    col++;
-                    gotoxy(row, col);
-                }
-                break;
-            case UPARROW:
-                if (row > 0 && row <= MAXROWS) {
-                    row--;
-                    gotoxy(row, col);
-                }
-                break;
-            case DOWNARROW:
-                if (row >= 0 && row < MAXROWS - 1) {
-                    row++;
-                    gotoxy(row, col);
+    while (input != ESC) {
+        if (!nextKeyEvent(input, 1000))
+            continue;
+        chrono::steady_clock::time_point frameDue = lastFrame + chrono::milliseconds(FRAMETIME);
+
+        do {
+            // arrow keys come as SPECIAL followed by the key code
+            if (special) {
+                special = false;
+                switch (input) {
+                case LEFTARROW:
+                    if (col > 0 && col <= MAXCOLS)
+                        col--;
+                    break;
+                case RIGHTARROW:
+                    if (col >= 0 && col < MAXCOLS - 1)
+                        col++;
+                    break;
+                case UPARROW:
+                    if (row > 0 && row <= MAXROWS)
+                        row--;
+                    break;
+                case DOWNARROW:
+                    if (row >= 0 && row < MAXROWS - 1)
+                        row++;
+                    break;
                 }
-                break;
             }
-        }
-        // handles function keys
-        else if (input == '\0')
-            input = _getch();
-        // handles whitespace keys
-        else if (input != '\n' && input != '\t' && input != '\r' && input != '\b')
-        {
-            canvas[row][col] = input;
-            cout << input;
-            gotoxy(row, col);
-        }
-        input = _getch();
+            // function keys come as '\0' followed by a code, which is ignored
+            else if (skip)
+                skip = false;
+            else if (input == SPECIAL)
+                special = true;
+            else if (input == '\0')
+                skip = true;
+            // handles whitespace keys
+            else if (input != ESC && input != '\n' && input != '\t' && input != '\r' && input != '\b')
+            {
+                // Logged so the keystroke survives a crash
+                Operation op = newOperation(OPCELL);
+                op.start = Point(row, col);
+                op.ch = input;
+                performOperation(canvas, op, false);
+            }
+        } while (input != ESC && nextKeyEvent(input,
+            (int)chrono::duration_cast<chrono::milliseconds>(frameDue - chrono::steady_clock::now()).count()));
+
+        // One frame shows every key taken above; with the onion skin on only
+        // the cells they changed are drawn again
+        displayOnionSkin(canvas, true);
+        gotoxy(row, col);
+        presentFrame();
+        lastFrame = chrono::steady_clock::now();
     }
+
+    stopKeyThread();
 }
 
 
@@ -429,18 +560,13 @@ void editCanvas(char canvas[][MAXCOLS])
 */
 void moveCanvas(char canvas[][MAXCOLS], int rowValue, int colValue)
 {
-    char newArr[MAXROWS][MAXCOLS];
-    initCanvas(newArr);
-    for (int i = 0; i < MAXROWS; i++)
+    // Only the rectangle holding something needs to move
+    const CanvasContent& content = canvasContent(canvas);
+    if (content.inked > 0)
     {
-        for (int j = 0; j < MAXCOLS; j++)
-        {
-            // Checks if new position is within bounds, and if so, adds the element in the old index to the new position
-            if (i + rowValue >= 0 && i + rowValue < MAXROWS && j + colValue >= 0 && j + colValue < MAXCOLS)
-                newArr[i + rowValue][j + colValue] = canvas[i][j];
-        }
+        DrawingCanvas::moveRect(canvas, content.top, content.left, content.bottom, content.right, rowValue, colValue);
+        canvasChanged(canvas);
     }
-    copyCanvas(canvas, newArr);
 }
 
 
@@ -449,13 +575,8 @@ void moveCanvas(char canvas[][MAXCOLS], int rowValue, int colValue)
 */
 void initCanvas(char canvas[][MAXCOLS])
 {
-    for (int i = 0; i < MAXROWS; i++)
-    {
-        for (int j = 0; j < MAXCOLS; j++)
-        {
-            canvas[i][j] = ' ';
-        }
-    }
+    DrawingCanvas::init(canvas);
+    canvasChanged(canvas);
 }
 
 
@@ -463,28 +584,62 @@ void initCanvas(char canvas[][MAXCOLS])
   Displays canvas contents on the screen, with a border
   around the right and bottom edges.
   Uses screen buffering technique to avoid flickering and cursor movement
+  Blank space around the content is erased rather than written out
 */
 void displayCanvas(char canvas[][MAXCOLS]) {
-    static char buffer[MAXROWS + 1][MAXCOLS + 2];
-
-    // copies items in array along with the right border with newlines
+    // Erases to the end of the line, then goes to the border column
+    static char blankRest[16];
+    static const int blankLength = snprintf(blankRest, sizeof(blankRest), "\x1b[K\x1b[%dG|\n", MAXCOLS + 1);
+    // Most bytes a row can take: an erase before the content, the content, blankRest
+    const int ROWBYTES = 16 + MAXCOLS + sizeof(blankRest);
+    static char buffer[MAXROWS * ROWBYTES + MAXCOLS + 2];
+    int length = 0;
+    ProfileScope scope(PROFDISPLAY);
+
+    const CanvasContent& content = canvasContent(canvas);
     for (int row = 0; row < MAXROWS; row++)
     {
-        memcpy(buffer[row], canvas[row], MAXCOLS);
-        memcpy(&buffer[row][MAXCOLS], "|\n", 2);
+        int left = 0, right = -1;
+        if (row >= content.top && row <= content.bottom)
+        {
+            left = content.left;
+            right = content.right;
+        }
+
+        // A wide blank margin is cheaper to erase than to write
+        if (left > 8)
+        {
+            length += snprintf(&buffer[length], 16, "\x1b[%dG\x1b[1K", left + 1);
+        }
+        else
+        {
+            left = 0;
+        }
+        memcpy(&buffer[length], &canvas[row][left], right - left + 1);
+        length += right - left + 1;
+
+        if (right == MAXCOLS - 1)
+        {
+            memcpy(&buffer[length], "|\n", 2);
+            length += 2;
+        }
+        else
+        {
+            memcpy(&buffer[length], blankRest, blankLength);
+            length += blankLength;
+        }
     }
 
     // creates the bottom border
-    for (int col = 0; col < MAXCOLS + 1; col++)
-    {
-        buffer[MAXROWS][col] = '-';
-    }
-    buffer[MAXROWS][MAXCOLS + 1] = '\n';
+    memset(&buffer[length], '-', MAXCOLS + 1);
+    length += MAXCOLS + 1;
+    buffer[length++] = '\n';
 
     // resets cursor back to top to get ready for write
+    countFrame();
     gotoxy(0, 0);
     // writes buffer to screen
-    cout.write(&buffer[0][0],(MAXROWS + 1) * (MAXCOLS + 2));
+    cout.write(buffer, length);
 }
 
 /*
@@ -492,10 +647,8 @@ void displayCanvas(char canvas[][MAXCOLS]) {
 */
 void copyCanvas(char to[][MAXCOLS], char from[][MAXCOLS])
 {
-    for (int i = 0; i < MAXROWS; i++) {
-        for (int j = 0; j < MAXCOLS; j++)
-            to[i][j] = from[i][j];
-    }
+    DrawingCanvas::copy(to, from);
+    canvasChanged(to);
 }
 
 
@@ -521,7 +674,7 @@ void loadCanvas(char canvas[][MAXCOLS])
     if (!loadCanvas(canvas, filePath))
     {
         cout << "ERROR: File cannot be read. ";
-        system("pause");
+        pauseScreen();
     }
 }
 
@@ -602,7 +755,7 @@ void saveCanvas(char canvas[][MAXCOLS])
     if (!valid)
     {
         cout << "ERROR: Invalid filename.\n";
-        system("pause");
+        pauseScreen();
     }
     else
     {
@@ -612,12 +765,11 @@ void saveCanvas(char canvas[][MAXCOLS])
         //Attempt to save the file
         if (!saveCanvas(canvas, filePath)) {
             cout << "ERROR: File could not be written.\n";
-            system("pause");
+            pauseScreen();
         }
         else {
             cout << "File saved!\n";
-            cout << "Press any key to continue . . .";
-            (void)_getch();
+            pauseScreen();
         }
     }
 }
@@ -640,11 +792,12 @@ bool saveCanvas(char canvas[][MAXCOLS], char filename[])
         return false; // File could not be opened for writing
     }
 
-    // Write canvas to file
-    for (int i = 0; i < MAXROWS; i++)
+    // Write canvas to file, leaving out the blank rows and columns after
+    // the content; loading fills them with spaces again
+    const CanvasContent& content = canvasContent(canvas);
+    for (int i = 0; i <= content.bottom; i++)
     {
-        for (int j = 0; j < MAXCOLS; j++)
-            outFile << canvas[i][j];
+        outFile.write(canvas[i], content.right + 1);
         outFile << '\n';
     }
 
@@ -0,0 +1,225 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "Definitions.h"
+#include "CanvasKernels.h"
+using namespace std;
+
+// Glyphs each transform swaps, in pairs. drawLine draws '|' and '-' for steep
+// and flat lines, '`' for lines going down to the right and '\'' for lines
+// going up; '/' and '\\' are the diagonals drawn by hand
+static const char* SWAPS[TRANSFORMS] = {
+    "`'/\\()[]{}<>",    // mirror: the diagonals and brackets face the other way
+    "`'/\\",            // flip: the diagonals do
+    "|-",               // transpose: the diagonal it flips across stays put
+    "|-`'/\\",          // quarter turns: everything straight or diagonal turns
+    "()[]{}<>",         // half turn: the diagonals come back the same
+    "|-`'/\\",
+    ""                  // scale
+};
+
+// Widens bounds to take in row, col
+static void include(CellRect& bounds, int row, int col)
+{
+    bounds.top = min(bounds.top, row);
+    bounds.left = min(bounds.left, col);
+    bounds.bottom = max(bounds.bottom, row);
+    bounds.right = max(bounds.right, col);
+}
+
+bool transformRects(char canvas[][MAXCOLS], Operation op, CellRect& from, CellRect& to)
+{
+    // The part of the rectangle holding something
+    from.top = MAXROWS;
+    from.left = MAXCOLS;
+    from.bottom = -1;
+    from.right = -1;
+    int top = max(0, min(op.start.row, op.end.row)), bottom = min(MAXROWS - 1, max(op.start.row, op.end.row));
+    int left = max(0, min(op.start.col, op.end.col)), right = min(MAXCOLS - 1, max(op.start.col, op.end.col));
+    for (int row = top; row <= bottom; row++)
+    {
+        for (int col = left; col <= right; col++)
+        {
+            if (canvas[row][col] != ' ')
+            {
+                include(from, row, col);
+            }
+        }
+    }
+    if (rectCells(from) == 0 || op.angle < 0 || op.angle >= TRANSFORMS)
+    {
+        return false;
+    }
+
+    int rows = from.bottom - from.top + 1, cols = from.right - from.left + 1;
+    if (op.angle == TRANSSCALE)
+    {
+        int factor = max(1, min(op.size, MAXSCALEFACTOR));
+        to.top = from.top;
+        to.left = from.left;
+        to.bottom = from.top + rows * factor - 1;
+        to.right = from.left + cols * factor - 1;
+    }
+    else
+    {
+        // Rows and columns swap places for a transpose or quarter turn
+        bool across = op.angle == TRANSPOSE || op.angle == TRANSROTATE90 || op.angle == TRANSROTATE270;
+        int toRows = across ? cols : rows, toCols = across ? rows : cols;
+        to.top = from.top + (rows - toRows) / 2;
+        to.left = from.left + (cols - toCols) / 2;
+        to.bottom = to.top + toRows - 1;
+        to.right = to.left + toCols - 1;
+    }
+    return true;
+}
+
+void applyTransform(char canvas[][MAXCOLS], Operation op)
+{
+    CellRect from, to;
+    if (!transformRects(canvas, op, from, to))
+    {
+        return;
+    }
+
+    int rows = from.bottom - from.top + 1, cols = from.right - from.left + 1;
+    int toRows = to.bottom - to.top + 1, toCols = to.right - to.left + 1;
+    vector<char> cells((size_t)rows * cols), turned((size_t)toRows * toCols);
+    for (int row = 0; row < rows; row++)
+    {
+        copy(&canvas[from.top + row][from.left], &canvas[from.top + row][from.left] + cols, &cells[(size_t)row * cols]);
+    }
+
+    switch (op.angle)
+    {
+    case TRANSMIRROR:
+        flipAcrossDynamic(&cells[0], rows, cols);
+        turned.swap(cells);
+        break;
+    case TRANSFLIP:
+        flipDownDynamic(&cells[0], rows, cols);
+        turned.swap(cells);
+        break;
+    case TRANSPOSE:
+        transposeDynamic(&turned[0], &cells[0], rows, cols);
+        break;
+    case TRANSROTATE90:
+        rotateClockwiseDynamic(&turned[0], &cells[0], rows, cols);
+        break;
+    case TRANSROTATE180:
+        rotateHalfDynamic(&cells[0], rows, cols);
+        turned.swap(cells);
+        break;
+    case TRANSROTATE270:
+        rotateCounterDynamic(&turned[0], &cells[0], rows, cols);
+        break;
+    case TRANSSCALE:
+        scaleDynamic(&turned[0], &cells[0], rows, cols, toRows / rows);
+        break;
+    }
+
+    unsigned char glyphs[256];
+    for (int ch = 0; ch < 256; ch++)
+    {
+        glyphs[ch] = (unsigned char)ch;
+    }
+    for (const char* swap = SWAPS[op.angle]; swap[0] != '\0'; swap += 2)
+    {
+        glyphs[(unsigned char)swap[0]] = (unsigned char)swap[1];
+        glyphs[(unsigned char)swap[1]] = (unsigned char)swap[0];
+    }
+
+    // What lands off the canvas is lost
+    for (int row = from.top; row <= from.bottom; row++)
+    {
+        fill(&canvas[row][from.left], &canvas[row][from.left] + cols, ' ');
+    }
+    for (int row = max(to.top, 0); row <= min(to.bottom, MAXROWS - 1); row++)
+    {
+        for (int col = max(to.left, 0); col <= min(to.right, MAXCOLS - 1); col++)
+        {
+            canvas[row][col] = (char)glyphs[(unsigned char)turned[(size_t)(row - to.top) * toCols + col - to.left]];
+        }
+    }
+    canvasChanged(canvas);
+}
+
+bool transformMenu(Operation& op)
+{
+    char input;
+    Point corner, opposite;
+
+    op = newOperation(OPTRANSFORM);
+    op.size = 1;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "<H> mirror / <V> flip / <T>ranspose / rotate <9>0, <1>80 or <2>70 clockwise / <S>cale up: ";
+    cin >> input;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    switch (input)
+    {
+    case 'h':
+    case 'H':
+        op.angle = TRANSMIRROR;
+        break;
+    case 'v':
+    case 'V':
+        op.angle = TRANSFLIP;
+        break;
+    case 't':
+    case 'T':
+        op.angle = TRANSPOSE;
+        break;
+    case '9':
+        op.angle = TRANSROTATE90;
+        break;
+    case '1':
+        op.angle = TRANSROTATE180;
+        break;
+    case '2':
+        op.angle = TRANSROTATE270;
+        break;
+    case 's':
+    case 'S':
+        op.angle = TRANSSCALE;
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the factor to scale by (2 to " << MAXSCALEFACTOR << "): ";
+        cin >> op.size;
+        if (!cin || op.size < 2 || op.size > MAXSCALEFACTOR)
+        {
+            cin.clear();
+            cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+            return false;
+        }
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+        break;
+    default:
+        return false;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Type any letter at one corner of the part to transform, or <C> for the whole canvas / <ESC> to cancel ";
+    input = getPoint(corner);
+    if (input == ESC)
+    {
+        return false;
+    }
+    if (input == 'c' || input == 'C')
+    {
+        op.start = Point(0, 0);
+        op.end = Point(MAXROWS - 1, MAXCOLS - 1);
+        return true;
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    cout << "Type any letter at the opposite corner / <ESC> to cancel ";
+    if (getPoint(opposite) == ESC)
+    {
+        return false;
+    }
+    op.start = Point(min(corner.row, opposite.row), min(corner.col, opposite.col));
+    op.end = Point(max(corner.row, opposite.row), max(corner.col, opposite.col));
+    return true;
+}
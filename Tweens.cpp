@@ -0,0 +1,245 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <limits>
+#include "Definitions.h"
+using namespace std;
+
+// Most frames one tween may add
+const int MAXTWEENFRAMES = 10000;
+
+static TweenStats stats = {};
+
+// Returns value wrapped into 0 .. size - 1
+static int wrapped(int value, int size)
+{
+    value %= size;
+    return value < 0 ? value + size : value;
+}
+
+void addTween(List& clips, Node* current, int frames, int rowStep, int colStep, bool wrap,
+    const char palette[], int paletteStep)
+{
+    if (frames <= 0)
+    {
+        return;
+    }
+    frames = min(frames, MAXTWEENFRAMES);
+
+    Tween* tween = new Tween;
+    countAllocation(MEMTWEEN, sizeof(Tween));
+    tween->base = newCanvas(current);
+    // A step of a whole canvas or palette is no step when wrapping, and takes everything off the
+    // canvas when not; either way a smaller one draws the same, and keeps frame * step inside an int
+    if (wrap)
+    {
+        rowStep %= MAXROWS;
+        colStep %= MAXCOLS;
+    }
+    else
+    {
+        rowStep = max(-MAXROWS, min(rowStep, MAXROWS));
+        colStep = max(-MAXCOLS, min(colStep, MAXCOLS));
+    }
+    tween->rowStep = rowStep;
+    tween->colStep = colStep;
+    tween->wrap = wrap;
+    tween->paletteLength = (int)min(strlen(palette), (size_t)PALETTESIZE);
+    memcpy(tween->palette, palette, tween->paletteLength);
+    tween->paletteStep = tween->paletteLength > 0 ? paletteStep % tween->paletteLength : 0;
+    tween->refCount = 0;
+    stats.tweens++;
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        // A clip with no canvas, like one paged out; drawn from the tween when needed
+        Node* node = new Node;
+        countAllocation(MEMNODE, sizeof(Node));
+        node->item = NULL;
+        node->blob = NULL;
+        node->next = NULL;
+        node->spillOffset = 0;
+        node->spillLength = 0;
+        node->sessionOffset = 0;
+        node->tween = tween;
+        node->tweenFrame = frame;
+        node->patch = NULL;
+        tween->refCount++;
+        stats.lazyFrames++;
+        if (!addClip(clips, node))
+        {
+            break;
+        }
+    }
+}
+
+void drawTweenFrame(Node* node, char canvas[][MAXCOLS])
+{
+    Tween* tween = node->tween;
+    int frame = node->tweenFrame;
+    CanvasRow* base = residentCanvas(tween->base);
+
+    // Each palette character becomes the one frame * paletteStep places on
+    unsigned char map[256];
+    for (int ch = 0; ch < 256; ch++)
+    {
+        map[ch] = (unsigned char)ch;
+    }
+    for (int i = 0; i < tween->paletteLength; i++)
+    {
+        int to = wrapped(i + frame * tween->paletteStep, tween->paletteLength);
+        map[(unsigned char)tween->palette[i]] = (unsigned char)tween->palette[to];
+    }
+
+    // Where each cell comes from in the base
+    int rowShift = frame * tween->rowStep;
+    int colShift = frame * tween->colStep;
+    for (int row = 0; row < MAXROWS; row++)
+    {
+        int fromRow = tween->wrap ? wrapped(row - rowShift, MAXROWS) : row - rowShift;
+        for (int col = 0; col < MAXCOLS; col++)
+        {
+            int fromCol = tween->wrap ? wrapped(col - colShift, MAXCOLS) : col - colShift;
+            bool inside = fromRow >= 0 && fromRow < MAXROWS && fromCol >= 0 && fromCol < MAXCOLS;
+            canvas[row][col] = (char)map[inside ? (unsigned char)base[fromRow][fromCol] : ' '];
+        }
+    }
+
+    canvasChanged(canvas);
+    stats.framesDrawn++;
+}
+
+void keepTweenFrame(Node* node)
+{
+    // No longer lazy once it has a canvas of its own
+    stats.lazyFrames--;
+    stats.framesKept++;
+    allocateCanvas(node);
+    drawTweenFrame(node, node->item);
+    releaseTween(node);
+    sealCanvas(node);
+}
+
+CanvasRow* clipCanvas(Node* node)
+{
+    static ListItemType scratch;
+
+    if (node->tween != NULL && isSpilled(node))
+    {
+        drawTweenFrame(node, scratch);
+        return scratch;
+    }
+    return residentCanvas(node);
+}
+
+ListItemType* clipCanvases(Node* const nodes[], int count, CanvasRow* canvases[])
+{
+    int lazy = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (nodes[i]->tween != NULL && isSpilled(nodes[i]))
+        {
+            lazy++;
+        }
+    }
+
+    ListItemType* frames = lazy > 0 ? new ListItemType[lazy] : NULL;
+    int drawn = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (nodes[i]->tween != NULL && isSpilled(nodes[i]))
+        {
+            drawTweenFrame(nodes[i], frames[drawn]);
+            canvases[i] = frames[drawn++];
+        }
+        else
+        {
+            canvases[i] = residentCanvas(nodes[i]);
+        }
+    }
+    return frames;
+}
+
+void releaseTween(Node* node)
+{
+    Tween* tween = node->tween;
+    if (tween == NULL)
+    {
+        return;
+    }
+
+    node->tween = NULL;
+    stats.lazyFrames -= isSpilled(node) ? 1 : 0;
+    tween->refCount--;
+    if (tween->refCount == 0)
+    {
+        deleteNode(tween->base);
+        delete tween;
+        countAllocation(MEMTWEEN, -(long long)sizeof(Tween));
+        stats.tweens--;
+    }
+}
+
+TweenStats getTweenStats()
+{
+    return stats;
+}
+
+void tweenMenu(Node* current, List& clips)
+{
+    int frames, rowStep = 0, colStep = 0, paletteStep = 0;
+    char wrap = 'N';
+    string palette;
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+    gotoxy(MAXROWS + 1, 0);
+    cout << "Enter the number of frames, starting with this canvas: ";
+    cin >> frames;
+    bool valid = cin && frames > 0 && frames <= MAXTWEENFRAMES;
+    cin.clear();
+    cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+    if (valid)
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the column units to move each frame: ";
+        cin >> colStep;
+        cout << "Enter the row units to move each frame: ";
+        cin >> rowStep;
+        valid = !cin.fail();
+        cin.clear();
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+    }
+
+    if (valid)
+    {
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        clearLine(MAXROWS + 2, CLEARCOLS);
+        cout << "Wrap around the edges (Y/N): ";
+        cin >> wrap;
+        cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+
+        clearLine(MAXROWS + 1, CLEARCOLS);
+        cout << "Enter the palette to cycle through (<ENTER> for none): ";
+        getline(cin, palette);
+        if (!palette.empty())
+        {
+            clearLine(MAXROWS + 1, CLEARCOLS);
+            cout << "Enter the palette places to move each frame: ";
+            cin >> paletteStep;
+            valid = !cin.fail();
+            cin.clear();
+            cin.ignore((numeric_limits<streamsize>::max)(), '\n');
+        }
+    }
+
+    // Steps too big for an int (or not numbers) cancel the tween; addTween reduces the rest
+    if (valid)
+    {
+        addTween(clips, current, frames, rowStep, colStep, wrap == 'y' || wrap == 'Y', palette.c_str(), paletteStep);
+    }
+
+    clearLine(MAXROWS + 1, CLEARCOLS);
+    clearLine(MAXROWS + 2, CLEARCOLS);
+}